@@ -0,0 +1,461 @@
+#include "compact_mesh.h"
+#include "deviation.h"
+#include "glb_loader.h"
+#include "memory_usage.h"
+#include "obj_loader.h"
+#include "quadric_kernels.h"
+#include "simplifier.h"
+#include "synthetic_meshes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <random>
+
+// --- 基准测试 ---
+// Times every stage of the CLI pipeline on deterministic synthetic meshes and writes the medians
+// as JSON, so two builds can be compared with --compare.
+
+using Json  = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+namespace fs = std::filesystem;
+
+static double MsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Stage order of the report. Throughput is measured against the input face count, except for
+// the save stages, which write the simplified mesh.
+static const char *kStages[] = {"loadGlb",  "loadObj",  "clean",   "topology", "init",
+                                "collapse", "normals", "saveGlb", "saveObj"};
+
+struct Shape {
+    const char *name;
+    void (*make)(MyMesh &, size_t);
+    int materials;
+};
+static const Shape kShapes[] = {{"icosphere", MakeIcosphere, 0},
+                                {"terrain", MakeTerrain, 1},
+                                {"seamed", MakeSeamedMultiMaterial, 3}};
+
+// "100k,1m,10m" -> {100000, 1000000, 10000000}
+static std::vector<size_t> ParseSizes(const char *arg) {
+    std::vector<size_t> sizes;
+    const char *p = arg;
+    while (*p) {
+        char *end   = nullptr;
+        double size = strtod(p, &end);
+        if (end == p)
+            break;
+        if (*end == 'k' || *end == 'K') {
+            size *= 1e3;
+            ++end;
+        } else if (*end == 'm' || *end == 'M') {
+            size *= 1e6;
+            ++end;
+        }
+        sizes.push_back(size_t(size));
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return sizes;
+}
+
+static std::string SizeLabel(size_t faces) {
+    return faces % 1000000 == 0 ? std::to_string(faces / 1000000) + "m"
+                                : std::to_string(faces / 1000) + "k";
+}
+
+static double Median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0.0 : v[v.size() / 2];
+}
+
+static const QuadricKernel kKernels[] = {QuadricKernel::Scalar, QuadricKernel::Avx2,
+                                         QuadricKernel::Avx512};
+
+struct EngineRun {
+    const char *name;
+    Simplifier::Engine engine;
+    int threads;
+};
+static const EngineRun kEngines[] = {{"serial", Simplifier::Engine::Serial, 1},
+                                     {"independent", Simplifier::Engine::IndependentSet, 0}};
+
+// Micro-benchmark of QuadricErrorBatch alone: random quadric pairs from a cache-resident array,
+// 4096 at a time as the compact simplifier's init does, in millions of pairs per second.
+static Json KernelThroughput(int repeat) {
+    const size_t quadricCount = 8192, batch = 4096, rounds = 256;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> quadrics(quadricCount * 10), x(batch), y(batch), z(batch), out(batch);
+    std::vector<uint32_t> a(batch), b(batch);
+    for (float &q : quadrics)
+        q = unit(rng);
+    for (size_t i = 0; i < batch; ++i) {
+        a[i] = uint32_t(rng() % quadricCount);
+        b[i] = uint32_t(rng() % quadricCount);
+        x[i] = unit(rng);
+        y[i] = unit(rng);
+        z[i] = unit(rng);
+    }
+
+    Json result;
+    for (QuadricKernel kernel : kKernels) {
+        if (!QuadricKernelSupported(kernel))
+            continue;
+        SetQuadricKernel(kernel);
+        std::vector<double> ms;
+        for (int r = 0; r < repeat; ++r) {
+            Clock::time_point start = Clock::now();
+            for (size_t k = 0; k < rounds; ++k)
+                QuadricErrorBatch(quadrics.data(), quadricCount, a.data(), b.data(), x.data(),
+                                  y.data(), z.data(), batch, out.data());
+            ms.push_back(MsSince(start));
+        }
+        double median = Median(ms);
+        result[QuadricKernelName(kernel)] = {
+            {"ms", median}, {"mPairsPerSecond", median > 0 ? batch * rounds / median / 1e3 : 0.0}};
+    }
+    SetQuadricKernel(QuadricKernel::Auto);
+    return result;
+}
+
+static Json RunCase(const Shape &shape, size_t requestedFaces, float ratio, int repeat,
+                    const fs::path &tmp) {
+    std::string name = std::string(shape.name) + "-" + SizeLabel(requestedFaces);
+    printf("=== %s ===\n", name.c_str());
+
+    // Setup (not timed): the input files every repetition loads.
+    tinygltf::Model model;
+    model.materials.resize(shape.materials);
+    std::string inGlb = (tmp / (name + ".glb")).string();
+    std::string inObj = (tmp / (name + ".obj")).string();
+    size_t inputFaces = 0;
+    {
+        MyMesh source;
+        shape.make(source, requestedFaces);
+        inputFaces = size_t(source.fn);
+        if (!SaveGLB(source, model, inGlb) || !SaveObj(source, inObj)) {
+            printf("Cannot write the input files of %s\n", name.c_str());
+            return Json();
+        }
+    }
+
+    std::map<std::string, std::vector<double>> times;
+    std::map<std::string, uint64_t> kernelCollapses;
+    std::map<std::string, double> engineDeviation;
+    std::map<std::string, double> engineVsSerial;
+    size_t outputFaces = 0;
+    // Mesh storage after Clean per face, by layout (capacity based, so allocator slack counts).
+    double myMeshBytes = 0.0, compactBytes = 0.0;
+    for (int r = 0; r < repeat; ++r) {
+        Clock::time_point start;
+        {
+            MyMesh objMesh;
+            start = Clock::now();
+            LoadObj(objMesh, inObj);
+            times["loadObj"].push_back(MsSince(start));
+        }
+
+        MyMesh m;
+        tinygltf::Model loaded;
+        start = Clock::now();
+        LoadGLB(m, loaded, inGlb);
+        times["loadGlb"].push_back(MsSince(start));
+
+        start = Clock::now();
+        Simplifier::Clean(m);
+        times["clean"].push_back(MsSince(start));
+        myMeshBytes = double(m.vert.capacity() * sizeof(MyVertex) +
+                             m.face.capacity() * sizeof(MyFace)) /
+                      std::max(m.fn, 1);
+
+        MyMesh cleaned;
+        Simplifier::CopyMesh(m, cleaned);
+
+        Simplifier::Stats stats;
+        Simplifier::Params params;
+        params.ratio = ratio;
+        params.stats = &stats;
+        Simplifier::Simplify(m, params);
+        times["topology"].push_back(stats.topologyMs);
+        times["init"].push_back(stats.initMs);
+        times["collapse"].push_back(stats.collapseMs);
+        times["normals"].push_back(stats.normalsMs);
+        outputFaces = size_t(m.fn);
+
+        start = Clock::now();
+        SaveGLB(m, loaded, (tmp / (name + "_out.glb")).string());
+        times["saveGlb"].push_back(MsSince(start));
+        start = Clock::now();
+        SaveObj(m, (tmp / (name + "_out.obj")).string());
+        times["saveObj"].push_back(MsSince(start));
+
+        // The MyMesh simplify once per collapse engine, the independent-set one on every hardware
+        // thread, for its time and the largest collapse error (Stats maxDeviation). The other
+        // engines' results are compared with the serial one: the Hausdorff distance between the
+        // two surfaces, relative to the bounding box diagonal.
+        MyMesh serialResult;
+        for (const EngineRun &run : kEngines) {
+            MyMesh copy;
+            Simplifier::CopyMesh(cleaned, copy);
+            Simplifier::Stats engineStats;
+            Simplifier::Params engineParams = params;
+            engineParams.engine             = run.engine;
+            engineParams.threads            = run.threads;
+            engineParams.stats              = &engineStats;
+            start                           = Clock::now();
+            Simplifier::Simplify(copy, engineParams);
+            times[std::string("engine:") + run.name].push_back(MsSince(start));
+            engineDeviation[run.name] = engineStats.collapses.maxDeviation;
+            if (run.engine == Simplifier::Engine::Serial) {
+                Simplifier::CopyMesh(copy, serialResult);
+                continue;
+            }
+            Deviation::Params deviationParams;
+            deviationParams.samples  = 100000;
+            Deviation::Result d      = Deviation::Measure(serialResult, copy, deviationParams);
+            engineVsSerial[run.name] = d.diagonal > 0 ? d.hausdorff / d.diagonal : 0.0;
+        }
+
+        // The same load, clean and simplify on the compact layout.
+        CompactMesh cm;
+        tinygltf::Model compactModel;
+        LoadGLB(cm, compactModel, inGlb);
+        Simplifier::Clean(cm);
+        compactBytes = double(cm.MemoryBytes()) / std::max<size_t>(cm.FaceCount(), 1);
+
+        // The compact simplify once per quadric kernel the CPU supports, for collapses per
+        // second before (scalar) and after vectorization. The output is the same for all.
+        for (QuadricKernel kernel : kKernels) {
+            if (!QuadricKernelSupported(kernel))
+                continue;
+            SetQuadricKernel(kernel);
+            CompactMesh copy = cm;
+            Simplifier::Stats kernelStats;
+            Simplifier::Params kernelParams = params;
+            kernelParams.stats              = &kernelStats;
+            start                           = Clock::now();
+            Simplifier::Simplify(copy, kernelParams);
+            times[std::string("kernel:") + QuadricKernelName(kernel)].push_back(MsSince(start));
+            kernelCollapses[QuadricKernelName(kernel)] = kernelStats.collapses.performed;
+        }
+        SetQuadricKernel(QuadricKernel::Auto);
+
+        Simplifier::Params compactParams = params;
+        compactParams.stats              = nullptr;
+        start                            = Clock::now();
+        Simplifier::Simplify(cm, compactParams);
+        times["compactSimplify"].push_back(MsSince(start));
+    }
+
+    Json result;
+    result["name"]        = name;
+    result["inputFaces"]  = inputFaces;
+    result["outputFaces"] = outputFaces;
+    double totalMs        = 0.0;
+    for (const char *stage : kStages) {
+        double ms    = Median(times[stage]);
+        size_t faces = strncmp(stage, "save", 4) == 0 ? outputFaces : inputFaces;
+        totalMs += ms;
+        result["stages"][stage] = {{"ms", ms},
+                                   {"facesPerSecond", ms > 0 ? faces / (ms / 1000.0) : 0.0}};
+    }
+    result["totalMs"] = totalMs;
+
+    // MyMesh simplify is its topology, init and collapse phases; the compact path has no
+    // normals phase either.
+    double simplifyMs =
+        Median(times["topology"]) + Median(times["init"]) + Median(times["collapse"]);
+    double compactMs = Median(times["compactSimplify"]);
+
+    result["layouts"] = {
+        {"myMesh",
+         {{"bytesPerFace", myMeshBytes},
+          {"simplifyMs", simplifyMs},
+          {"facesPerSecond", simplifyMs > 0 ? inputFaces / (simplifyMs / 1000.0) : 0.0}}},
+        {"compact",
+         {{"bytesPerFace", compactBytes},
+          {"simplifyMs", compactMs},
+          {"facesPerSecond", compactMs > 0 ? inputFaces / (compactMs / 1000.0) : 0.0}}}};
+    for (const auto &k : kernelCollapses) {
+        double ms = Median(times["kernel:" + k.first]);
+        result["kernels"][k.first] = {
+            {"simplifyMs", ms}, {"collapsesPerSecond", ms > 0 ? k.second / (ms / 1000.0) : 0.0}};
+    }
+    for (const auto &e : engineDeviation) {
+        result["engines"][e.first] = {{"simplifyMs", Median(times["engine:" + e.first])},
+                                      {"maxDeviation", e.second},
+                                      {"vsSerial", engineVsSerial[e.first]}};
+    }
+    // Process-wide high-water mark: cases run from the smallest to the largest mesh, so this is
+    // dominated by the current case.
+    result["peakMemoryMB"] = PeakMemoryBytes() / (1024.0 * 1024.0);
+
+    std::error_code ec;
+    for (const char *suffix : {".glb", ".obj", "_out.glb", "_out.obj"})
+        fs::remove(tmp / (name + suffix), ec);
+    return result;
+}
+
+static bool ReadJson(const std::string &path, Json &doc) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    doc = Json::parse(file, nullptr, false);
+    return !doc.is_discarded();
+}
+
+// Prints the per-stage change from `basePath` to `newPath`. Returns false if any stage slowed
+// down (or peak memory grew) by more than `threshold`.
+static bool Compare(const std::string &basePath, const std::string &newPath, double threshold) {
+    Json base, next;
+    if (!ReadJson(basePath, base) || !ReadJson(newPath, next)) {
+        printf("Cannot read %s or %s\n", basePath.c_str(), newPath.c_str());
+        return false;
+    }
+    std::map<std::string, const Json *> baseCases;
+    for (const Json &c : base["cases"])
+        baseCases[c["name"].get<std::string>()] = &c;
+
+    bool ok = true;
+    printf("%-20s %-12s %12s %12s %9s\n", "case", "stage", "base ms", "new ms", "change");
+    for (const Json &c : next["cases"]) {
+        std::string name = c["name"].get<std::string>();
+        auto found       = baseCases.find(name);
+        if (found == baseCases.end())
+            continue;
+        const Json &b = *found->second;
+
+        auto row = [&](const char *label, double before, double after) {
+            double change  = before > 0 ? (after - before) / before : 0.0;
+            bool regressed = change > threshold;
+            ok &= !regressed;
+            printf("%-20s %-12s %12.2f %12.2f %+8.1f%%%s\n", name.c_str(), label, before, after,
+                   change * 100.0, regressed ? "  REGRESSION" : "");
+        };
+        for (const char *stage : kStages)
+            row(stage, b["stages"][stage]["ms"].get<double>(),
+                c["stages"][stage]["ms"].get<double>());
+        if (b.contains("layouts") && c.contains("layouts"))
+            row("compact", b["layouts"]["compact"]["simplifyMs"].get<double>(),
+                c["layouts"]["compact"]["simplifyMs"].get<double>());
+        if (b.contains("kernels") && c.contains("kernels")) {
+            for (const auto &k : c["kernels"].items()) {
+                if (b["kernels"].contains(k.key()))
+                    row(k.key().c_str(), b["kernels"][k.key()]["simplifyMs"].get<double>(),
+                        k.value()["simplifyMs"].get<double>());
+            }
+        }
+        if (b.contains("engines") && c.contains("engines")) {
+            for (const auto &e : c["engines"].items()) {
+                if (b["engines"].contains(e.key()))
+                    row(e.key().c_str(), b["engines"][e.key()]["simplifyMs"].get<double>(),
+                        e.value()["simplifyMs"].get<double>());
+            }
+        }
+        row("total", b["totalMs"].get<double>(), c["totalMs"].get<double>());
+        row("peak MB", b["peakMemoryMB"].get<double>(), c["peakMemoryMB"].get<double>());
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    std::vector<size_t> sizes = {100000, 1000000};
+    float ratio               = 0.1f;
+    int repeat                = 3;
+    double threshold          = 0.1;
+    std::string outPath       = "bench.json";
+    std::string tmpDir;
+    std::string comparePaths[2];
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc)
+            sizes = ParseSizes(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            ratio = float(atof(argv[++i]));
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outPath = argv[++i];
+        else if (strcmp(argv[i], "--tmp") == 0 && i + 1 < argc)
+            tmpDir = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            comparePaths[0] = argv[++i];
+            comparePaths[1] = argv[++i];
+        }
+    }
+
+    if (!comparePaths[0].empty())
+        return Compare(comparePaths[0], comparePaths[1], threshold) ? 0 : 1;
+
+    fs::path tmp = tmpDir.empty() ? fs::temp_directory_path() / "vcg-bench" : fs::path(tmpDir);
+    std::error_code ec;
+    fs::create_directories(tmp, ec);
+
+    std::sort(sizes.begin(), sizes.end());
+    Json doc;
+    doc["ratio"]          = ratio;
+    doc["repeat"]         = repeat;
+    doc["cases"]          = Json::array();
+    doc["quadricKernels"] = KernelThroughput(repeat);
+    for (size_t faces : sizes) {
+        for (const Shape &shape : kShapes) {
+            Json result = RunCase(shape, faces, ratio, repeat, tmp);
+            if (!result.is_null())
+                doc["cases"].push_back(result);
+        }
+    }
+
+    std::ofstream out(outPath);
+    out << doc.dump(2) << "\n";
+    printf("\n%-20s %10s %10s %12s %10s\n", "case", "faces", "total ms", "faces/s", "peak MB");
+    for (const Json &c : doc["cases"]) {
+        double totalMs = c["totalMs"].get<double>();
+        printf("%-20s %10zu %10.1f %12.0f %10.1f\n", c["name"].get<std::string>().c_str(),
+               c["inputFaces"].get<size_t>(), totalMs,
+               c["inputFaces"].get<size_t>() / (totalMs / 1000.0),
+               c["peakMemoryMB"].get<double>());
+    }
+    printf("\n%-20s %14s %14s %14s %14s\n", "case", "MyMesh B/face", "compact B/face",
+           "MyMesh f/s", "compact f/s");
+    for (const Json &c : doc["cases"]) {
+        const Json &l = c["layouts"];
+        printf("%-20s %14.1f %14.1f %14.0f %14.0f\n", c["name"].get<std::string>().c_str(),
+               l["myMesh"]["bytesPerFace"].get<double>(),
+               l["compact"]["bytesPerFace"].get<double>(),
+               l["myMesh"]["facesPerSecond"].get<double>(),
+               l["compact"]["facesPerSecond"].get<double>());
+    }
+    printf("\n%-20s %-8s %12s %14s\n", "case", "kernel", "simplify ms", "collapses/s");
+    for (const Json &c : doc["cases"]) {
+        if (!c.contains("kernels"))
+            continue;
+        for (const auto &k : c["kernels"].items())
+            printf("%-20s %-8s %12.1f %14.0f\n", c["name"].get<std::string>().c_str(),
+                   k.key().c_str(), k.value()["simplifyMs"].get<double>(),
+                   k.value()["collapsesPerSecond"].get<double>());
+    }
+    printf("\n%-20s %-12s %12s %14s %12s\n", "case", "engine", "simplify ms", "max deviation",
+           "vs serial");
+    for (const Json &c : doc["cases"]) {
+        if (!c.contains("engines"))
+            continue;
+        for (const auto &e : c["engines"].items())
+            printf("%-20s %-12s %12.1f %14.6g %11.4f%%\n", c["name"].get<std::string>().c_str(),
+                   e.key().c_str(), e.value()["simplifyMs"].get<double>(),
+                   e.value()["maxDeviation"].get<double>(),
+                   100.0 * e.value().value("vsSerial", 0.0));
+    }
+    for (const auto &k : doc["quadricKernels"].items())
+        printf("QuadricErrorBatch %-8s %8.1f M pairs/s\n", k.key().c_str(),
+               k.value()["mPairsPerSecond"].get<double>());
+    printf("Results written to %s\n", outPath.c_str());
+    return 0;
+}
\ No newline at end of file
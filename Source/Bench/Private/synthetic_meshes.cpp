@@ -0,0 +1,216 @@
+#include "synthetic_meshes.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+#include <vector>
+
+namespace {
+
+// Collects shared vertices (identified by an integer key) and faces with wedge UVs.
+class MeshBuilder {
+  public:
+    uint32_t Vertex(uint64_t key, const vcg::Point3f &p) {
+        auto it = index.emplace(key, uint32_t(positions.size()));
+        if (it.second)
+            positions.push_back(p);
+        return it.first->second;
+    }
+
+    void Face(const uint32_t v[3], const vcg::Point2f uv[3], int matId) {
+        faces.push_back({{v[0], v[1], v[2]}, {uv[0], uv[1], uv[2]}, matId});
+    }
+
+    void Build(MyMesh &m) {
+        m.Clear();
+        vcg::tri::Allocator<MyMesh>::AddVertices(m, positions.size());
+        vcg::tri::Allocator<MyMesh>::AddFaces(m, faces.size());
+        for (size_t i = 0; i < positions.size(); ++i) {
+            m.vert[i].P() = positions[i];
+            m.vert[i].C() = vcg::Color4b::White;
+        }
+        for (size_t i = 0; i < faces.size(); ++i) {
+            for (int k = 0; k < 3; ++k) {
+                m.face[i].V(k)  = &m.vert[faces[i].v[k]];
+                m.face[i].WT(k) = MyFace::TexCoordType(faces[i].uv[k][0], faces[i].uv[k][1]);
+            }
+            m.face[i].matId = faces[i].matId;
+        }
+        vcg::tri::UpdateBounding<MyMesh>::Box(m);
+        vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFace(m);
+        vcg::tri::UpdateNormal<MyMesh>::NormalizePerFace(m);
+    }
+
+  private:
+    struct Face {
+        uint32_t v[3];
+        vcg::Point2f uv[3];
+        int matId;
+    };
+    std::unordered_map<uint64_t, uint32_t> index;
+    std::vector<vcg::Point3f> positions;
+    std::vector<Face> faces;
+};
+
+// Integer hash (lowbias32) -> [0, 1).
+float Hash(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ seed * 0xC2B2AE3Du;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return float(h >> 8) / float(1u << 24);
+}
+
+float ValueNoise(float x, float y, uint32_t seed) {
+    int x0      = int(std::floor(x));
+    int y0      = int(std::floor(y));
+    float fx    = x - x0;
+    float fy    = y - y0;
+    fx          = fx * fx * (3 - 2 * fx);
+    fy          = fy * fy * (3 - 2 * fy);
+    float lower = Hash(x0, y0, seed) + (Hash(x0 + 1, y0, seed) - Hash(x0, y0, seed)) * fx;
+    float upper =
+        Hash(x0, y0 + 1, seed) + (Hash(x0 + 1, y0 + 1, seed) - Hash(x0, y0 + 1, seed)) * fx;
+    return lower + (upper - lower) * fy;
+}
+
+size_t RoundedSqrt(double v) { return std::max<size_t>(1, size_t(std::lround(std::sqrt(v)))); }
+
+} // namespace
+
+void MakeIcosphere(MyMesh &m, size_t faceCount) {
+    const float t                  = (1.0f + std::sqrt(5.0f)) / 2.0f;
+    const vcg::Point3f corners[12] = {{-1, t, 0}, {1, t, 0},  {-1, -t, 0}, {1, -t, 0},
+                                      {0, -1, t}, {0, 1, t},  {0, -1, -t}, {0, 1, -t},
+                                      {t, 0, -1}, {t, 0, 1},  {-t, 0, -1}, {-t, 0, 1}};
+    const int tris[20][3] = {{0, 11, 5}, {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11},
+                             {1, 5, 9},  {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+                             {3, 9, 4},  {3, 4, 2},  {3, 2, 6},   {3, 6, 8},  {3, 8, 9},
+                             {4, 9, 5},  {2, 4, 11}, {6, 2, 10},  {8, 6, 7},  {9, 8, 1}};
+    const size_t n = RoundedSqrt(faceCount / 20.0);
+
+    // A lattice point is identified by its (corner, weight) pairs, so points on shared
+    // icosahedron edges and corners get the same key from every face.
+    auto key = [&](const int c[3], const size_t w[3]) {
+        uint64_t pairs[3];
+        int count = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (w[k])
+                pairs[count++] = (uint64_t(c[k]) << 16) | w[k];
+        }
+        std::sort(pairs, pairs + count);
+        uint64_t result = 0;
+        for (int k = 0; k < count; ++k)
+            result = (result << 20) | pairs[k];
+        return result;
+    };
+
+    MeshBuilder builder;
+    const vcg::Point2f noUV[3] = {vcg::Point2f(0, 0), vcg::Point2f(0, 0), vcg::Point2f(0, 0)};
+    std::vector<uint32_t> row, prevRow;
+    for (const int *c : tris) {
+        // Rows j = 0..n along corner 2, i = 0..n-j along corner 1.
+        for (size_t j = 0; j <= n; ++j) {
+            row.clear();
+            for (size_t i = 0; i + j <= n; ++i) {
+                size_t w[3]    = {n - i - j, i, j};
+                vcg::Point3f p = (corners[c[0]] * float(w[0]) + corners[c[1]] * float(w[1]) +
+                                  corners[c[2]] * float(w[2])) /
+                                 float(n);
+                row.push_back(builder.Vertex(key(c, w), p.Normalize()));
+            }
+            if (j > 0) {
+                for (size_t i = 0; i < row.size(); ++i) {
+                    uint32_t up[3] = {prevRow[i], prevRow[i + 1], row[i]};
+                    builder.Face(up, noUV, 0);
+                    if (i + 1 < row.size()) {
+                        uint32_t down[3] = {prevRow[i + 1], row[i + 1], row[i]};
+                        builder.Face(down, noUV, 0);
+                    }
+                }
+            }
+            prevRow.swap(row);
+        }
+    }
+    builder.Build(m);
+}
+
+void MakeTerrain(MyMesh &m, size_t faceCount) {
+    const size_t n = RoundedSqrt(faceCount / 2.0) + 1; // vertices per side
+    MeshBuilder builder;
+    std::vector<uint32_t> index(n * n);
+    for (size_t y = 0; y < n; ++y) {
+        for (size_t x = 0; x < n; ++x) {
+            float u = float(x) / float(n - 1), v = float(y) / float(n - 1);
+            float h = 0.0f, amplitude = 0.5f, frequency = 4.0f;
+            for (uint32_t octave = 0; octave < 6; ++octave) {
+                h += amplitude * ValueNoise(u * frequency, v * frequency, octave);
+                amplitude *= 0.5f;
+                frequency *= 2.0f;
+            }
+            index[y * n + x] = builder.Vertex(y * n + x, vcg::Point3f(u, h * 0.25f, v));
+        }
+    }
+    auto uv = [&](size_t x, size_t y) {
+        return vcg::Point2f(float(x) / float(n - 1), float(y) / float(n - 1));
+    };
+    for (size_t y = 0; y + 1 < n; ++y) {
+        for (size_t x = 0; x + 1 < n; ++x) {
+            uint32_t i00              = index[y * n + x];
+            uint32_t i10              = index[y * n + x + 1];
+            uint32_t i01              = index[(y + 1) * n + x];
+            uint32_t i11              = index[(y + 1) * n + x + 1];
+            uint32_t a[3]             = {i00, i01, i11};
+            uint32_t b[3]             = {i00, i11, i10};
+            const vcg::Point2f uvA[3] = {uv(x, y), uv(x, y + 1), uv(x + 1, y + 1)};
+            const vcg::Point2f uvB[3] = {uv(x, y), uv(x + 1, y + 1), uv(x + 1, y)};
+            builder.Face(a, uvA, 0);
+            builder.Face(b, uvB, 0);
+        }
+    }
+    builder.Build(m);
+}
+
+void MakeSeamedMultiMaterial(MyMesh &m, size_t faceCount) {
+    const size_t n = RoundedSqrt(faceCount / 12.0);
+    MeshBuilder builder;
+    // Lattice point (x, y, z) of the (n+1)^3 cube grid, shared between sides.
+    auto vertex = [&](const size_t c[3]) {
+        uint64_t key = (uint64_t(c[0]) * (n + 1) + c[1]) * (n + 1) + c[2];
+        vcg::Point3f p(float(c[0]) - n * 0.5f, float(c[1]) - n * 0.5f, float(c[2]) - n * 0.5f);
+        return builder.Vertex(key, p.Normalize());
+    };
+    for (int side = 0; side < 6; ++side) {
+        const int axis = side / 2, a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+        const bool positive = side % 2 == 1;
+        auto point          = [&](size_t u, size_t v) {
+            size_t c[3];
+            c[axis] = positive ? n : 0;
+            c[a1]   = u;
+            c[a2]   = v;
+            return vertex(c);
+        };
+        auto uv = [&](size_t u, size_t v) { return vcg::Point2f(float(u) / n, float(v) / n); };
+        for (size_t v = 0; v < n; ++v) {
+            for (size_t u = 0; u < n; ++u) {
+                uint32_t q[4] = {point(u, v), point(u + 1, v), point(u + 1, v + 1),
+                                 point(u, v + 1)};
+                vcg::Point2f t[4] = {uv(u, v), uv(u + 1, v), uv(u + 1, v + 1), uv(u, v + 1)};
+                // Outward winding on both sides of the axis.
+                int order[2][3] = {{0, 1, 2}, {0, 2, 3}};
+                for (auto &o : order) {
+                    if (!positive)
+                        std::swap(o[1], o[2]);
+                    uint32_t f[3]            = {q[o[0]], q[o[1]], q[o[2]]};
+                    const vcg::Point2f ft[3] = {t[o[0]], t[o[1]], t[o[2]]};
+                    builder.Face(f, ft, side % 3);
+                }
+            }
+        }
+    }
+    builder.Build(m);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+#include "mymesh.h"
+#include <cstddef>
+
+// Deterministic benchmark meshes. faceCount is approximate (within a few percent of the request)
+// and the same arguments give the same mesh on every platform: nothing depends on std random
+// distributions. All meshes come with vertex normals, white colors and per-face matId.
+
+// Geodesic sphere: every icosahedron face split into n^2 triangles. No UVs.
+void MakeIcosphere(MyMesh &m, size_t faceCount);
+
+// Square height field with a few octaves of value noise. One continuous UV chart, one material.
+void MakeTerrain(MyMesh &m, size_t faceCount);
+
+// Cube projected onto a sphere, with a separate UV chart per cube side and matId = side % 3.
+// Every cube edge is a UV seam and a material border.
+void MakeSeamedMultiMaterial(MyMesh &m, size_t faceCount);
\ No newline at end of file
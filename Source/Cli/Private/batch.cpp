@@ -0,0 +1,299 @@
+#include "batch.h"
+#include "glb_loader.h"
+#include "obj_loader.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::string Extension(const std::string &path) {
+    return path.substr(path.find_last_of('.') + 1);
+}
+
+// Fixed capacity FIFO between two pipeline stages. Push blocks while the queue is full, Pop
+// blocks while it is empty and returns false once the queue is closed and drained.
+template <class T> class BoundedQueue {
+  public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    void Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool Pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+  private:
+    size_t capacity;
+    bool closed = false;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+struct JobResult {
+    bool ok            = false;
+    const char *status = "pending";
+    double loadMs      = 0.0;
+    double simplifyMs  = 0.0;
+    double saveMs      = 0.0;
+    int facesIn        = 0;
+    int facesOut       = 0;
+};
+
+// A mesh travelling through the pipeline. Heap allocated so that the queues only move a pointer.
+struct InFlight {
+    size_t index = 0;
+    MyMesh mesh;
+    tinygltf::Model model; // 保存原始数据（材质/纹理）
+};
+
+bool LoadJob(const BatchJob &job, InFlight &item) {
+    if (Extension(job.input) == "glb")
+        return LoadGLB(item.mesh, item.model, job.input);
+    if (Extension(job.input) == "obj")
+        return LoadObj(item.mesh, job.input);
+    return false;
+}
+
+bool SaveJob(const BatchJob &job, InFlight &item, const GLBSaveOptions &saveOptions) {
+    if (Extension(job.output) == "glb")
+        return SaveGLB(item.mesh, item.model, job.output, saveOptions);
+    if (Extension(job.output) == "obj")
+        return SaveObj(item.mesh, job.output);
+    return false;
+}
+
+// True if writing `output` would overwrite `input`, also through a different spelling of the path.
+bool SameFile(const std::string &input, const std::string &output) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (fs::exists(output, ec))
+        return fs::equivalent(input, output, ec);
+    return fs::weakly_canonical(input, ec) == fs::weakly_canonical(output, ec);
+}
+
+bool MatchWildcard(const char *pattern, const char *name) {
+    if (*pattern == '\0')
+        return *name == '\0';
+    if (*pattern == '*')
+        return MatchWildcard(pattern + 1, name) || (*name && MatchWildcard(pattern, name + 1));
+    if (*name && (*pattern == '?' || *pattern == *name))
+        return MatchWildcard(pattern + 1, name + 1);
+    return false;
+}
+
+} // namespace
+
+bool ParseManifest(const std::string &path, float defaultRatio, std::vector<BatchJob> &jobs) {
+    std::ifstream file(path);
+    if (!file) {
+        printf("Cannot open manifest %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(file, line)) {
+        ++lineNo;
+        std::istringstream fields(line);
+        BatchJob job;
+        if (!(fields >> job.input) || job.input[0] == '#')
+            continue;
+        if (!(fields >> job.output)) {
+            printf("%s:%d: expected \"input output [ratio|faces]\"\n", path.c_str(), lineNo);
+            return false;
+        }
+        std::string valueField;
+        double value = defaultRatio;
+        if (fields >> valueField) {
+            char *end = nullptr;
+            value     = strtod(valueField.c_str(), &end);
+            if (*end != '\0' || !(value > 0.0)) {
+                printf("%s:%d: invalid ratio or face count \"%s\"\n", path.c_str(), lineNo,
+                       valueField.c_str());
+                return false;
+            }
+        }
+        if (value <= 1.0)
+            job.ratio = float(value);
+        else
+            job.targetFaceCount = int(value);
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+bool ExpandGlob(const std::string &pattern, const std::string &outputDir, float ratio,
+                std::vector<BatchJob> &jobs) {
+    namespace fs = std::filesystem;
+    fs::path patternPath(pattern);
+    fs::path dir = patternPath.has_parent_path() ? patternPath.parent_path() : fs::path(".");
+    std::string filePattern = patternPath.filename().string();
+
+    std::error_code ec;
+    std::vector<fs::path> matches;
+    for (const fs::directory_entry &entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file() &&
+            MatchWildcard(filePattern.c_str(), entry.path().filename().string().c_str()))
+            matches.push_back(entry.path());
+    }
+    if (ec) {
+        printf("Cannot list %s: %s\n", dir.string().c_str(), ec.message().c_str());
+        return false;
+    }
+    std::sort(matches.begin(), matches.end());
+
+    fs::create_directories(outputDir, ec);
+    if (ec) {
+        printf("Cannot create %s: %s\n", outputDir.c_str(), ec.message().c_str());
+        return false;
+    }
+    for (const fs::path &input : matches) {
+        BatchJob job;
+        job.input  = input.string();
+        job.output = (fs::path(outputDir) / input.filename()).string();
+        job.ratio  = ratio;
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+int RunBatch(const std::vector<BatchJob> &jobs, const Simplifier::Params &params, int workers,
+             double timeLimitSeconds, const GLBSaveOptions &saveOptions, double weldDistance) {
+    workers = ResolveThreadCount(workers);
+    std::vector<JobResult> results(jobs.size());
+    Clock::time_point batchStart = Clock::now();
+
+    // Each stage may run one mesh ahead of the next, which bounds the meshes held in memory to
+    // roughly 3 * workers.
+    BoundedQueue<std::unique_ptr<InFlight>> loaded(size_t(workers));
+    BoundedQueue<std::unique_ptr<InFlight>> simplified(size_t(workers));
+
+    std::thread loader([&] {
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            if (SameFile(jobs[i].input, jobs[i].output)) {
+                results[i].status = "output=input";
+                continue;
+            }
+            Clock::time_point start = Clock::now();
+            std::unique_ptr<InFlight> item(new InFlight);
+            item->index = i;
+            bool ok     = LoadJob(jobs[i], *item);
+            results[i].loadMs = MsSince(start);
+            if (!ok) {
+                results[i].status = "load failed";
+                continue;
+            }
+            results[i].facesIn = item->mesh.FN();
+            loaded.Push(std::move(item));
+        }
+        loaded.Close();
+    });
+
+    std::thread saver([&] {
+        std::unique_ptr<InFlight> item;
+        while (simplified.Pop(item)) {
+            Clock::time_point start = Clock::now();
+            JobResult &result       = results[item->index];
+            result.ok               = SaveJob(jobs[item->index], *item, saveOptions);
+            result.saveMs           = MsSince(start);
+            result.status           = result.ok ? "ok" : "save failed";
+            item.reset();
+        }
+    });
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < workers; ++t) {
+        pool.emplace_back([&] {
+            std::unique_ptr<InFlight> item;
+            while (loaded.Pop(item)) {
+                const BatchJob &job     = jobs[item->index];
+                Clock::time_point start = Clock::now();
+
+                Simplifier::Params jobParams = params;
+                jobParams.threads            = 1; // the batch is parallel across jobs
+                jobParams.collapseLog        = nullptr;
+                jobParams.ratio              = job.ratio;
+                jobParams.targetFaceCount    = job.targetFaceCount;
+                Simplifier::Clean(item->mesh, weldDistance);
+
+                // Short steps, so a pathological mesh is stopped close to the time limit.
+                Simplifier::Session session(item->mesh, jobParams);
+                while (session.Step(50.0)) {
+                    if (timeLimitSeconds > 0 && MsSince(start) > timeLimitSeconds * 1000.0)
+                        session.Cancel();
+                }
+                bool finished = session.Finish();
+
+                JobResult &result = results[item->index];
+                result.simplifyMs = MsSince(start);
+                result.facesOut   = item->mesh.FN();
+                if (!finished) {
+                    result.status = "timed out";
+                    continue;
+                }
+                simplified.Push(std::move(item));
+            }
+        });
+    }
+    for (std::thread &t : pool)
+        t.join();
+    simplified.Close();
+    loader.join();
+    saver.join();
+
+    // Summary
+    int failed = 0;
+    double loadMs = 0.0, simplifyMs = 0.0, saveMs = 0.0;
+    printf("\n%-5s %-12s %10s %10s %10s %10s %10s  %s\n", "job", "status", "load ms",
+           "simpl ms", "save ms", "faces in", "faces out", "input");
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const JobResult &r = results[i];
+        printf("%-5d %-12s %10.1f %10.1f %10.1f %10d %10d  %s\n", (int)i, r.status, r.loadMs,
+               r.simplifyMs, r.saveMs, r.facesIn, r.facesOut, jobs[i].input.c_str());
+        failed += r.ok ? 0 : 1;
+        loadMs += r.loadMs;
+        simplifyMs += r.simplifyMs;
+        saveMs += r.saveMs;
+    }
+    printf("Batch: %d/%d jobs ok on %d workers in %.1f ms (load %.1f, simplify %.1f, save %.1f "
+           "ms summed)\n",
+           (int)jobs.size() - failed, (int)jobs.size(), workers, MsSince(batchStart), loadMs,
+           simplifyMs, saveMs);
+    return failed;
+}
\ No newline at end of file
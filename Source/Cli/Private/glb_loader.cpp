@@ -1,14 +1,273 @@
 #include "glb_loader.h"
 
+#include "gpu_optimize.h"
+#include "mapped_file.h"
 #include "mymesh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <tiny_gltf.h>
+#include <nlohmann/json.hpp>
 
-// --- 4. GLB 加载器 (修复版：预分配内存避免指针失效) ---
-bool LoadGLB(MyMesh &m, tinygltf::Model &outModel, const std::string &filename) {
+// --- 图片直通 ---
+// Images kept encoded carry the bytes of the image file in image.image and no decoded size
+// (width < 0); decoded images have positive dimensions.
+static bool IsEncodedImage(const tinygltf::Image &img) {
+    return !img.image.empty() && img.width < 0;
+}
+
+static std::string SniffMimeType(const std::vector<unsigned char> &bytes) {
+    auto startsWith = [&](const char *magic, size_t len, size_t at = 0) {
+        return bytes.size() >= at + len && std::memcmp(bytes.data() + at, magic, len) == 0;
+    };
+    if (startsWith("\x89PNG", 4))
+        return "image/png";
+    if (startsWith("\xFF\xD8\xFF", 3))
+        return "image/jpeg";
+    if (startsWith("\xABKTX 20\xBB", 8))
+        return "image/ktx2";
+    if (startsWith("RIFF", 4) && startsWith("WEBP", 4, 8))
+        return "image/webp";
+    return "application/octet-stream";
+}
+
+// tinygltf image loader that stores the encoded bytes instead of decoding them.
+static bool KeepEncodedImage(tinygltf::Image *image, const int, std::string *, std::string *, int,
+                             int, const unsigned char *bytes, int size, void *) {
+    image->image.assign(bytes, bytes + size);
+    image->width     = -1;
+    image->height    = -1;
+    image->component = -1;
+    image->bits      = -1;
+    if (image->mimeType.empty())
+        image->mimeType = SniffMimeType(image->image);
+    return true;
+}
+
+// --- 4. GLB 加载器 ---
+// Accessor data as raw bytes: element i starts at data + i * stride.
+struct AccessorView {
+    const unsigned char *data = nullptr;
+    size_t count              = 0;
+    size_t stride             = 0;
+    int componentType         = 0;
+    int components            = 0;
+};
+
+// One primitive to copy into the mesh, with its slots in the preallocated vertex/face arrays.
+struct PrimitiveSource {
+    AccessorView pos, uv, color, indices;
+    int material      = -1;
+    size_t vertOffset = 0;
+    size_t faceOffset = 0;
+};
+
+static size_t ComponentSize(int componentType) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return 1;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        return 2;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Reads n components of element i as floats; integer components are normalized.
+static void ReadFloats(const AccessorView &a, size_t i, float *out, int n) {
+    const unsigned char *e = a.data + i * a.stride;
+    for (int k = 0; k < n; ++k) {
+        if (a.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+            std::memcpy(&out[k], e + 4 * k, 4);
+        } else if (a.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+            uint16_t c;
+            std::memcpy(&c, e + 2 * k, 2);
+            out[k] = c / 65535.0f;
+        } else if (a.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+            out[k] = e[k] / 255.0f;
+        } else {
+            out[k] = 0.0f;
+        }
+    }
+}
+
+static uint32_t ReadIndex(const AccessorView &a, size_t i) {
+    const unsigned char *e = a.data + i * a.stride;
+    if (a.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
+        uint16_t idx;
+        std::memcpy(&idx, e, 2);
+        return idx;
+    }
+    if (a.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+        uint32_t idx;
+        std::memcpy(&idx, e, 4);
+        return idx;
+    }
+    if (a.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+        return *e;
+    return 0;
+}
+
+static vcg::Point3f ReadPosition(const PrimitiveSource &p, size_t i) {
+    float xyz[3];
+    ReadFloats(p.pos, i, xyz, 3);
+    return vcg::Point3f(xyz[0], xyz[1], xyz[2]);
+}
+
+// 处理颜色
+static vcg::Color4b ReadColor(const PrimitiveSource &p, size_t i) {
+    if (!p.color.data || i >= p.color.count)
+        return vcg::Color4b::White;
+    float c[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    ReadFloats(p.color, i, c, std::min(p.color.components, 4));
+    return vcg::Color4b((uint8_t)(c[0] * 255), (uint8_t)(c[1] * 255), (uint8_t)(c[2] * 255),
+                        (uint8_t)(c[3] * 255));
+}
+
+// Index of corner k of face f, or false if the face refers to a vertex the primitive lacks.
+static bool ReadTriangle(const PrimitiveSource &p, size_t f, uint32_t idx[3]) {
+    bool valid = true;
+    for (int k = 0; k < 3; ++k) {
+        idx[k] = ReadIndex(p.indices, f * 3 + k);
+        valid &= idx[k] < p.pos.count;
+    }
+    return valid;
+}
+
+static MyFace::TexCoordType ReadUV(const PrimitiveSource &p, uint32_t idx) {
+    float uv[2] = {0.0f, 0.0f};
+    if (p.uv.data && idx < p.uv.count)
+        ReadFloats(p.uv, idx, uv, 2);
+    return MyFace::TexCoordType(uv[0], uv[1]);
+}
+
+// Writes the vertices and faces of one primitive into its slots. Primitives never share slots,
+// so they can be filled concurrently.
+static void FillPrimitive(MyMesh &m, const PrimitiveSource &p) {
+    const size_t vertCount = p.pos.count;
+    for (size_t i = 0; i < vertCount; ++i) {
+        MyVertex &v = m.vert[p.vertOffset + i];
+        v.P()       = ReadPosition(p, i);
+        v.C()       = ReadColor(p, i);
+    }
+
+    // --- 填充面 (Indices) ---
+    if (!p.indices.data)
+        return;
+    const size_t faceCount = p.indices.count / 3;
+    for (size_t f = 0; f < faceCount; ++f) {
+        MyFace &face = m.face[p.faceOffset + f];
+        uint32_t idx[3];
+        if (!ReadTriangle(p, f, idx))
+            idx[0] = idx[1] = idx[2] = 0; // broken indices: a degenerate face for Clean to remove
+        for (int k = 0; k < 3; ++k) {
+            face.V(k) = &m.vert[p.vertOffset + idx[k]];
+            if (p.uv.data)
+                face.WT(k) = ReadUV(p, idx[k]);
+        }
+        face.matId = p.material;
+    }
+}
+
+static void FillPrimitive(CompactMesh &m, const PrimitiveSource &p) {
+    const size_t vertCount = p.pos.count;
+    for (size_t i = 0; i < vertCount; ++i) {
+        const vcg::Point3f pos = ReadPosition(p, i);
+        float *out             = &m.positions[(p.vertOffset + i) * 3];
+        for (int k = 0; k < 3; ++k)
+            out[k] = pos[k];
+        m.colors[p.vertOffset + i] = CompactMesh::PackColor(ReadColor(p, i));
+    }
+
+    if (!p.indices.data)
+        return;
+    const size_t faceCount = p.indices.count / 3;
+    for (size_t f = 0; f < faceCount; ++f) {
+        const size_t face = p.faceOffset + f;
+        uint32_t idx[3];
+        if (!ReadTriangle(p, f, idx))
+            idx[0] = idx[1] = idx[2] = 0;
+        for (int k = 0; k < 3; ++k) {
+            m.indices[face * 3 + k] = uint32_t(p.vertOffset + idx[k]);
+            if (p.uv.data) {
+                MyFace::TexCoordType uv     = ReadUV(p, idx[k]);
+                m.uvs[face * 6 + k * 2]     = uv.U();
+                m.uvs[face * 6 + k * 2 + 1] = uv.V();
+            }
+        }
+        m.matIds[face] = p.material;
+    }
+}
+
+static void Allocate(MyMesh &m, size_t vertices, size_t faces) {
+    m.Clear();
+    vcg::tri::Allocator<MyMesh>::AddVertices(m, vertices);
+    vcg::tri::Allocator<MyMesh>::AddFaces(m, faces);
+}
+
+static void Allocate(CompactMesh &m, size_t vertices, size_t faces) {
+    m.Clear();
+    m.Resize(vertices, faces);
+}
+
+// Assigns vertex/face slots to the primitives, allocates the mesh once and fills the primitives
+// in parallel. Mesh is MyMesh or CompactMesh.
+template <class Mesh> static bool FillMesh(Mesh &m, std::vector<PrimitiveSource> &prims) {
+    size_t totalVertices = 0;
+    size_t totalFaces    = 0;
+    for (PrimitiveSource &p : prims) {
+        p.vertOffset = totalVertices;
+        p.faceOffset = totalFaces;
+        totalVertices += p.pos.count;
+        totalFaces += p.indices.data ? p.indices.count / 3 : 0;
+    }
+    if (prims.empty())
+        return false;
+
+    printf("LoadGLB: Pre-allocating %zu vertices and %zu faces.\n", totalVertices, totalFaces);
+    Allocate(m, totalVertices, totalFaces);
+
+    ParallelForEach(prims.size(), ResolveThreadCount(0),
+                    [&](size_t i, int) { FillPrimitive(m, prims[i]); });
+
+    printf("LoadGLB: Finished. Loaded %zu vertices, %zu faces.\n", totalVertices, totalFaces);
+    return true;
+}
+
+// --- 4.1 tinygltf 路径 (external buffers, sparse or compressed accessors, decoded images) ---
+static AccessorView ModelView(const tinygltf::Model &model, int accessorIndex) {
+    AccessorView view;
+    const auto &acc = model.accessors[accessorIndex];
+    if (acc.bufferView < 0)
+        return view;
+    const auto &bv     = model.bufferViews[acc.bufferView];
+    int stride         = acc.ByteStride(bv);
+    view.data          = model.buffers[bv.buffer].data.data() + bv.byteOffset + acc.byteOffset;
+    view.count         = acc.count;
+    view.componentType = acc.componentType;
+    view.components    = tinygltf::GetNumComponentsInType(acc.type);
+    view.stride        = stride > 0 ? size_t(stride) : 0;
+    if (!view.stride)
+        view.data = nullptr;
+    return view;
+}
+
+template <class Mesh>
+static bool LoadGLBWithTinyGLTF(Mesh &m, tinygltf::Model &outModel, const std::string &filename,
+                                bool decodeImages) {
     tinygltf::TinyGLTF loader;
+    if (!decodeImages)
+        loader.SetImageLoader(KeepEncodedImage, nullptr);
     std::string err, warn;
     bool ret = loader.LoadBinaryFromFile(&outModel, &err, &warn, filename);
 
@@ -18,211 +277,316 @@ bool LoadGLB(MyMesh &m, tinygltf::Model &outModel, const std::string &filename)
         printf("GLB Err: %s\n", err.c_str());
     if (!ret)
         return false;
-
-    if (outModel.meshes.empty())
+    if (std::find(outModel.extensionsRequired.begin(), outModel.extensionsRequired.end(),
+                  "KHR_mesh_quantization") != outModel.extensionsRequired.end()) {
+        printf("GLB Err: KHR_mesh_quantization input (integer positions, node TRS) is not "
+               "supported\n");
         return false;
-
-    // --- Phase 1: Count total vertices and faces ---
-    int totalVertices = 0;
-    int totalFaces    = 0;
-
-    for (const auto &mesh : outModel.meshes) {
-        for (const auto &primitive : mesh.primitives) {
-            if (primitive.attributes.find("POSITION") != primitive.attributes.end()) {
-                const auto &posAcc = outModel.accessors[primitive.attributes.at("POSITION")];
-                totalVertices += posAcc.count;
-            }
-            if (primitive.indices >= 0) {
-                const auto &indAcc = outModel.accessors[primitive.indices];
-                totalFaces += indAcc.count / 3;
-            }
-        }
     }
 
-    printf("LoadGLB: Pre-allocating %d vertices and %d faces.\n", totalVertices, totalFaces);
-    m.Clear();
-    vcg::tri::Allocator<MyMesh>::AddVertices(m, totalVertices);
-    vcg::tri::Allocator<MyMesh>::AddFaces(m, totalFaces);
-
-    // --- Phase 2: Fill data ---
-    int globalVertOffset = 0;
-    int globalFaceOffset = 0;
-
-    // 遍历所有的 Mesh
+    std::vector<PrimitiveSource> prims;
     int meshCount = 0;
     for (const auto &mesh : outModel.meshes) {
         printf("Loading Mesh %d with %d primitives\n", meshCount++, (int)mesh.primitives.size());
-        int primIdx = 0;
-        // 遍历 Mesh 里的所有 Primitive (子网格)
         for (const auto &primitive : mesh.primitives) {
-
-            // --- 1. 读取位置 (Position) ---
-            if (primitive.attributes.find("POSITION") == primitive.attributes.end()) {
+            auto pos = primitive.attributes.find("POSITION");
+            if (pos == primitive.attributes.end()) {
                 printf("  [Warning] Skip Primitive: No POSITION attribute found.\n");
                 continue;
             }
+            PrimitiveSource p;
+            p.pos      = ModelView(outModel, pos->second);
+            p.material = primitive.material;
+            auto uv    = primitive.attributes.find("TEXCOORD_0");
+            if (uv != primitive.attributes.end())
+                p.uv = ModelView(outModel, uv->second);
+            auto color = primitive.attributes.find("COLOR_0");
+            if (color != primitive.attributes.end())
+                p.color = ModelView(outModel, color->second);
+            if (primitive.indices >= 0)
+                p.indices = ModelView(outModel, primitive.indices);
+            if (!p.pos.data)
+                continue;
+            prims.push_back(p);
+        }
+    }
+    bool ok = FillMesh(m, prims);
+    // Only the metadata is needed from here on (SaveGLB copies materials/textures/images).
+    outModel.buffers.clear();
+    return ok;
+}
 
-            const auto &posAcc     = outModel.accessors[primitive.attributes.at("POSITION")];
-            const auto &posView    = outModel.bufferViews[posAcc.bufferView];
-            const float *positions = reinterpret_cast<const float *>(
-                &outModel.buffers[posView.buffer].data[posView.byteOffset + posAcc.byteOffset]);
-            int posStride = posAcc.ByteStride(posView) ? (posAcc.ByteStride(posView) / 4) : 3;
-
-            // --- 2. 读取 UV ---
-            const float *texCoords = nullptr;
-            int texStride          = 0;
-            if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-                const auto &texAcc  = outModel.accessors[primitive.attributes.at("TEXCOORD_0")];
-                const auto &texView = outModel.bufferViews[texAcc.bufferView];
-                texCoords           = reinterpret_cast<const float *>(
-                    &outModel.buffers[texView.buffer].data[texView.byteOffset + texAcc.byteOffset]);
-                texStride = texAcc.ByteStride(texView) ? (texAcc.ByteStride(texView) / 4) : 2;
-            }
+// --- 4.2 内存映射路径 ---
+// Collects accessor views into the mapped BIN chunk for every primitive. Only
+// asset/materials/textures/samplers go through tinygltf; images are copied out of the BIN chunk
+// still encoded. Returns false for anything it does not handle, so the caller can use the
+// tinygltf path.
+static bool ParseMappedGLB(const MappedFile &file, std::vector<PrimitiveSource> &prims,
+                           tinygltf::Model &outModel) {
+    using Json = nlohmann::json;
+    const uint32_t kMagic = 0x46546C67; // "glTF"
+    const uint32_t kJson  = 0x4E4F534A; // "JSON"
+    const uint32_t kBin   = 0x004E4942; // "BIN\0"
+
+    if (file.Size() < 20)
+        return false;
+    const unsigned char *bytes = file.Data();
+    auto u32 = [&](size_t at) {
+        uint32_t v;
+        std::memcpy(&v, bytes + at, 4);
+        return v;
+    };
+    if (u32(0) != kMagic || u32(4) != 2 || u32(8) > file.Size())
+        return false;
+    const size_t fileSize = u32(8);
+    const size_t jsonSize = u32(12);
+    if (u32(16) != kJson || 20 + jsonSize > fileSize)
+        return false;
+    const char *jsonText = reinterpret_cast<const char *>(bytes + 20);
+
+    const unsigned char *bin = nullptr;
+    size_t binSize           = 0;
+    size_t binChunk          = 20 + ((jsonSize + 3) & ~size_t(3));
+    if (binChunk + 8 <= fileSize && u32(binChunk + 4) == kBin) {
+        bin     = bytes + binChunk + 8;
+        binSize = std::min<size_t>(u32(binChunk), fileSize - binChunk - 8);
+    }
 
-            // --- 2.1 读取颜色 (Color) ---
-            const void *colors = nullptr; // 可以是 float 或 u8/u16
-            int colorCompType  = TINYGLTF_COMPONENT_TYPE_FLOAT;
-            int colorType      = TINYGLTF_TYPE_VEC4;
-            int colorStride    = 0;
-
-            if (primitive.attributes.find("COLOR_0") != primitive.attributes.end()) {
-                const auto &colAcc  = outModel.accessors[primitive.attributes.at("COLOR_0")];
-                const auto &colView = outModel.bufferViews[colAcc.bufferView];
-                colors =
-                    &outModel.buffers[colView.buffer].data[colView.byteOffset + colAcc.byteOffset];
-                colorCompType = colAcc.componentType;
-                colorType     = colAcc.type;
-                colorStride   = colAcc.ByteStride(colView);
+    try {
+        Json doc = Json::parse(jsonText, jsonText + jsonSize);
+
+        // Everything must live in the embedded BIN buffer.
+        const Json &buffers = doc.value("buffers", Json::array());
+        if (buffers.size() > 1 || (buffers.size() == 1 && buffers[0].contains("uri")))
+            return false;
+        // Quantized attributes need the node transforms to be decoded, which this reader ignores;
+        // the tinygltf path reports them.
+        for (const Json &ext : doc.value("extensionsRequired", Json::array())) {
+            if (ext == "KHR_mesh_quantization")
+                return false;
+        }
+        const Json &accessors   = doc.value("accessors", Json::array());
+        const Json &bufferViews = doc.value("bufferViews", Json::array());
+
+        auto bufferViewBytes = [&](size_t index, const unsigned char *&data, size_t &length) {
+            const Json &bv = bufferViews.at(index);
+            size_t offset  = bv.value("byteOffset", size_t(0));
+            length         = bv.at("byteLength").get<size_t>();
+            if (!bin || bv.value("buffer", 0) != 0 || offset + length > binSize)
+                return false;
+            data = bin + offset;
+            return true;
+        };
+
+        auto accessorView = [&](const Json &index, AccessorView &view) {
+            const Json &acc = accessors.at(index.get<size_t>());
+            if (!acc.contains("bufferView") || acc.contains("sparse"))
+                return false;
+            static const char *kTypes[] = {"SCALAR", "VEC2", "VEC3", "VEC4"};
+            std::string type            = acc.at("type").get<std::string>();
+            view.components             = 0;
+            for (int t = 0; t < 4; ++t) {
+                if (type == kTypes[t])
+                    view.components = t + 1;
             }
-
-            // --- 3. 填充顶点 ---
-            // 使用 globalVertOffset
-            int currentPrimVertCount = posAcc.count;
-
-            for (size_t i = 0; i < currentPrimVertCount; ++i) {
-                m.vert[globalVertOffset + i].P() =
-                    MyVertex::CoordType(positions[i * posStride], positions[i * posStride + 1],
-                                        positions[i * posStride + 2]);
-
-                // 处理颜色
-                if (colors) {
-                    float r = 1.0f, g = 1.0f, b = 1.0f, a = 1.0f;
-                    size_t offset = i * (colorStride ? colorStride : 0); // Stride 处理
-
-                    if (colorCompType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
-                        const float *c =
-                            (const float *)((const char *)colors +
-                                            (colorStride
-                                                 ? offset
-                                                 : i * (colorType == TINYGLTF_TYPE_VEC4 ? 16
-                                                                                        : 12)));
-                        r = c[0];
-                        g = c[1];
-                        b = c[2];
-                        if (colorType == TINYGLTF_TYPE_VEC4)
-                            a = c[3];
-                    } else if (colorCompType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-                        // Normalized USHORT
-                        const unsigned short *c =
-                            (const unsigned short *)((const char *)colors +
-                                                     (colorStride
-                                                          ? offset
-                                                          : i * (colorType == TINYGLTF_TYPE_VEC4
-                                                                     ? 8
-                                                                     : 6)));
-                        r = c[0] / 65535.0f;
-                        g = c[1] / 65535.0f;
-                        b = c[2] / 65535.0f;
-                        if (colorType == TINYGLTF_TYPE_VEC4)
-                            a = c[3] / 65535.0f;
-                    } else if (colorCompType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-                        // Normalized UBYTE
-                        const unsigned char *c =
-                            (const unsigned char *)((const char *)colors +
-                                                    (colorStride
-                                                         ? offset
-                                                         : i * (colorType == TINYGLTF_TYPE_VEC4
-                                                                    ? 4
-                                                                    : 3)));
-                        r = c[0] / 255.0f;
-                        g = c[1] / 255.0f;
-                        b = c[2] / 255.0f;
-                        if (colorType == TINYGLTF_TYPE_VEC4)
-                            a = c[3] / 255.0f;
-                    }
-
-                    m.vert[globalVertOffset + i].C() =
-                        vcg::Color4b((uint8_t)(r * 255), (uint8_t)(g * 255), (uint8_t)(b * 255),
-                                     (uint8_t)(a * 255));
-                } else {
-                    m.vert[globalVertOffset + i].C() = vcg::Color4b::White;
+            view.componentType = acc.at("componentType").get<int>();
+            view.count         = acc.at("count").get<size_t>();
+            size_t elementSize = ComponentSize(view.componentType) * view.components;
+            if (!elementSize)
+                return false;
+
+            size_t viewIndex = acc.at("bufferView").get<size_t>();
+            const unsigned char *data;
+            size_t length;
+            if (!bufferViewBytes(viewIndex, data, length))
+                return false;
+            size_t offset = acc.value("byteOffset", size_t(0));
+            view.stride   = bufferViews.at(viewIndex).value("byteStride", size_t(0));
+            if (!view.stride)
+                view.stride = elementSize;
+            if (view.count && offset + view.stride * (view.count - 1) + elementSize > length)
+                return false;
+            view.data = data + offset;
+            return true;
+        };
+
+        prims.clear();
+        int meshCount = 0;
+        for (const Json &mesh : doc.value("meshes", Json::array())) {
+            const Json &primitives = mesh.value("primitives", Json::array());
+            printf("Loading Mesh %d with %d primitives\n", meshCount++, (int)primitives.size());
+            for (const Json &primitive : primitives) {
+                if (primitive.contains("extensions"))
+                    return false; // e.g. Draco compressed geometry
+                const Json &attributes = primitive.at("attributes");
+                if (!attributes.contains("POSITION")) {
+                    printf("  [Warning] Skip Primitive: No POSITION attribute found.\n");
+                    continue;
                 }
+                PrimitiveSource p;
+                p.material = primitive.value("material", -1);
+                if (!accessorView(attributes.at("POSITION"), p.pos))
+                    return false;
+                if (attributes.contains("TEXCOORD_0") &&
+                    !accessorView(attributes.at("TEXCOORD_0"), p.uv))
+                    return false;
+                if (attributes.contains("COLOR_0") &&
+                    !accessorView(attributes.at("COLOR_0"), p.color))
+                    return false;
+                if (primitive.contains("indices") &&
+                    !accessorView(primitive.at("indices"), p.indices))
+                    return false;
+                prims.push_back(p);
             }
+        }
 
-            // --- 4. 填充面 (Indices) ---
-            if (primitive.indices >= 0) {
-                const auto &indAcc  = outModel.accessors[primitive.indices];
-                const auto &indView = outModel.bufferViews[indAcc.bufferView];
-                const unsigned char *dataPtr =
-                    &outModel.buffers[indView.buffer].data[indView.byteOffset + indAcc.byteOffset];
-                int indStride = indAcc.ByteStride(indView);
-
-                int currentPrimFaceCount = indAcc.count / 3;
-                // 注意：这里不调用 AddFaces，而是直接使用 globalFaceOffset
-
-                for (size_t i = 0; i < indAcc.count; i += 3) {
-                    uint32_t idx[3];
-                    // 解析不同类型的索引
-                    for (int k = 0; k < 3; ++k) {
-                        size_t offset = (i + k);
-                        if (indAcc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-                            idx[k] = *reinterpret_cast<const uint16_t *>(
-                                dataPtr + offset * (indStride ? indStride : 2));
-                        } else if (indAcc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-                            idx[k] = *reinterpret_cast<const uint32_t *>(
-                                dataPtr + offset * (indStride ? indStride : 4));
-                        } else if (indAcc.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-                            idx[k] = *reinterpret_cast<const uint8_t *>(
-                                dataPtr + offset * (indStride ? indStride : 1));
-                        } else {
-                            idx[k] = 0;
-                        }
-                    }
-
-                    // 【关键】加上 globalVertOffset
-                    m.face[globalFaceOffset].V(0) = &m.vert[globalVertOffset + idx[0]];
-                    m.face[globalFaceOffset].V(1) = &m.vert[globalVertOffset + idx[1]];
-                    m.face[globalFaceOffset].V(2) = &m.vert[globalVertOffset + idx[2]];
-
-                    // Set Material ID
-                    m.face[globalFaceOffset].matId = primitive.material;
-
-                    if (texCoords) {
-                        m.face[globalFaceOffset].WT(0) = MyFace::TexCoordType(
-                            texCoords[idx[0] * texStride], texCoords[idx[0] * texStride + 1]);
-                        m.face[globalFaceOffset].WT(1) = MyFace::TexCoordType(
-                            texCoords[idx[1] * texStride], texCoords[idx[1] * texStride + 1]);
-                        m.face[globalFaceOffset].WT(2) = MyFace::TexCoordType(
-                            texCoords[idx[2] * texStride], texCoords[idx[2] * texStride + 1]);
-                    }
-                    globalFaceOffset++;
-                }
-            }
+        // Images: encoded bytes are copied out of the mapping, never decoded.
+        std::vector<tinygltf::Image> images;
+        for (const Json &img : doc.value("images", Json::array())) {
+            if (!img.contains("bufferView"))
+                return false;
+            const unsigned char *data;
+            size_t length;
+            if (!bufferViewBytes(img.at("bufferView").get<size_t>(), data, length))
+                return false;
+            tinygltf::Image image;
+            image.name     = img.value("name", std::string());
+            image.mimeType = img.value("mimeType", std::string());
+            KeepEncodedImage(&image, 0, nullptr, nullptr, 0, 0, data, int(length), nullptr);
+            images.push_back(std::move(image));
+        }
 
-            // 更新全局偏移
-            globalVertOffset += currentPrimVertCount;
+        // The rest of the metadata SaveGLB copies is small: let tinygltf parse just that.
+        Json meta;
+        for (const char *key : {"asset", "materials", "textures", "samplers", "extensionsUsed",
+                                "extensionsRequired"}) {
+            if (doc.contains(key))
+                meta[key] = doc[key];
+        }
+        std::string metaText = meta.dump();
+        tinygltf::TinyGLTF loader;
+        std::string err, warn;
+        tinygltf::Model model;
+        if (!loader.LoadASCIIFromString(&model, &err, &warn, metaText.c_str(),
+                                        (unsigned int)metaText.size(), ""))
+            return false;
+        if (!warn.empty())
+            printf("GLB Warn: %s\n", warn.c_str());
+        model.images = std::move(images);
+        outModel     = std::move(model);
+        return true;
+    } catch (const std::exception &e) {
+        printf("LoadGLB: %s, falling back to tinygltf.\n", e.what());
+        return false;
+    }
+}
+
+// Reads the mesh straight out of the mapped BIN chunk, without touching `m` on failure.
+template <class Mesh>
+static bool LoadGLBMapped(Mesh &m, tinygltf::Model &outModel, const std::string &filename) {
+    MappedFile file;
+    std::vector<PrimitiveSource> prims;
+    tinygltf::Model model;
+    if (!file.Open(filename) || !ParseMappedGLB(file, prims, model) || !FillMesh(m, prims))
+        return false;
+    outModel = std::move(model);
+    return true;
+}
+
+bool ForEachGLBTriangle(const std::string &filename, tinygltf::Model &outModel,
+                        const GLBTriangleCallback &fn) {
+    MappedFile file;
+    std::vector<PrimitiveSource> prims;
+    if (!file.Open(filename) || !ParseMappedGLB(file, prims, outModel))
+        return false;
 
-            printf("  Processing Primitive %d (Material Index: %d, Indices: %d) Done.\n", primIdx++,
-                   primitive.material, primitive.indices);
+    uint64_t vertBase = 0;
+    GLBTriangle tri;
+    for (const PrimitiveSource &p : prims) {
+        const size_t faceCount = p.indices.data ? p.indices.count / 3 : 0;
+        tri.matId              = p.material;
+        for (size_t f = 0; f < faceCount; ++f) {
+            uint32_t idx[3];
+            if (!ReadTriangle(p, f, idx))
+                continue;
+            for (int k = 0; k < 3; ++k) {
+                tri.vert[k]  = vertBase + idx[k];
+                tri.pos[k]   = ReadPosition(p, idx[k]);
+                tri.color[k] = ReadColor(p, idx[k]);
+                tri.uv[k]    = ReadUV(p, idx[k]);
+            }
+            fn(tri);
         }
+        vertBase += p.pos.count;
     }
-    printf("LoadGLB: Finished. Loaded %d vertices, %d faces.\n", globalVertOffset,
-           globalFaceOffset);
     return true;
 }
 
+bool LoadGLB(MyMesh &m, tinygltf::Model &outModel, const std::string &filename,
+             bool decodeImages) {
+    if (!decodeImages && LoadGLBMapped(m, outModel, filename))
+        return true;
+    return LoadGLBWithTinyGLTF(m, outModel, filename, decodeImages);
+}
+
+bool LoadGLB(CompactMesh &m, tinygltf::Model &outModel, const std::string &filename,
+             bool decodeImages) {
+    if (!decodeImages && LoadGLBMapped(m, outModel, filename))
+        return true;
+    return LoadGLBWithTinyGLTF(m, outModel, filename, decodeImages);
+}
+
+
+static void PrintGpuEfficiency(const char *label, const GpuEfficiency &e) {
+    printf("  %-7s ACMR %.3f  ATVR %.3f  overdraw %.3f  overfetch %.3f\n", label, e.acmr, e.atvr,
+           e.overdraw, e.overfetch);
+}
+
+// Reorders the triangles of every material group for the vertex cache, then for overdraw, and
+// the output vertices in the order the indices first use them. Prints the efficiency before and
+// after.
+static void OptimizeForGpu(const MyMesh &m, const std::vector<size_t> &groupStart,
+                           std::vector<uint32_t> &indices, std::vector<int> &outVert,
+                           std::vector<MyFace::TexCoordType> &outUV) {
+    const size_t vertexCount = outVert.size();
+    // As the GPU reads them: position, normal, UV and color.
+    const size_t vertexStride = 3 * sizeof(float) + 3 * sizeof(float) + 2 * sizeof(float) + 4;
+    std::vector<float> positions(vertexCount * 3);
+    for (size_t o = 0; o < vertexCount; ++o) {
+        for (int k = 0; k < 3; ++k)
+            positions[o * 3 + k] = m.vert[outVert[o]].cP()[k];
+    }
+    GpuEfficiency before = AnalyzeGpuEfficiency(indices.data(), indices.size(), positions.data(),
+                                                vertexCount, vertexStride);
+
+    for (size_t g = 0; g + 1 < groupStart.size(); ++g) {
+        uint32_t *group   = indices.data() + groupStart[g];
+        size_t indexCount = groupStart[g + 1] - groupStart[g];
+        OptimizeVertexCache(group, indexCount, vertexCount);
+        OptimizeOverdraw(group, indexCount, positions.data(), vertexCount);
+    }
+    std::vector<uint32_t> remap = OptimizeVertexFetch(indices.data(), indices.size(), vertexCount);
+    std::vector<int> vert(vertexCount);
+    std::vector<MyFace::TexCoordType> uv(vertexCount);
+    std::vector<float> remapped(vertexCount * 3);
+    for (size_t o = 0; o < vertexCount; ++o) {
+        vert[remap[o]] = outVert[o];
+        uv[remap[o]]   = outUV[o];
+        std::copy(&positions[o * 3], &positions[o * 3] + 3, &remapped[remap[o] * 3]);
+    }
+    outVert.swap(vert);
+    outUV.swap(uv);
+
+    GpuEfficiency after = AnalyzeGpuEfficiency(indices.data(), indices.size(), remapped.data(),
+                                               vertexCount, vertexStride);
+    printf("SaveGLB: GPU order (%d material groups):\n", int(groupStart.size() - 1));
+    PrintGpuEfficiency("before", before);
+    PrintGpuEfficiency("after", after);
+}
+
 // --- 5. GLB 保存器 (已修复编译错误与MeshLab兼容性) ---
-bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string &filename) {
+bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string &filename,
+             const GLBSaveOptions &options) {
     tinygltf::Model outModel;
 
     // 1. 复制配置
@@ -236,128 +600,102 @@ bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string
     outModel.images    = originalModel.images;
 
     // 清除 BufferView 索引，强制 TinyGLTF 重新打包图片数据
+    // (encoded images get a bufferView into our own buffer further down instead)
     for (auto &img : outModel.images) {
         img.bufferView = -1;
         img.uri        = "";
     }
 
-    // 2. 准备几何数据容器
-    std::vector<float> rawPos;
-    std::vector<float> rawNor;
-    std::vector<float> rawUV;
-    std::vector<unsigned char> rawColorUB;
-
-    // Split indices by material ID
-    std::map<int, std::vector<unsigned int>> materialGroups;
-
-    // 用于裂解顶点 (Wedge UV -> Vertex Attributes)
-    struct VertKey {
-        int vIdx;
-        float u, v;
-        bool operator<(const VertKey &o) const {
-            if (vIdx != o.vIdx)
-                return vIdx < o.vIdx;
-            if (u != o.u)
-                return u < o.u;
-            return v < o.v;
-        }
+    // 2. 裂解顶点 (Wedge UV -> Vertex Attributes)
+    // A mesh vertex becomes one output vertex per distinct corner UV. The output vertices of a
+    // mesh vertex form a short chain (firstOut -> nextOut), so a lookup only compares against the
+    // UVs already emitted for that vertex instead of searching a global map.
+    const size_t vertSlots = m.vert.size();
+    std::vector<int> firstOut(vertSlots, -1);
+    std::vector<int> nextOut;
+    std::vector<int> outVert; // output vertex -> mesh vertex
+    std::vector<MyFace::TexCoordType> outUV;
+    nextOut.reserve(vertSlots);
+    outVert.reserve(vertSlots);
+    outUV.reserve(vertSlots);
+
+    // Split indices by material ID: count first, so every group gets an exact slice of one
+    // index array. Groups are written in ascending matId order.
+    std::vector<int> groupMat; // distinct matIds, ascending
+    for (const auto &f : m.face) {
+        if (f.IsD())
+            continue;
+        auto it = std::lower_bound(groupMat.begin(), groupMat.end(), f.matId);
+        if (it == groupMat.end() || *it != f.matId)
+            groupMat.insert(it, f.matId);
+    }
+    auto groupOf = [&](const MyFace &f) {
+        return size_t(std::lower_bound(groupMat.begin(), groupMat.end(), f.matId) -
+                      groupMat.begin());
     };
-    std::map<VertKey, unsigned int> uniqueMap;
-    int idxCounter = 0;
-
-    // 【关键修复】计算包围盒 (Min/Max)，MeshLab 必须需要这个
-    std::vector<double> posMin = {1e9, 1e9, 1e9};
-    std::vector<double> posMax = {-1e9, -1e9, -1e9};
+    std::vector<size_t> groupStart(groupMat.size() + 1, 0);
+    for (const auto &f : m.face) {
+        if (!f.IsD())
+            groupStart[groupOf(f) + 1] += 3;
+    }
+    for (size_t g = 1; g < groupStart.size(); ++g)
+        groupStart[g] += groupStart[g - 1];
+    std::vector<size_t> groupCursor(groupStart);
 
+    std::vector<uint32_t> allIndices(groupStart.back());
     for (auto &f : m.face) {
         if (f.IsD())
             continue;
+        size_t &cursor = groupCursor[groupOf(f)];
         for (int i = 0; i < 3; ++i) {
-            int vIdx = vcg::tri::Index(m, f.V(i));
-            float u  = f.WT(i).u();
-            float v  = f.WT(i).v();
-
-            VertKey key = {vIdx, u, v};
-            auto it     = uniqueMap.find(key);
-
-            unsigned int finalIdx;
-            if (it != uniqueMap.end()) {
-                finalIdx = it->second;
-            } else {
-                uniqueMap[key] = idxCounter;
-                finalIdx       = idxCounter;
-
-                float px = f.V(i)->P().X();
-                float py = f.V(i)->P().Y();
-                float pz = f.V(i)->P().Z();
-
-                rawPos.push_back(px);
-                rawPos.push_back(py);
-                rawPos.push_back(pz);
-
-                // 更新 Min/Max
-                if (px < posMin[0])
-                    posMin[0] = px;
-                if (px > posMax[0])
-                    posMax[0] = px;
-                if (py < posMin[1])
-                    posMin[1] = py;
-                if (py > posMax[1])
-                    posMax[1] = py;
-                if (pz < posMin[2])
-                    posMin[2] = pz;
-                if (pz > posMax[2])
-                    posMax[2] = pz;
-
-                rawNor.push_back(f.V(i)->N().X());
-                rawNor.push_back(f.V(i)->N().Y());
-                rawNor.push_back(f.V(i)->N().Z());
-
-                rawUV.push_back(u);
-                rawUV.push_back(v);
-
-                // Color
-                vcg::Color4b c = f.V(i)->C();
-                rawColorUB.push_back(c[0]);
-                rawColorUB.push_back(c[1]);
-                rawColorUB.push_back(c[2]);
-                rawColorUB.push_back(c[3]);
-
-                idxCounter++;
+            int vIdx                       = (int)vcg::tri::Index(m, f.V(i));
+            const MyFace::TexCoordType &uv = f.WT(i);
+
+            int out = firstOut[vIdx];
+            while (out >= 0 && (outUV[out].u() != uv.u() || outUV[out].v() != uv.v()))
+                out = nextOut[out];
+            if (out < 0) {
+                out = (int)outVert.size();
+                outVert.push_back(vIdx);
+                outUV.push_back(uv);
+                nextOut.push_back(firstOut[vIdx]);
+                firstOut[vIdx] = out;
             }
-            // Store index in the appropriate material group
-            materialGroups[f.matId].push_back(finalIdx);
+            allIndices[cursor++] = (uint32_t)out;
         }
     }
-
-    // Flatten indices for buffer creation
-    std::vector<unsigned int> allIndices;
-    // Store offsets to create accessors later
-    struct MatGroupInfo {
-        int matId;
-        size_t indexStart;
-        size_t indexCount;
-    };
-    std::vector<MatGroupInfo> matGroupInfos;
-
-    for (auto &pair : materialGroups) {
-        MatGroupInfo info;
-        info.matId      = pair.first;
-        info.indexStart = allIndices.size(); // Offset in count, not bytes
-        info.indexCount = pair.second.size();
-        matGroupInfos.push_back(info);
-
-        allIndices.insert(allIndices.end(), pair.second.begin(), pair.second.end());
+    if (options.optimizeForGpu)
+        OptimizeForGpu(m, groupStart, allIndices, outVert, outUV);
+    const size_t vertexCount = outVert.size();
+    // Use 16 bit indices whenever every index fits.
+    const bool shortIndices = vertexCount < 65536;
+    const size_t indexSize  = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    // KHR_mesh_quantization: attribute formats, each element padded to 4 bytes.
+    const GLBQuantization &quant = options.quantization;
+    const int positionBits       = std::clamp(quant.positionBits, 2, 16);
+    const int normalBits         = std::clamp(quant.normalBits, 2, 16);
+    const int uvBits             = std::clamp(quant.uvBits, 1, 16);
+    const bool shortPositions    = positionBits > 8;
+    const bool shortNormals      = normalBits > 8;
+    const bool shortUVs          = uvBits > 8;
+    bool unitUVs                 = quant.enabled;
+    for (size_t o = 0; unitUVs && o < vertexCount; ++o) {
+        float u = outUV[o].u(), v = outUV[o].v();
+        unitUVs = u >= 0 && u <= 1 && v >= 0 && v <= 1;
     }
+    const size_t posSize = !quant.enabled ? 3 * sizeof(float) : shortPositions ? 8 : 4;
+    const size_t norSize = !quant.enabled ? 3 * sizeof(float) : shortNormals ? 8 : 4;
+    const size_t uvSize  = unitUVs ? 4 : 2 * sizeof(float);
 
-    // 3. 构建二进制 Buffer
+    // 3. 构建二进制 Buffer (sizes are known, attributes are written in place)
     tinygltf::Buffer buffer;
 
-    size_t lenPos = rawPos.size() * sizeof(float);
-    size_t lenNor = rawNor.size() * sizeof(float);
-    size_t lenUV  = rawUV.size() * sizeof(float);
-    size_t lenCol = rawColorUB.size() * sizeof(unsigned char);
-    size_t lenInd = allIndices.size() * sizeof(unsigned int);
+    size_t lenPos = vertexCount * posSize;
+    size_t lenNor = vertexCount * norSize;
+    size_t lenUV  = vertexCount * uvSize;
+    size_t lenCol = vertexCount * 4 * sizeof(unsigned char);
+    size_t lenInd = allIndices.size() * indexSize;
 
     size_t offsetPos = 0;
     size_t offsetNor = offsetPos + lenPos;
@@ -375,33 +713,175 @@ bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string
 
     buffer.data.resize(totalSize + padding);
 
+    // 【关键修复】计算包围盒 (Min/Max)，MeshLab 必须需要这个
+    std::vector<double> posMin = {1e9, 1e9, 1e9};
+    std::vector<double> posMax = {-1e9, -1e9, -1e9};
+    for (size_t o = 0; o < vertexCount; ++o) {
+        for (int k = 0; k < 3; ++k) {
+            double p  = m.vert[outVert[o]].cP()[k];
+            posMin[k] = std::min(posMin[k], p);
+            posMax[k] = std::max(posMax[k], p);
+        }
+    }
+
+    // Quantized positions: integers on a grid centred on the box, with half its longest side at
+    // the largest integer. The node transform maps them back.
+    // Normals and UVs are rounded to their grid, then the grid is scaled to the storage range.
+    const int positionMax = (1 << (positionBits - 1)) - 1;
+    const int normalMax   = (1 << (normalBits - 1)) - 1;
+    const int normalRange = shortNormals ? 32767 : 127;
+    const int uvMax       = (1 << uvBits) - 1;
+    const int uvRange     = shortUVs ? 65535 : 255;
+    double center[3];
+    double halfExtent = 0.0;
+    for (int k = 0; k < 3; ++k) {
+        center[k]  = 0.5 * (posMin[k] + posMax[k]);
+        halfExtent = std::max(halfExtent, 0.5 * (posMax[k] - posMin[k]));
+    }
+    const double positionStep = halfExtent > 0.0 ? halfExtent / positionMax : 1.0;
+    std::vector<double> qMin  = {double(positionMax), double(positionMax), double(positionMax)};
+    std::vector<double> qMax  = {-double(positionMax), -double(positionMax), -double(positionMax)};
+    double maxPositionError   = 0.0; // mesh units
+    double maxNormalError     = 0.0; // degrees
+    double maxUVError         = 0.0;
+
     // 写入数据
-    std::memcpy(buffer.data.data() + offsetPos, rawPos.data(), lenPos);
-    std::memcpy(buffer.data.data() + offsetNor, rawNor.data(), lenNor);
-    std::memcpy(buffer.data.data() + offsetUV, rawUV.data(), lenUV);
-    std::memcpy(buffer.data.data() + offsetCol, rawColorUB.data(), lenCol);
-    std::memcpy(buffer.data.data() + offsetInd, allIndices.data(), lenInd);
+    unsigned char *dstPos = buffer.data.data() + offsetPos;
+    unsigned char *dstNor = buffer.data.data() + offsetNor;
+    unsigned char *dstUV  = buffer.data.data() + offsetUV;
+    unsigned char *dstCol = buffer.data.data() + offsetCol;
+    for (size_t o = 0; o < vertexCount; ++o) {
+        const MyVertex &v = m.vert[outVert[o]];
+        float uv[2]       = {outUV[o].u(), outUV[o].v()};
+        if (!quant.enabled) {
+            float *pos = reinterpret_cast<float *>(dstPos + o * posSize);
+            float *nor = reinterpret_cast<float *>(dstNor + o * norSize);
+            for (int k = 0; k < 3; ++k) {
+                pos[k] = v.cP()[k];
+                nor[k] = v.cN()[k];
+            }
+        } else {
+            double error2 = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                long q  = std::lround((v.cP()[k] - center[k]) / positionStep);
+                q       = std::min<long>(std::max<long>(q, -positionMax), positionMax);
+                qMin[k] = std::min(qMin[k], double(q));
+                qMax[k] = std::max(qMax[k], double(q));
+                if (shortPositions)
+                    reinterpret_cast<int16_t *>(dstPos + o * posSize)[k] = int16_t(q);
+                else
+                    reinterpret_cast<int8_t *>(dstPos + o * posSize)[k] = int8_t(q);
+                double d = center[k] + q * positionStep - v.cP()[k];
+                error2 += d * d;
+            }
+            maxPositionError = std::max(maxPositionError, std::sqrt(error2));
+
+            // Normals are written unit length; the error is the angle to the decoded vector.
+            vcg::Point3f n = v.cN();
+            float length   = n.Norm();
+            if (length > 0.0f)
+                n /= length;
+            long q[3];
+            double dot = 0.0, qLength2 = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                q[k] = std::lround(std::lround(n[k] * normalMax) * double(normalRange) /
+                                   normalMax);
+                if (shortNormals)
+                    reinterpret_cast<int16_t *>(dstNor + o * norSize)[k] = int16_t(q[k]);
+                else
+                    reinterpret_cast<int8_t *>(dstNor + o * norSize)[k] = int8_t(q[k]);
+                dot += n[k] * double(q[k]);
+                qLength2 += double(q[k]) * q[k];
+            }
+            if (length > 0.0f && qLength2 > 0.0) {
+                double c       = std::min(1.0, dot / std::sqrt(qLength2));
+                maxNormalError = std::max(maxNormalError, vcg::math::ToDeg(std::acos(c)));
+            }
+        }
+        if (!unitUVs) {
+            std::memcpy(dstUV + o * uvSize, uv, sizeof(uv));
+        } else {
+            for (int k = 0; k < 2; ++k) {
+                long q = std::lround(std::lround(uv[k] * uvMax) * double(uvRange) / uvMax);
+                if (shortUVs)
+                    reinterpret_cast<uint16_t *>(dstUV + o * uvSize)[k] = uint16_t(q);
+                else
+                    (dstUV + o * uvSize)[k] = uint8_t(q);
+                maxUVError = std::max(maxUVError, std::abs(double(q) / uvRange - uv[k]));
+            }
+        }
+        for (int k = 0; k < 4; ++k)
+            dstCol[o * 4 + k] = v.cC()[k];
+    }
+    if (quant.enabled) {
+        double diagonal = std::sqrt((posMax[0] - posMin[0]) * (posMax[0] - posMin[0]) +
+                                    (posMax[1] - posMin[1]) * (posMax[1] - posMin[1]) +
+                                    (posMax[2] - posMin[2]) * (posMax[2] - posMin[2]));
+        printf("SaveGLB: KHR_mesh_quantization, %d bytes per vertex (%d as float)\n",
+               int(posSize + norSize + uvSize + 4), int(3 * 4 + 3 * 4 + 2 * 4 + 4));
+        printf("  max error: position %g (%.3g%% of the diagonal), normal %.3f deg, ",
+               maxPositionError, diagonal > 0.0 ? 100.0 * maxPositionError / diagonal : 0.0,
+               maxNormalError);
+        if (unitUVs)
+            printf("uv %g\n", maxUVError);
+        else
+            printf("uv kept as float (outside [0, 1])\n");
+    }
+    if (shortIndices) {
+        uint16_t *dstInd = reinterpret_cast<uint16_t *>(buffer.data.data() + offsetInd);
+        for (size_t i = 0; i < allIndices.size(); ++i)
+            dstInd[i] = (uint16_t)allIndices[i];
+    } else {
+        std::memcpy(buffer.data.data() + offsetInd, allIndices.data(), lenInd);
+    }
+
+    // Encoded images are appended to the buffer unchanged, each starting 4 byte aligned.
+    std::vector<size_t> imageOffset(outModel.images.size(), 0);
+    for (size_t i = 0; i < outModel.images.size(); ++i) {
+        const tinygltf::Image &img = outModel.images[i];
+        if (!IsEncodedImage(img))
+            continue;
+        imageOffset[i] = buffer.data.size();
+        buffer.data.insert(buffer.data.end(), img.image.begin(), img.image.end());
+        buffer.data.resize((buffer.data.size() + 3) & ~size_t(3), 0);
+    }
 
-    outModel.buffers.push_back(buffer);
+    outModel.buffers.push_back(std::move(buffer));
     int bufferId = 0;
 
     // 4. 创建 BufferViews
-    auto addBufferView = [&](size_t offset, size_t length, int target) {
+    // Quantized attributes give their padded element size as the stride.
+    auto addBufferView = [&](size_t offset, size_t length, int target, size_t stride = 0) {
         tinygltf::BufferView bv;
         bv.buffer     = bufferId;
         bv.byteOffset = offset;
         bv.byteLength = length;
+        bv.byteStride = stride;
         bv.target     = target;
         outModel.bufferViews.push_back(bv);
         return (int)outModel.bufferViews.size() - 1;
     };
 
-    int bvPos = addBufferView(offsetPos, lenPos, TINYGLTF_TARGET_ARRAY_BUFFER);
-    int bvNor = addBufferView(offsetNor, lenNor, TINYGLTF_TARGET_ARRAY_BUFFER);
-    int bvUV  = addBufferView(offsetUV, lenUV, TINYGLTF_TARGET_ARRAY_BUFFER);
+    int bvPos = addBufferView(offsetPos, lenPos, TINYGLTF_TARGET_ARRAY_BUFFER,
+                              quant.enabled ? posSize : 0);
+    int bvNor = addBufferView(offsetNor, lenNor, TINYGLTF_TARGET_ARRAY_BUFFER,
+                              quant.enabled ? norSize : 0);
+    int bvUV  = addBufferView(offsetUV, lenUV, TINYGLTF_TARGET_ARRAY_BUFFER,
+                              unitUVs ? uvSize : 0);
     int bvCol = addBufferView(offsetCol, lenCol, TINYGLTF_TARGET_ARRAY_BUFFER);
     int bvInd = addBufferView(offsetInd, lenInd, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
 
+    for (size_t i = 0; i < outModel.images.size(); ++i) {
+        tinygltf::Image &img = outModel.images[i];
+        if (!IsEncodedImage(img))
+            continue;
+        img.bufferView = addBufferView(imageOffset[i], img.image.size(), 0);
+        if (img.mimeType.empty())
+            img.mimeType = SniffMimeType(img.image);
+        // Nothing left for tinygltf to encode: the bytes are already in the buffer.
+        img.image.clear();
+    }
+
     // 5. 创建 Accessors
     // 【关键修复】参数 typeEnum 改为 int，并接收 Min/Max
     auto addAccessor = [&](int bv, int count, int compType, int typeEnum,
@@ -422,48 +902,45 @@ bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string
         return (int)outModel.accessors.size() - 1;
     };
 
-    // Position 必须要有 Min/Max
-    int accPos = addAccessor(bvPos, (int)rawPos.size() / 3, TINYGLTF_COMPONENT_TYPE_FLOAT,
-                             TINYGLTF_TYPE_VEC3, &posMin, &posMax);
-    int accNor = addAccessor(bvNor, (int)rawNor.size() / 3, TINYGLTF_COMPONENT_TYPE_FLOAT,
-                             TINYGLTF_TYPE_VEC3, nullptr, nullptr);
-    int accUV  = addAccessor(bvUV, (int)rawUV.size() / 2, TINYGLTF_COMPONENT_TYPE_FLOAT,
-                             TINYGLTF_TYPE_VEC2, nullptr, nullptr);
+    int posType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    int norType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    int uvType  = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    if (quant.enabled) {
+        posType = shortPositions ? TINYGLTF_COMPONENT_TYPE_SHORT : TINYGLTF_COMPONENT_TYPE_BYTE;
+        norType = shortNormals ? TINYGLTF_COMPONENT_TYPE_SHORT : TINYGLTF_COMPONENT_TYPE_BYTE;
+    }
+    if (unitUVs)
+        uvType = shortUVs ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+                          : TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+    // Position 必须要有 Min/Max (quantized: of the integers, the node transform maps them back)
+    int accPos = addAccessor(bvPos, (int)vertexCount, posType, TINYGLTF_TYPE_VEC3,
+                             quant.enabled ? &qMin : &posMin, quant.enabled ? &qMax : &posMax);
+    int accNor = addAccessor(bvNor, (int)vertexCount, norType, TINYGLTF_TYPE_VEC3, nullptr,
+                             nullptr, quant.enabled);
+    int accUV  = addAccessor(bvUV, (int)vertexCount, uvType, TINYGLTF_TYPE_VEC2, nullptr, nullptr,
+                             unitUVs);
     // Color: VEC4 Unsigned Byte Normalized
-    int accCol =
-        addAccessor(bvCol, (int)rawColorUB.size() / 4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE,
-                    TINYGLTF_TYPE_VEC4, nullptr, nullptr, true);
+    int accCol = addAccessor(bvCol, (int)vertexCount, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE,
+                             TINYGLTF_TYPE_VEC4, nullptr, nullptr, true);
 
     // 6. 组装 Mesh
     tinygltf::Mesh mesh;
 
     // Create primitives for each material group
-    printf("SaveGLB: Found %d unique vertices.\n", idxCounter);
+    printf("SaveGLB: Found %d unique vertices (%d bit indices).\n", (int)vertexCount,
+           shortIndices ? 16 : 32);
     printf("SaveGLB: Splitting into %d primitives based on material IDs.\n",
-           (int)matGroupInfos.size());
+           (int)groupMat.size());
 
-    for (const auto &info : matGroupInfos) {
-        printf("  MatGroup: MatID %d, IndexCount %d\n", info.matId, (int)info.indexCount);
-
-        // Choose easiest index type based on vertex count
-        int indexCompType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT; // Default to 4 bytes
-        if (idxCounter < 65536) {
-            indexCompType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT; // Optimize to 2 bytes
-        }
+    const int indexCompType = shortIndices ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+                                           : TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+    for (size_t g = 0; g < groupMat.size(); ++g) {
+        size_t indexCount = groupCursor[g] - groupStart[g];
+        printf("  MatGroup: MatID %d, IndexCount %d\n", groupMat[g], (int)indexCount);
 
         // Create an accessor for this chunk of indices
-        // IMPORTANT: We need to write the data to the buffer in the correct format!
-        // The current 'allIndices' vector is std::vector<unsigned int> (4 bytes).
-        // If we want 2-byte indices, we need to convert and write a separate buffer view or handle
-        // conversion.
-
-        // For simplicity in this step, let's keep it robust first and just check the size logic
-        // later. Or better, let's stick to UINT for now to ensure correctness, and just log the
-        // overhead.
-
-        size_t accByteOffset = info.indexStart * sizeof(unsigned int);
-        int accInd = addAccessor(bvInd, (int)info.indexCount, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT,
-                                 TINYGLTF_TYPE_SCALAR, nullptr, nullptr, false, accByteOffset);
+        int accInd = addAccessor(bvInd, (int)indexCount, indexCompType, TINYGLTF_TYPE_SCALAR,
+                                 nullptr, nullptr, false, groupStart[g] * indexSize);
 
         tinygltf::Primitive prim;
         prim.attributes["POSITION"]   = accPos;
@@ -471,7 +948,9 @@ bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string
         prim.attributes["TEXCOORD_0"] = accUV;
         prim.attributes["COLOR_0"]    = accCol;
         prim.indices                  = accInd;
-        prim.material                 = info.matId; // Set Material ID
+        prim.material                 = groupMat[g]; // Set Material ID
+        if (groupMat[g] >= (int)outModel.materials.size())
+            prim.material = -1; // e.g. meshes extracted from a progressive mesh log
         prim.mode                     = TINYGLTF_MODE_TRIANGLES;
 
         mesh.primitives.push_back(prim);
@@ -482,6 +961,12 @@ bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string
     // 7. Node & Scene
     tinygltf::Node node;
     node.mesh = 0;
+    if (quant.enabled) {
+        node.translation = {center[0], center[1], center[2]};
+        node.scale       = {positionStep, positionStep, positionStep};
+        outModel.extensionsUsed.push_back("KHR_mesh_quantization");
+        outModel.extensionsRequired.push_back("KHR_mesh_quantization");
+    }
     outModel.nodes.push_back(node);
 
     tinygltf::Scene scene;
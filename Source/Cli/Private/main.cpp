@@ -1,85 +1,488 @@
 #include <cstdio>
 #include "simplifier.h"
+#include "batch.h"
+#include "deviation.h"
+#include "streaming.h"
 #include "glb_loader.h"
 #include "mymesh.h"
 #include "obj_loader.h"
+#include "parallel.h"
+#include "progressive_mesh.h"
+#include "stats_report.h"
+#include <algorithm>
+#include <map>
 
 // --- 主程序 ---
 void LogStatus(MyMesh &m, const char *stage) { printf("[%s] V:%d F:%d\n", stage, m.VN(), m.FN()); }
 
+static std::string Extension(const std::string &path) {
+    return path.substr(path.find_last_of('.') + 1);
+}
+
+// "out.glb" -> "out_LOD1.glb"
+static std::string LevelPath(const std::string &path, size_t level) {
+    size_t dot = path.find_last_of('.');
+    return path.substr(0, dot) + "_LOD" + std::to_string(level + 1) + path.substr(dot);
+}
+
+// "0.5,0.25,0.1" -> {0.5, 0.25, 0.1}
+static std::vector<float> ParseRatios(const char *arg) {
+    std::vector<float> ratios;
+    const char *p = arg;
+    while (*p) {
+        char *end = nullptr;
+        float r   = strtof(p, &end);
+        if (end == p)
+            break;
+        ratios.push_back(r);
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return ratios;
+}
+
+static bool LoadMesh(MyMesh &m, tinygltf::Model &model, const std::string &inputPath,
+                     bool decodeImages) {
+    if (Extension(inputPath) == "glb") {
+        printf("Loading GLB %s...\n", inputPath.c_str());
+        if (!LoadGLB(m, model, inputPath, decodeImages)) {
+            printf("Failed to load GLB.\n");
+            return false;
+        }
+    } else if (Extension(inputPath) == "obj") {
+        printf("Loading OBJ %s...\n", inputPath.c_str());
+        if (!LoadObj(m, inputPath)) {
+            printf("Failed to load OBJ.\n");
+            return false;
+        }
+    } else {
+        printf("Unsupported input format. Only .glb and .obj are supported.\n");
+        return false;
+    }
+    LogStatus(m, "Loaded");
+    return true;
+}
+
+static bool SaveMesh(MyMesh &m, const tinygltf::Model &model, const std::string &outputPath,
+                     const GLBSaveOptions &saveOptions) {
+    if (Extension(outputPath) == "glb") {
+        printf("Saving GLB %s...\n", outputPath.c_str());
+        if (!SaveGLB(m, model, outputPath, saveOptions)) {
+            printf("Failed to save GLB.\n");
+            return false;
+        }
+    } else if (Extension(outputPath) == "obj") {
+        printf("Saving OBJ %s...\n", outputPath.c_str());
+        if (!SaveObj(m, outputPath)) {
+            printf("Failed to save OBJ.\n");
+            return false;
+        }
+    } else {
+        printf("Unsupported output format. Only .glb and .obj are supported.\n");
+        return false;
+    }
+    return true;
+}
+
+// The compact layout is filled straight from GLB; OBJ goes through MyMesh.
+static bool LoadMesh(CompactMesh &m, tinygltf::Model &model, const std::string &inputPath,
+                     bool decodeImages) {
+    if (Extension(inputPath) == "glb") {
+        printf("Loading GLB %s...\n", inputPath.c_str());
+        if (!LoadGLB(m, model, inputPath, decodeImages)) {
+            printf("Failed to load GLB.\n");
+            return false;
+        }
+    } else {
+        MyMesh loaded;
+        if (!LoadMesh(loaded, model, inputPath, decodeImages))
+            return false;
+        ToCompactMesh(loaded, m);
+    }
+    printf("[Loaded] V:%zu F:%zu (%zu bytes)\n", m.VertexCount(), m.FaceCount(), m.MemoryBytes());
+    return true;
+}
+
+// --compact: load, clean and simplify on CompactMesh; MyMesh is only built for the save.
+static bool RunCompact(const std::string &inputPath, const std::string &outputPath,
+                       bool decodeImages, double weldDistance, const Simplifier::Params &params,
+                       const GLBSaveOptions &saveOptions, Simplifier::Stats &stats) {
+    CompactMesh cm;
+    tinygltf::Model model;
+    double phaseStart = StatsNowMs();
+    if (!LoadMesh(cm, model, inputPath, decodeImages))
+        return false;
+    AddPhase(stats, "load", phaseStart);
+
+    phaseStart = StatsNowMs();
+    Simplifier::Clean(cm, weldDistance, params.threads);
+    printf("[Cleaned] V:%zu F:%zu\n", cm.VertexCount(), cm.FaceCount());
+    AddPhase(stats, "clean", phaseStart);
+
+    printf("Targeting %d faces\n", (int)(cm.FaceCount() * params.ratio));
+    Simplifier::Simplify(cm, params);
+
+    MyMesh m;
+    FromCompactMesh(cm, m);
+    LogStatus(m, "Final");
+    phaseStart = StatsNowMs();
+    bool saved = SaveMesh(m, model, outputPath, saveOptions);
+    AddPhase(stats, "save", phaseStart);
+    return saved;
+}
+
+static bool SavePM(const ProgressiveMesh &pm, const std::string &pmPath) {
+    if (pmPath.empty())
+        return true;
+    printf("Saving progressive mesh %s (%d collapses)...\n", pmPath.c_str(),
+           (int)pm.collapses.size());
+    if (!pm.Save(pmPath)) {
+        printf("Failed to save progressive mesh.\n");
+        return false;
+    }
+    return true;
+}
+
+// --compare: prints the Metro-style deviation between an original and a simplified mesh.
+static bool CompareMeshes(const std::string &originalPath, const std::string &simplifiedPath,
+                          size_t samples, int threads) {
+    MyMesh original, simplified;
+    tinygltf::Model originalModel, simplifiedModel;
+    if (!LoadMesh(original, originalModel, originalPath, false) ||
+        !LoadMesh(simplified, simplifiedModel, simplifiedPath, false))
+        return false;
+
+    Deviation::Params params;
+    params.samples = samples;
+    params.threads = threads;
+    Deviation::Result r = Deviation::Measure(original, simplified, params);
+
+    auto percent = [&](double d) { return r.diagonal > 0 ? 100.0 * d / r.diagonal : 0.0; };
+    printf("Bounding box diagonal %g, %zu samples per direction\n", r.diagonal, samples);
+    printf("%-22s %12s %12s %12s %10s\n", "", "max", "mean", "rms", "max %diag");
+    auto row = [&](const char *label, const Deviation::Distance &d) {
+        printf("%-22s %12g %12g %12g %9.4f%%\n", label, d.max, d.mean, d.rms, percent(d.max));
+    };
+    row("original -> simplified", r.forward.all);
+    row("simplified -> original", r.backward.all);
+    printf("Hausdorff %g (%.4f%% of the diagonal), RMS %g\n", r.hausdorff, percent(r.hausdorff),
+           r.rms);
+
+    // Per material, by the matId of the face each sample was taken on.
+    printf("\n%-8s %12s %12s %12s %12s\n", "matId", "fwd max", "fwd rms", "bwd max", "bwd rms");
+    std::map<int, std::pair<Deviation::Distance, Deviation::Distance>> byMaterial;
+    for (const auto &entry : r.forward.byMaterial)
+        byMaterial[entry.first].first = entry.second;
+    for (const auto &entry : r.backward.byMaterial)
+        byMaterial[entry.first].second = entry.second;
+    for (const auto &entry : byMaterial) {
+        printf("%-8d %12g %12g %12g %12g\n", entry.first, entry.second.first.max,
+               entry.second.first.rms, entry.second.second.max, entry.second.second.rms);
+    }
+    return true;
+}
+
+// Writes whichever of the --stats / --trace reports were requested.
+static bool WriteReports(const Simplifier::Stats &stats, const std::string &statsPath,
+                         const std::string &tracePath) {
+    bool ok = true;
+    if (!statsPath.empty() && !WriteStatsJson(statsPath, stats)) {
+        printf("Failed to write stats %s\n", statsPath.c_str());
+        ok = false;
+    }
+    if (!tracePath.empty() && !WriteChromeTrace(tracePath, stats)) {
+        printf("Failed to write trace %s\n", tracePath.c_str());
+        ok = false;
+    }
+    return ok;
+}
+
+static bool SameMesh(const MyMesh &a, const MyMesh &b) {
+    if (a.vert.size() != b.vert.size() || a.face.size() != b.face.size())
+        return false;
+    for (size_t i = 0; i < a.vert.size(); ++i) {
+        if (a.vert[i].cP() != b.vert[i].cP())
+            return false;
+    }
+    for (size_t i = 0; i < a.face.size(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if ((a.face[i].cV(j) - &a.vert[0]) != (b.face[i].cV(j) - &b.vert[0]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Reentrancy check: simplifies `runs` copies of `m` concurrently and compares each result with
+// a serial run. Any difference means state leaked between sessions.
+static bool StressTest(const MyMesh &m, const Simplifier::Params &params, int runs) {
+    MyMesh reference;
+    Simplifier::CopyMesh(m, reference);
+    Simplifier::Simplify(reference, params);
+    LogStatus(reference, "Reference");
+
+    std::vector<MyMesh> copies(runs);
+    for (MyMesh &copy : copies)
+        Simplifier::CopyMesh(m, copy);
+    ParallelForEach(copies.size(), runs, [&](size_t i, int) {
+        Simplifier::Simplify(copies[i], params);
+    });
+
+    int failures = 0;
+    for (size_t i = 0; i < copies.size(); ++i) {
+        if (!SameMesh(reference, copies[i])) {
+            printf("Run %d differs from the serial result (V:%d F:%d)\n", (int)i,
+                   copies[i].VN(), copies[i].FN());
+            ++failures;
+        }
+    }
+    printf("Stress: %d/%d concurrent runs match\n", runs - failures, runs);
+    return failures == 0;
+}
+
 int main(int argc, char **argv) {
     std::string inputPath;
     std::string outputPath;
-    float ratio = 0.5f;
+    std::vector<float> ratios = {0.5f};
+    std::string pmPath;
+    int threads = 1;
+    int stressRuns = 0;
+    std::string batchSource;
+    bool decodeImages = false;
+    bool stream       = false;
+    bool compact      = false;
+    StreamOptions streamOptions;
+    std::string statsPath;
+    std::string tracePath;
+    double timeLimit = 0.0;
+    double maxError  = 0.0;
+    std::string comparePaths[2];
+    size_t samples                        = 1000000;
+    double weldDistance                   = -1.0;
+    Simplifier::CollapseKind collapseKind = Simplifier::CollapseKind::Auto;
+    Simplifier::Engine engine             = Simplifier::Engine::Serial;
+    GLBSaveOptions saveOptions;
 
     // 简单的参数解析
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
             inputPath = argv[++i];
         else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
-            ratio = float(atof(argv[++i]));
+            ratios = ParseRatios(argv[++i]);
         else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
             outputPath = argv[++i];
+        else if (strcmp(argv[i], "--pm") == 0 && i + 1 < argc)
+            pmPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+            stressRuns = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            batchSource = argv[++i];
+        else if (strcmp(argv[i], "--decode-images") == 0)
+            decodeImages = true;
+        else if (strcmp(argv[i], "--stream") == 0)
+            stream = true;
+        else if (strcmp(argv[i], "--compact") == 0)
+            compact = true;
+        else if (strcmp(argv[i], "--gpu-opt") == 0)
+            saveOptions.optimizeForGpu = true;
+        else if (strcmp(argv[i], "--quantize") == 0)
+            saveOptions.quantization.enabled = true;
+        else if (strcmp(argv[i], "--quantize-bits") == 0 && i + 1 < argc) {
+            GLBQuantization q;
+            char rest;
+            q.enabled = true;
+            if (sscanf(argv[++i], "%d,%d,%d%c", &q.positionBits, &q.normalBits, &q.uvBits,
+                       &rest) != 3 ||
+                !q.Valid()) {
+                printf("--quantize-bits expects <position>,<normal>,<uv> with positions and "
+                       "normals in 2..16 and UVs in 1..16 bits, e.g. 14,8,16\n");
+                return -1;
+            }
+            saveOptions.quantization = q;
+        }
+        else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc)
+            streamOptions.memoryBudgetMB = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--tmp") == 0 && i + 1 < argc)
+            streamOptions.tempDir = argv[++i];
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+            statsPath = argv[++i];
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (strcmp(argv[i], "--time-limit") == 0 && i + 1 < argc)
+            timeLimit = atof(argv[++i]);
+        else if (strcmp(argv[i], "--max-error") == 0 && i + 1 < argc)
+            maxError = atof(argv[++i]);
+        else if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            comparePaths[0] = argv[++i];
+            comparePaths[1] = argv[++i];
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            samples = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--weld") == 0 && i + 1 < argc)
+            weldDistance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--collapse") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "geometry") == 0)
+                collapseKind = Simplifier::CollapseKind::GeometryOnly;
+            else if (strcmp(argv[i], "textured") == 0)
+                collapseKind = Simplifier::CollapseKind::Textured;
+            else
+                collapseKind = Simplifier::CollapseKind::Auto;
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = strcmp(argv[++i], "independent") == 0 ? Simplifier::Engine::IndependentSet
+                                                           : Simplifier::Engine::Serial;
+        }
     }
 
     MyMesh m;
     tinygltf::Model originalModel; // 保存原始数据（材质/纹理）
 
+    // Deviation between two existing meshes instead of simplifying.
+    if (!comparePaths[0].empty())
+        return CompareMeshes(comparePaths[0], comparePaths[1], samples, threads) ? 0 : -1;
+
+    // Batch: a manifest file, or a glob whose matches are written into the -o directory.
+    if (!batchSource.empty()) {
+        std::vector<BatchJob> jobs;
+        float ratio = ratios.empty() ? 0.5f : ratios[0];
+        bool isGlob = batchSource.find_first_of("*?") != std::string::npos;
+        if (isGlob && outputPath.empty()) {
+            printf("Please specify the output directory of a glob batch with -o\n");
+            return -1;
+        }
+        bool listed = isGlob ? ExpandGlob(batchSource, outputPath, ratio, jobs)
+                             : ParseManifest(batchSource, ratio, jobs);
+        if (!listed)
+            return -1;
+        printf("Batch: %d jobs\n", (int)jobs.size());
+        Simplifier::Params params;
+        params.maxError     = maxError;
+        params.collapseKind = collapseKind;
+        params.engine       = engine;
+        return RunBatch(jobs, params, threads, timeLimit, saveOptions, weldDistance) == 0 ? 0 : -1;
+    }
+
     if (inputPath.empty()) {
         printf("Please specify input file path with -i\n");
         return -1;
     }
-    if (outputPath.empty()) {
+    if (outputPath.empty() && stressRuns <= 0) {
         printf("Please specify output file path with -o\n");
         return -1;
     }
+    if (ratios.empty()) {
+        printf("Please specify one or more comma separated ratios with -r\n");
+        return -1;
+    }
 
-    if (inputPath.substr(inputPath.find_last_of('.') + 1) == "glb") {
-        printf("Loading GLB %s...\n", inputPath.c_str());
-        if (!LoadGLB(m, originalModel, inputPath)) {
-            printf("Failed to load GLB.\n");
+    // Out-of-core: the input is never loaded as a whole.
+    if (stream) {
+        Simplifier::Params params;
+        params.ratio          = ratios[0];
+        params.maxError       = maxError;
+        params.collapseKind   = collapseKind;
+        params.engine         = engine;
+        streamOptions.threads = threads;
+        streamOptions.save    = saveOptions;
+        return SimplifyStreaming(inputPath, outputPath, params, streamOptions) ? 0 : -1;
+    }
+
+    // Progressive mesh input: replay a prefix of the collapse log instead of simplifying.
+    if (Extension(inputPath) == "vpm") {
+        printf("Loading progressive mesh %s...\n", inputPath.c_str());
+        ProgressiveMesh pm;
+        if (!pm.Load(inputPath, *std::min_element(ratios.begin(), ratios.end()))) {
+            printf("Failed to load progressive mesh.\n");
             return -1;
         }
-        LogStatus(m, "Loaded");
-    } else if (inputPath.substr(inputPath.find_last_of('.') + 1) == "obj") {
-        printf("Loading OBJ %s...\n", inputPath.c_str());
-        if (!LoadObj(m, inputPath)) {
-            printf("Failed to load OBJ.\n");
-            return -1;
+        bool ok = true;
+        for (size_t level = 0; level < ratios.size(); ++level) {
+            size_t target = size_t(pm.FaceCount() * ratios[level]);
+            pm.Extract(pm.PrefixForFaceCount(target), m);
+            LogStatus(m, "Extracted");
+            ok &= SaveMesh(m, originalModel,
+                           ratios.size() == 1 ? outputPath : LevelPath(outputPath, level),
+                           saveOptions);
         }
-        LogStatus(m, "Loaded");
-    } else {
-        printf("Unsupported input format. Only .glb and .obj are supported.\n");
-        return -1;
+        return ok ? 0 : -1;
+    }
+
+    // --stats / --trace: the simplifier records its own phases, load/clean/save are added here.
+    Simplifier::Stats stats;
+    bool report       = !statsPath.empty() || !tracePath.empty();
+    if (compact) {
+        if (ratios.size() > 1 || !pmPath.empty() || stressRuns > 0)
+            printf("--compact: using the first ratio; LOD chains, --pm and --stress need the "
+                   "default path\n");
+        Simplifier::Params params;
+        params.ratio    = ratios[0];
+        params.threads  = threads;
+        params.maxError = maxError;
+        if (report)
+            params.stats = &stats;
+        bool ok = RunCompact(inputPath, outputPath, decodeImages, weldDistance, params,
+                             saveOptions, stats);
+        return (ok && (!report || WriteReports(stats, statsPath, tracePath))) ? 0 : -1;
     }
+    double phaseStart = StatsNowMs();
+    if (!LoadMesh(m, originalModel, inputPath, decodeImages))
+        return -1;
+    AddPhase(stats, "load", phaseStart);
 
     // 清理
-    Simplifier::Clean(m);
+    phaseStart = StatsNowMs();
+    Simplifier::Clean(m, weldDistance, threads);
+    LogStatus(m, "Cleaned");
+    AddPhase(stats, "clean", phaseStart);
 
     // 简化
     Simplifier::Params params;
-    params.ratio = ratio;
-    printf("Targeting %d faces\n", (int)(m.fn * ratio));
-    Simplifier::Simplify(m, params);
-
-    LogStatus(m, "Final");
+    params.threads      = threads;
+    params.maxError     = maxError;
+    params.collapseKind = collapseKind;
+    params.engine       = engine;
+    if (report)
+        params.stats = &stats;
+    if (stressRuns > 0) {
+        params.ratio = ratios[0];
+        return StressTest(m, params, stressRuns) ? 0 : -1;
+    }
+    ProgressiveMesh pm;
+    if (!pmPath.empty())
+        params.collapseLog = &pm;
+    if (ratios.size() == 1) {
+        params.ratio = ratios[0];
+        printf("Targeting %d faces\n", (int)(m.fn * ratios[0]));
+        Simplifier::Simplify(m, params);
 
-    if (outputPath.substr(outputPath.find_last_of('.') + 1) == "glb") {
-        printf("Saving GLB %s...\n", outputPath.c_str());
-        if (!SaveGLB(m, originalModel, outputPath)) {
-            printf("Failed to save GLB.\n");
+        LogStatus(m, "Final");
+        if (!SavePM(pm, pmPath))
             return -1;
-        }
-    } else if (outputPath.substr(outputPath.find_last_of('.') + 1) == "obj") {
-        printf("Saving OBJ %s...\n", outputPath.c_str());
-        if (!SaveObj(m, outputPath)) {
-            printf("Failed to save OBJ.\n");
-            return -1;
-        }
-    } else {
-        printf("Unsupported output format. Only .glb and .obj are supported.\n");
-        return -1;
+        phaseStart = StatsNowMs();
+        bool saved = SaveMesh(m, originalModel, outputPath, saveOptions);
+        AddPhase(stats, "save", phaseStart);
+        return (saved && (!report || WriteReports(stats, statsPath, tracePath))) ? 0 : -1;
     }
 
-    return 0;
+    // LOD chain: one decimation session, one output per ratio.
+    std::vector<int> targets;
+    for (float r : ratios) {
+        targets.push_back((int)(m.fn * r));
+        printf("Targeting %d faces (LOD%d)\n", targets.back(), (int)targets.size());
+    }
+
+    bool ok = true;
+    Simplifier::SimplifyChain(
+        m, targets,
+        [&](size_t level, MyMesh &lod) {
+            LogStatus(lod, ("LOD" + std::to_string(level + 1)).c_str());
+            double saveStart = StatsNowMs();
+            ok &= SaveMesh(lod, originalModel, LevelPath(outputPath, level), saveOptions);
+            AddPhase(stats, "save", saveStart);
+        },
+        params);
+
+    if (report)
+        ok &= WriteReports(stats, statsPath, tracePath);
+    return (ok && SavePM(pm, pmPath)) ? 0 : -1;
 }
\ No newline at end of file
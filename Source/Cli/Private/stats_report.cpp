@@ -0,0 +1,70 @@
+#include "stats_report.h"
+#include "memory_usage.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <nlohmann/json.hpp>
+
+using Json = nlohmann::json;
+
+double StatsNowMs() {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void AddPhase(Simplifier::Stats &stats, const char *name, double startMs) {
+    stats.phases.push_back({name, startMs, StatsNowMs() - startMs});
+}
+
+static bool WriteJson(const std::string &path, const Json &doc) {
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    out << doc.dump(2) << "\n";
+    // Closing flushes the tail of the file, so a full disk may only show up here.
+    out.close();
+    return !out.fail();
+}
+
+bool WriteStatsJson(const std::string &path, const Simplifier::Stats &stats) {
+    // Phases that ran several times (one collapse phase per LOD level) are summed.
+    std::map<std::string, double> totals;
+    for (const Simplifier::Stats::Phase &phase : stats.phases)
+        totals[phase.name] += phase.durationMs;
+
+    const CollapseCounters &c = stats.collapses;
+    Json doc;
+    doc["phasesMs"]         = totals;
+    doc["collapses"]        = c.performed;
+    doc["heapHighWater"]    = c.heapHighWater;
+    doc["stalePops"]        = c.stalePops;
+    doc["rejected"]         = {{"topology", c.topologyReject}, {"maxError", c.errorReject}};
+    doc["maxDeviation"]     = c.maxDeviation;
+    doc["lockedVertices"]   = stats.lockedVertices;
+    doc["performedDespite"] = {{"normalFlip", c.normalFlips}, {"lowQuality", c.lowQuality}};
+    doc["peakMemoryMB"]     = PeakMemoryBytes() / (1024.0 * 1024.0);
+    return WriteJson(path, doc);
+}
+
+bool WriteChromeTrace(const std::string &path, const Simplifier::Stats &stats) {
+    double origin = stats.phases.empty() ? 0.0 : stats.phases.front().startMs;
+    for (const Simplifier::Stats::Phase &phase : stats.phases)
+        origin = std::min(origin, phase.startMs);
+
+    Json events = Json::array();
+    for (const Simplifier::Stats::Phase &phase : stats.phases) {
+        events.push_back({{"name", phase.name},
+                          {"cat", "vcg-simplifier"},
+                          {"ph", "X"},
+                          {"ts", (phase.startMs - origin) * 1000.0},
+                          {"dur", phase.durationMs * 1000.0},
+                          {"pid", 1},
+                          {"tid", 1}});
+    }
+    Json doc;
+    doc["traceEvents"]     = events;
+    doc["displayTimeUnit"] = "ms";
+    return WriteJson(path, doc);
+}
\ No newline at end of file
@@ -0,0 +1,496 @@
+#include "streaming.h"
+#include "glb_loader.h"
+#include "obj_loader.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_map>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Histogram resolution per axis used to place the kd-tree split planes.
+const int kGrid = 64;
+
+// Triangle as stored in the temp files. Vertices carry their id in the input file, so chunks
+// written separately can be stitched back together.
+struct TriRecord {
+    uint64_t vert[3];
+    float pos[9];
+    uint8_t rgba[12];
+    float uv[6];
+    int32_t matId;
+};
+
+// Rough memory needed per face to load and simplify a chunk: the records it is read from, the
+// mesh itself (about half a vertex per face), the id map, quadrics and about three heap entries
+// with their collapse objects per face.
+size_t BytesPerFace() {
+    return sizeof(TriRecord) + sizeof(MyFace) + sizeof(MyVertex) / 2 + 32 +
+           sizeof(vcg::math::Quadric<double>) / 2 + sizeof(vcg::math::Quadric5<double>) +
+           3 * (sizeof(vcg::LocalOptimization<MyMesh>::HeapElem) + sizeof(MyCollapse));
+}
+
+struct Node {
+    int lo[3], hi[3];                // grid cells [lo, hi)
+    int axis              = -1;      // split axis, -1 for leaves
+    int split             = 0;       // first cell of child[1] along axis
+    int child[2]          = {-1, -1};
+    int parent            = -1;
+    int depth             = 0;
+    uint64_t ownFaces     = 0; // triangles whose lowest enclosing node is this one
+    uint64_t subtreeFaces = 0; // input triangles below (and including) this node
+    uint64_t resultFaces  = 0;
+    FILE *ownFile         = nullptr;
+    std::string ownPath;
+    std::string resultPath;
+};
+
+class ChunkTree {
+  public:
+    std::vector<Node> nodes;
+
+    void SetBounds(const vcg::Box3f &box) {
+        origin = box.min;
+        for (int k = 0; k < 3; ++k)
+            scale[k] = box.Dim()[k] > 0 ? kGrid / box.Dim()[k] : 0.0f;
+        histogram.assign(size_t(kGrid) * kGrid * kGrid, 0);
+    }
+
+    void Count(const vcg::Point3f &p) {
+        int c[3];
+        Cell(p, c);
+        ++histogram[(size_t(c[0]) * kGrid + c[1]) * kGrid + c[2]];
+    }
+
+    // Splits the grid until every leaf holds at most maxFaces triangles (or a single cell).
+    void Build(uint64_t maxFaces) {
+        BuildPrefixSums();
+        histogram.clear();
+        histogram.shrink_to_fit();
+        nodes.clear();
+        nodes.push_back(Node());
+        for (int k = 0; k < 3; ++k) {
+            nodes[0].lo[k] = 0;
+            nodes[0].hi[k] = kGrid;
+        }
+        Split(0, maxFaces);
+        prefix.clear();
+        prefix.shrink_to_fit();
+    }
+
+    int LeafOf(const vcg::Point3f &p) const {
+        int c[3];
+        Cell(p, c);
+        int n = 0;
+        while (nodes[n].axis >= 0)
+            n = nodes[n].child[c[nodes[n].axis] >= nodes[n].split ? 1 : 0];
+        return n;
+    }
+
+    int CommonAncestor(int a, int b) const {
+        while (nodes[a].depth > nodes[b].depth)
+            a = nodes[a].parent;
+        while (nodes[b].depth > nodes[a].depth)
+            b = nodes[b].parent;
+        while (a != b) {
+            a = nodes[a].parent;
+            b = nodes[b].parent;
+        }
+        return a;
+    }
+
+  private:
+    vcg::Point3f origin;
+    float scale[3] = {0, 0, 0};
+    std::vector<uint32_t> histogram;
+    std::vector<uint64_t> prefix; // (kGrid + 1)^3 inclusive prefix sums of the histogram
+
+    void Cell(const vcg::Point3f &p, int c[3]) const {
+        for (int k = 0; k < 3; ++k)
+            c[k] = std::min(std::max(int((p[k] - origin[k]) * scale[k]), 0), kGrid - 1);
+    }
+
+    uint64_t &Prefix(int x, int y, int z) {
+        return prefix[(size_t(x) * (kGrid + 1) + y) * (kGrid + 1) + z];
+    }
+
+    void BuildPrefixSums() {
+        prefix.assign(size_t(kGrid + 1) * (kGrid + 1) * (kGrid + 1), 0);
+        for (int x = 1; x <= kGrid; ++x)
+            for (int y = 1; y <= kGrid; ++y)
+                for (int z = 1; z <= kGrid; ++z)
+                    Prefix(x, y, z) =
+                        histogram[(size_t(x - 1) * kGrid + (y - 1)) * kGrid + (z - 1)] +
+                        Prefix(x - 1, y, z) + Prefix(x, y - 1, z) + Prefix(x, y, z - 1) -
+                        Prefix(x - 1, y - 1, z) - Prefix(x - 1, y, z - 1) -
+                        Prefix(x, y - 1, z - 1) + Prefix(x - 1, y - 1, z - 1);
+    }
+
+    uint64_t BoxCount(const int lo[3], const int hi[3]) {
+        return Prefix(hi[0], hi[1], hi[2]) - Prefix(lo[0], hi[1], hi[2]) -
+               Prefix(hi[0], lo[1], hi[2]) - Prefix(hi[0], hi[1], lo[2]) +
+               Prefix(lo[0], lo[1], hi[2]) + Prefix(lo[0], hi[1], lo[2]) +
+               Prefix(hi[0], lo[1], lo[2]) - Prefix(lo[0], lo[1], lo[2]);
+    }
+
+    void Split(int n, uint64_t maxFaces) {
+        int lo[3], hi[3];
+        std::copy(nodes[n].lo, nodes[n].lo + 3, lo);
+        std::copy(nodes[n].hi, nodes[n].hi + 3, hi);
+        uint64_t count = BoxCount(lo, hi);
+        int axis       = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (hi[k] - lo[k] > hi[axis] - lo[axis])
+                axis = k;
+        }
+        if (count <= maxFaces || hi[axis] - lo[axis] < 2)
+            return;
+
+        // Plane that balances the triangle counts of the two halves.
+        int best           = lo[axis] + 1;
+        uint64_t bestError = ~uint64_t(0);
+        int cut[3];
+        std::copy(hi, hi + 3, cut);
+        for (int s = lo[axis] + 1; s < hi[axis]; ++s) {
+            cut[axis]      = s;
+            uint64_t left  = BoxCount(lo, cut);
+            uint64_t error = left * 2 > count ? left * 2 - count : count - left * 2;
+            if (error < bestError) {
+                bestError = error;
+                best      = s;
+            }
+        }
+
+        nodes[n].axis  = axis;
+        nodes[n].split = best;
+        for (int side = 0; side < 2; ++side) {
+            Node child;
+            std::copy(lo, lo + 3, child.lo);
+            std::copy(hi, hi + 3, child.hi);
+            (side == 0 ? child.hi : child.lo)[axis] = best;
+            child.parent                             = n;
+            child.depth                              = nodes[n].depth + 1;
+            nodes.push_back(child);
+            nodes[n].child[side] = int(nodes.size()) - 1;
+            Split(nodes[n].child[side], maxFaces);
+        }
+    }
+};
+
+TriRecord MakeRecord(const GLBTriangle &tri) {
+    TriRecord r;
+    for (int k = 0; k < 3; ++k) {
+        r.vert[k] = tri.vert[k];
+        for (int c = 0; c < 3; ++c)
+            r.pos[k * 3 + c] = tri.pos[k][c];
+        for (int c = 0; c < 4; ++c)
+            r.rgba[k * 4 + c] = tri.color[k][c];
+        r.uv[k * 2]     = tri.uv[k].u();
+        r.uv[k * 2 + 1] = tri.uv[k].v();
+    }
+    r.matId = tri.matId;
+    return r;
+}
+
+bool ReadRecords(const std::string &path, std::vector<TriRecord> &records) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    TriRecord block[1024];
+    size_t n;
+    while ((n = fread(block, sizeof(TriRecord), 1024, file)) > 0)
+        records.insert(records.end(), block, block + n);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+// Builds a mesh from triangle records, merging corners with the same vertex id. The input id of
+// every vertex is kept in the "gid" attribute.
+void BuildMesh(const std::vector<TriRecord> &records, MyMesh &m) {
+    std::unordered_map<uint64_t, uint32_t> local;
+    local.reserve(records.size());
+    std::vector<uint32_t> corner(records.size() * 3);
+    for (size_t f = 0; f < records.size(); ++f) {
+        for (int k = 0; k < 3; ++k)
+            corner[f * 3 + k] =
+                local.emplace(records[f].vert[k], uint32_t(local.size())).first->second;
+    }
+
+    m.Clear();
+    auto gid = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<uint64_t>(m, "gid");
+    vcg::tri::Allocator<MyMesh>::AddVertices(m, local.size());
+    vcg::tri::Allocator<MyMesh>::AddFaces(m, records.size());
+    for (size_t f = 0; f < records.size(); ++f) {
+        const TriRecord &r = records[f];
+        MyFace &face       = m.face[f];
+        for (int k = 0; k < 3; ++k) {
+            MyVertex &v = m.vert[corner[f * 3 + k]];
+            v.P()       = vcg::Point3f(r.pos[k * 3], r.pos[k * 3 + 1], r.pos[k * 3 + 2]);
+            v.C() = vcg::Color4b(r.rgba[k * 4], r.rgba[k * 4 + 1], r.rgba[k * 4 + 2],
+                                 r.rgba[k * 4 + 3]);
+            gid[v]     = r.vert[k];
+            face.V(k)  = &v;
+            face.WT(k) = MyFace::TexCoordType(r.uv[k * 2], r.uv[k * 2 + 1]);
+        }
+        face.matId = r.matId;
+    }
+    vcg::tri::UpdateBounding<MyMesh>::Box(m);
+}
+
+// Writes the live faces of `m` as triangle records and sets `count` to their number. Returns
+// false if the file could not be written completely (a full disk, for example).
+bool WriteMesh(MyMesh &m, const std::string &path, uint64_t &count) {
+    auto gid   = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<uint64_t>(m, "gid");
+    FILE *file = fopen(path.c_str(), "wb");
+    count      = 0;
+    if (!file)
+        return false;
+    bool ok = true;
+    for (const MyFace &f : m.face) {
+        if (!ok)
+            break;
+        if (f.IsD())
+            continue;
+        TriRecord r;
+        for (int k = 0; k < 3; ++k) {
+            const MyVertex &v = *f.cV(k);
+            r.vert[k]         = gid[v];
+            for (int c = 0; c < 3; ++c)
+                r.pos[k * 3 + c] = v.cP()[c];
+            for (int c = 0; c < 4; ++c)
+                r.rgba[k * 4 + c] = v.cC()[c];
+            r.uv[k * 2]     = f.cWT(k).u();
+            r.uv[k * 2 + 1] = f.cWT(k).v();
+        }
+        r.matId = f.matId;
+        ok      = fwrite(&r, sizeof(r), 1, file) == 1;
+        ++count;
+    }
+    return (fclose(file) == 0) && ok;
+}
+
+bool AppendFile(const std::string &from, FILE *to) {
+    FILE *file = fopen(from.c_str(), "rb");
+    if (!file)
+        return false;
+    std::vector<char> block(1 << 20);
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(block.data(), 1, block.size(), file)) > 0)
+        ok = fwrite(block.data(), 1, n, to) == n;
+    ok = ok && !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+} // namespace
+
+bool SimplifyStreaming(const std::string &inputPath, const std::string &outputPath,
+                       const Simplifier::Params &params, const StreamOptions &options) {
+    const int workers       = ResolveThreadCount(options.threads);
+    const uint64_t maxFaces = std::max<uint64_t>(
+        options.memoryBudgetMB * 1024ull * 1024ull / BytesPerFace() / workers, 1000);
+    auto start = std::chrono::steady_clock::now();
+
+    // 1. Bounds and face count
+    tinygltf::Model model;
+    vcg::Box3f box;
+    uint64_t totalFaces = 0;
+    bool readable       = ForEachGLBTriangle(inputPath, model, [&](const GLBTriangle &tri) {
+        for (int k = 0; k < 3; ++k)
+            box.Add(tri.pos[k]);
+        ++totalFaces;
+    });
+    if (!readable || totalFaces == 0) {
+        printf("Streaming needs a GLB with embedded, uncompressed geometry.\n");
+        return false;
+    }
+
+    // 2. Density histogram -> kd-tree of chunks
+    ChunkTree tree;
+    tree.SetBounds(box);
+    ForEachGLBTriangle(inputPath, model, [&](const GLBTriangle &tri) { tree.Count(tri.pos[0]); });
+    tree.Build(maxFaces);
+    std::vector<Node> &nodes = tree.nodes;
+    printf("Stream: %llu faces, %d tree nodes, at most %llu faces per chunk\n",
+           (unsigned long long)totalFaces, (int)nodes.size(), (unsigned long long)maxFaces);
+
+    fs::path tmp = options.tempDir.empty() ? fs::temp_directory_path() : fs::path(options.tempDir);
+    tmp /= "vcg-stream-" + std::to_string(start.time_since_epoch().count());
+    std::error_code ec;
+    fs::create_directories(tmp, ec);
+    if (ec) {
+        printf("Cannot create temp directory %s\n", tmp.string().c_str());
+        return false;
+    }
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        nodes[n].ownPath    = (tmp / ("node" + std::to_string(n) + ".tri")).string();
+        nodes[n].resultPath = (tmp / ("node" + std::to_string(n) + ".out")).string();
+    }
+
+    // 3. Distribute: every triangle goes to the lowest node that contains its three vertices.
+    // Vertices of triangles owned by internal nodes stay locked until that node is processed.
+    std::unordered_map<uint64_t, uint32_t> lockCount;
+    bool tempWritten = true;
+    bool written     = ForEachGLBTriangle(inputPath, model, [&](const GLBTriangle &tri) {
+        int owner = tree.CommonAncestor(
+            tree.CommonAncestor(tree.LeafOf(tri.pos[0]), tree.LeafOf(tri.pos[1])),
+            tree.LeafOf(tri.pos[2]));
+        Node &node = nodes[owner];
+        if (!node.ownFile && node.ownFaces == 0)
+            node.ownFile = fopen(node.ownPath.c_str(), "wb");
+        TriRecord r = MakeRecord(tri);
+        if (!node.ownFile || fwrite(&r, sizeof(r), 1, node.ownFile) != 1)
+            tempWritten = false;
+        ++node.ownFaces;
+        if (node.axis >= 0) {
+            for (int k = 0; k < 3; ++k)
+                ++lockCount[tri.vert[k]];
+        }
+    });
+    for (Node &node : nodes) {
+        if (node.ownFile && fclose(node.ownFile) != 0)
+            tempWritten = false;
+        node.ownFile = nullptr;
+    }
+    if (!tempWritten) {
+        printf("Stream: cannot write the temp files in %s\n", tmp.string().c_str());
+        fs::remove_all(tmp, ec);
+        return false;
+    }
+    if (!written) {
+        fs::remove_all(tmp, ec);
+        return false;
+    }
+    for (size_t n = nodes.size(); n-- > 0;) {
+        nodes[n].subtreeFaces += nodes[n].ownFaces;
+        if (nodes[n].parent >= 0)
+            nodes[nodes[n].parent].subtreeFaces += nodes[n].subtreeFaces;
+    }
+    printf("Stream: %d vertices locked on chunk borders\n", (int)lockCount.size());
+
+    const double ratio = params.targetFaceCount >= 0
+                             ? double(params.targetFaceCount) / double(totalFaces)
+                             : double(params.ratio);
+
+    // 4. Bottom-up: all nodes of one depth are independent of each other.
+    int maxDepth = 0;
+    for (const Node &node : nodes)
+        maxDepth = std::max(maxDepth, node.depth);
+    bool ok = true;
+    for (int depth = maxDepth; depth >= 0; --depth) {
+        std::vector<int> level;
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            if (nodes[n].depth == depth)
+                level.push_back(int(n));
+        }
+
+        // Triangles owned by these nodes are about to be simplified with the node: release the
+        // locks they hold. Lock counts are only read while the level runs.
+        for (int n : level) {
+            if (nodes[n].axis < 0 || !nodes[n].ownFaces)
+                continue;
+            std::vector<TriRecord> own;
+            ok &= ReadRecords(nodes[n].ownPath, own);
+            for (const TriRecord &r : own) {
+                for (int k = 0; k < 3; ++k) {
+                    auto it = lockCount.find(r.vert[k]);
+                    if (--it->second == 0)
+                        lockCount.erase(it);
+                }
+            }
+        }
+
+        std::vector<char> levelOk(level.size(), 1);
+        ParallelForEach(level.size(), workers, [&](size_t i, int) {
+            Node &node = nodes[level[i]];
+            std::vector<std::string> inputs;
+            uint64_t inputFaces = 0;
+            if (node.ownFaces) {
+                inputs.push_back(node.ownPath);
+                inputFaces += node.ownFaces;
+            }
+            for (int c : node.child) {
+                if (c >= 0 && nodes[c].resultFaces) {
+                    inputs.push_back(nodes[c].resultPath);
+                    inputFaces += nodes[c].resultFaces;
+                }
+            }
+
+            if (inputFaces > maxFaces) {
+                // Too big to load within the budget: pass the triangles on unsimplified.
+                FILE *out = fopen(node.resultPath.c_str(), "wb");
+                for (const std::string &in : inputs)
+                    levelOk[i] &= out && AppendFile(in, out);
+                if (out && fclose(out) != 0)
+                    levelOk[i] = 0;
+                node.resultFaces = inputFaces;
+            } else if (inputFaces) {
+                std::vector<TriRecord> records;
+                records.reserve(inputFaces);
+                for (const std::string &in : inputs)
+                    levelOk[i] &= ReadRecords(in, records);
+                MyMesh m;
+                BuildMesh(records, m);
+                records = std::vector<TriRecord>();
+
+                auto gid = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<uint64_t>(m, "gid");
+                for (MyVertex &v : m.vert) {
+                    if (lockCount.count(gid[v]))
+                        v.ClearW();
+                }
+                Simplifier::Params nodeParams = params;
+                nodeParams.threads            = 1;
+                nodeParams.collapseLog        = nullptr;
+                nodeParams.targetFaceCount    = int(node.subtreeFaces * ratio);
+                Simplifier::Simplify(m, nodeParams);
+                levelOk[i] &= WriteMesh(m, node.resultPath, node.resultFaces);
+            }
+            std::error_code removeError;
+            for (const std::string &in : inputs)
+                fs::remove(in, removeError);
+        });
+        for (char levelResult : levelOk)
+            ok &= levelResult != 0;
+    }
+
+    // 5. Output
+    const Node &root = nodes[0];
+    if (ok && root.resultFaces > maxFaces * workers) {
+        printf("Stream: the result (%llu faces) does not fit the memory budget; raise "
+               "--mem-budget or lower -r.\n",
+               (unsigned long long)root.resultFaces);
+        ok = false;
+    }
+    if (ok) {
+        std::vector<TriRecord> records;
+        ok = ReadRecords(root.resultPath, records);
+        MyMesh m;
+        BuildMesh(records, m);
+        records = std::vector<TriRecord>();
+        vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFace(m);
+        vcg::tri::UpdateNormal<MyMesh>::NormalizePerFace(m);
+        printf("[Final] V:%d F:%d\n", m.VN(), m.FN());
+
+        std::string ext = outputPath.substr(outputPath.find_last_of('.') + 1);
+        if (ext == "glb")
+            ok &= SaveGLB(m, model, outputPath, options.save);
+        else if (ext == "obj")
+            ok &= SaveObj(m, outputPath);
+        else
+            ok = false;
+    }
+    fs::remove_all(tmp, ec);
+
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Stream: %s in %.1f s\n", ok ? "done" : "failed", seconds);
+    return ok;
+}
\ No newline at end of file
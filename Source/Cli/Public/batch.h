@@ -0,0 +1,34 @@
+#pragma once
+#include "glb_loader.h"
+#include "simplifier.h"
+#include <string>
+#include <vector>
+
+// One input/output pair of a batch run. A job keeps either a ratio or an absolute face count.
+struct BatchJob {
+    std::string input;
+    std::string output;
+    float ratio         = 0.5f;
+    int targetFaceCount = -1;
+};
+
+// Manifest: one job per line, "input output [ratio|faces]", whitespace separated. A value <= 1
+// is a ratio, a larger one a target face count; it defaults to `defaultRatio`. Empty lines and
+// lines starting with '#' are skipped. A malformed line is reported as path:line and fails.
+bool ParseManifest(const std::string &path, float defaultRatio, std::vector<BatchJob> &jobs);
+
+// Directory glob such as "assets/*.glb" ('*' and '?' in the file name part only). Every match
+// becomes a job writing a file of the same name into outputDir, which is created if needed.
+bool ExpandGlob(const std::string &pattern, const std::string &outputDir, float ratio,
+                std::vector<BatchJob> &jobs);
+
+// Runs the jobs on `workers` simplification threads (0 = one per hardware thread). A loader
+// thread reads the next inputs and a saver thread writes finished meshes while the workers
+// simplify, with at most a few meshes in flight per stage. Prints a per-job summary at the end
+// and returns the number of failed jobs. ratio/targetFaceCount/threads in `params` are ignored.
+// A job whose simplification runs longer than timeLimitSeconds (0 = no limit) is cancelled and
+// reported as timed out without writing its output. A job whose output is its input is not run
+// and counts as failed. saveOptions are passed to SaveGLB and weldDistance to Simplifier::Clean.
+int RunBatch(const std::vector<BatchJob> &jobs, const Simplifier::Params &params, int workers,
+             double timeLimitSeconds = 0.0, const GLBSaveOptions &saveOptions = GLBSaveOptions(),
+             double weldDistance = -1.0);
\ No newline at end of file
@@ -1,6 +1,68 @@
 #pragma once
+#include "compact_mesh.h"
 #include "mymesh.h"
+#include <cstdint>
+#include <functional>
 #include <tiny_gltf.h>
 
-bool LoadGLB(MyMesh &m, tinygltf::Model &outModel, const std::string &filename);
-bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string &filename);
\ No newline at end of file
+// By default embedded images are not decoded: outModel.images keep their original encoded bytes
+// (PNG, JPEG, KTX2, ...) and SaveGLB copies them to the output unchanged. decodeImages = true
+// restores the old behaviour of decoding to RGBA and re-encoding as PNG on save. Files that
+// require KHR_mesh_quantization (such as SaveGLB's quantized output) are rejected.
+bool LoadGLB(MyMesh &m, tinygltf::Model &outModel, const std::string &filename,
+             bool decodeImages = false);
+// Same, filling the compact layout directly (the faces are not welded; see Simplifier::Clean).
+bool LoadGLB(CompactMesh &m, tinygltf::Model &outModel, const std::string &filename,
+             bool decodeImages = false);
+// KHR_mesh_quantization output: integer vertex attributes instead of floats. Each attribute is
+// rounded to a grid of the given number of bits and stored in the smallest type that holds it
+// (BYTE up to 8 bits, SHORT above).
+//  - POSITION: signed integers of positionBits (2..16) on a grid over the bounding box. The grid
+//    origin and step become the node's translation and uniform scale, so normals need no
+//    correction.
+//  - NORMAL: normalized vectors with normalBits (2..16) per component.
+//  - TEXCOORD_0: normalized unsigned values with uvBits (1..16) when every UV lies in [0, 1];
+//    float otherwise (tiling UVs would need KHR_texture_transform).
+// Normals and UVs narrower than their storage type are spread over its whole range, so they
+// decode to the same unit vectors and [0, 1] values. glTF pads every element to 4 bytes:
+// positions take 4 or 8 bytes, normals 4 or 8, UVs 4 either way. SaveGLB prints the bytes per
+// vertex and the largest error of each attribute.
+struct GLBQuantization {
+    bool enabled     = false;
+    int positionBits = 16;
+    int normalBits   = 8;
+    int uvBits       = 16;
+
+    // Every bit count within the range given above.
+    bool Valid() const {
+        return positionBits >= 2 && positionBits <= 16 && normalBits >= 2 && normalBits <= 16 &&
+               uvBits >= 1 && uvBits <= 16;
+    }
+};
+
+struct GLBSaveOptions {
+    // Reorders the triangles of each primitive and the vertices for the GPU caches and overdraw
+    // (see gpu_optimize.h) and prints the efficiency before and after.
+    bool optimizeForGpu = false;
+    GLBQuantization quantization;
+};
+
+bool SaveGLB(MyMesh &m, const tinygltf::Model &originalModel, const std::string &filename,
+             const GLBSaveOptions &options = GLBSaveOptions());
+
+// One triangle as stored in a GLB. Vertex ids are unique across all primitives of the file.
+struct GLBTriangle {
+    uint64_t vert[3];
+    vcg::Point3f pos[3];
+    vcg::Color4b color[3];
+    MyFace::TexCoordType uv[3];
+    int matId;
+};
+using GLBTriangleCallback = std::function<void(const GLBTriangle &)>;
+
+// Visits every triangle of a GLB without building a MyMesh. Geometry is read from a memory
+// mapping, so only the pages being visited need to be resident. outModel receives the metadata
+// SaveGLB needs. Returns false for files the mapped reader cannot handle (external buffers,
+// sparse or compressed accessors, KHR_mesh_quantization).
+bool ForEachGLBTriangle(const std::string &filename, tinygltf::Model &outModel,
+                        const GLBTriangleCallback &fn);
\ No newline at end of file
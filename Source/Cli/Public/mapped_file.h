@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool Open(const std::string &filename);
+    void Close();
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+  private:
+    const unsigned char *data = nullptr;
+    size_t size               = 0;
+#ifdef _WIN32
+    void *fileHandle    = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
\ No newline at end of file
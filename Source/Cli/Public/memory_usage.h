@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+
+// Peak resident set size of the process so far, in bytes (0 if the platform does not say).
+size_t PeakMemoryBytes();
+
+// Current resident set size of the process, in bytes (0 if the platform does not say).
+size_t CurrentMemoryBytes();
\ No newline at end of file
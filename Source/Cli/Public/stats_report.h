@@ -0,0 +1,16 @@
+#pragma once
+#include "simplifier.h"
+#include <string>
+
+// Current steady_clock time in milliseconds, on the timeline of Simplifier::Stats::phases.
+double StatsNowMs();
+
+// Appends a phase of the caller (load, clean, save...) that started at `startMs` and ends now.
+void AddPhase(Simplifier::Stats &stats, const char *name, double startMs);
+
+// Writes the phase totals, the collapse counters and the peak memory of the process as JSON.
+bool WriteStatsJson(const std::string &path, const Simplifier::Stats &stats);
+
+// Writes every recorded phase as a complete event of the Chrome trace format, for
+// chrome://tracing or ui.perfetto.dev. Times are relative to the first phase.
+bool WriteChromeTrace(const std::string &path, const Simplifier::Stats &stats);
\ No newline at end of file
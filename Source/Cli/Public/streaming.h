@@ -0,0 +1,28 @@
+#pragma once
+#include "glb_loader.h"
+#include "simplifier.h"
+#include <string>
+
+struct StreamOptions {
+    size_t memoryBudgetMB = 4096;
+    int threads           = 1; // chunks simplified concurrently (0 = all hardware threads)
+    std::string tempDir;       // empty: the system temp directory
+    GLBSaveOptions save;       // passed to SaveGLB
+};
+
+// Out-of-core simplification of a GLB that does not fit in memory.
+//
+// The input is read three times through a memory mapping (bounds, density histogram,
+// distribution) without ever building the full mesh. Space is split by a kd-tree into chunks
+// whose simplification fits the budget. Every triangle is written to a temp file of the lowest
+// tree node that contains all three of its vertices: triangles inside one chunk go to that leaf,
+// triangles crossing chunks go to the common ancestor. Nodes are then processed bottom-up: a
+// node loads its own triangles plus its children's results, simplifies them with every vertex
+// still referenced by an unprocessed ancestor locked, and writes the result back to disk. The
+// root result is the output.
+//
+// Peak memory stays around memoryBudgetMB plus the vertex lock table (one entry per vertex on a
+// chunk border). A node whose input exceeds the budget is passed through unsimplified; the final
+// mesh must fit the budget to be written.
+bool SimplifyStreaming(const std::string &inputPath, const std::string &outputPath,
+                       const Simplifier::Params &params, const StreamOptions &options);
\ No newline at end of file
@@ -1,10 +1,29 @@
+#include "Async/ParallelFor.h"
+#include "Engine/SkeletalMesh.h"
 #include "Features/IModularFeatures.h"
+#include "HAL/IConsoleManager.h"
 #include "IMeshReductionInterfaces.h"
 #include "MeshDescription.h"
+#include "Misc/ScopedSlowTask.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 #include "StaticMeshAttributes.h"
 #include "StaticMeshOperations.h"
+#include "VCGMeshReductionChain.h"
+#include "compact_mesh.h"
 #include "mymesh.h"
 #include "simplifier.h"
+#include <atomic>
+
+#if WITH_EDITOR
+#include "Engine/MeshMerging.h"
+#include "MaterialUtilities.h"
+#include "MeshMergeData.h"
+#include "MeshUtilities.h"
+#include "Modules/ModuleManager.h"
+#include "Rendering/SkeletalMeshLODImporterData.h"
+#include "Rendering/SkeletalMeshLODModel.h"
+#include "Rendering/SkeletalMeshModel.h"
+#endif
 
 class FVCGMeshReductionModule : public IMeshReductionModule {
   public:
@@ -23,11 +42,24 @@ class FVCGMeshReductionModule : public IMeshReductionModule {
 DEFINE_LOG_CATEGORY_STATIC(LogVCGMeshReduction, Log, All);
 IMPLEMENT_MODULE(FVCGMeshReductionModule, VCGMeshReduction);
 
+// Bumped by VCGCancelMeshReductions; a reduction stops when it changes while the reduction runs.
+static std::atomic<uint32> GVCGReductionGeneration{0};
+
+static TAutoConsoleVariable<int32> CVarVCGCompactPath(
+    TEXT("r.VCGReduction.CompactPath"), 0,
+    TEXT("1: static mesh reductions convert to CompactMesh and run the compact simplifier, which ")
+        TEXT("needs far less memory on large inputs but cannot be cancelled midway. 0: MyMesh ")
+        TEXT("path (default)."),
+    ECVF_Default);
+
+// Stateless: every reduction builds its own MyMesh and Simplifier session, so the engine may call
+// ReduceMeshDescription from several worker threads at once (see Simplifier thread safety notes).
 class FVCGMeshReduction : public IMeshReduction {
   public:
     virtual ~FVCGMeshReduction() {}
 
-    void ConvertToVCGMesh(const FMeshDescription &InMesh, MyMesh &OutMesh) {
+    static void ConvertToVCGMesh(const FMeshDescription &InMesh, MyMesh &OutMesh) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ConvertToVCGMesh");
         OutMesh.Clear();
         UE_LOG(LogVCGMeshReduction, Log,
                TEXT("ConvertToVCGMesh - Start. Input Vertices: %d, Triangles: %d"),
@@ -39,98 +71,181 @@ class FVCGMeshReduction : public IMeshReduction {
             InAttributes.GetVertexInstanceUVs();
         TVertexInstanceAttributesConstRef<FVector4f> InVertexInstanceColors =
             InAttributes.GetVertexInstanceColors();
+        const bool bHasUVs    = InVertexInstanceUVs.GetNumChannels() > 0;
+        const bool bHasColors = InVertexInstanceColors.GetNumElements() > 0;
 
         // 1. Add Vertices
-        // Note: FMeshDescription Vertices can be sparse.
-        // We iterate available vertices.
-        vcg::tri::Allocator<MyMesh>::AddVertices(OutMesh, InMesh.Vertices().Num());
-
-        TMap<FVertexID, int32> VertexIDToVCGIndex;
-        int32 VCGVertIdx = 0;
-
+        // FMeshDescription IDs can be sparse: VertexIDToVCGIndex maps them densely (INDEX_NONE for
+        // unused IDs). Only the ID walk is serial; the attributes are read in parallel.
+        TArray<FVertexID> VertexIDs;
+        VertexIDs.Reserve(InMesh.Vertices().Num());
+        TArray<int32> VertexIDToVCGIndex;
+        VertexIDToVCGIndex.Init(INDEX_NONE, InMesh.Vertices().GetArraySize());
         for (const FVertexID VertexID : InMesh.Vertices().GetElementIDs()) {
-            const FVector3f &Pos         = InVertexPositions[VertexID];
-            OutMesh.vert[VCGVertIdx].P() = vcg::Point3f(Pos.X, Pos.Y, Pos.Z);
+            VertexIDToVCGIndex[VertexID.GetValue()] = VertexIDs.Add(VertexID);
+        }
+        vcg::tri::Allocator<MyMesh>::AddVertices(OutMesh, VertexIDs.Num());
+
+        ParallelFor(VertexIDs.Num(), [&](int32 Index) {
+            const FVertexID VertexID = VertexIDs[Index];
+            MyVertex &V              = OutMesh.vert[Index];
+            const FVector3f &Pos     = InVertexPositions[VertexID];
+            V.P()                    = vcg::Point3f(Pos.X, Pos.Y, Pos.Z);
+            V.C()                    = vcg::Color4b::White;
 
-            // Import Vertex Color (Take average or first instance)
-            if (InVertexInstanceColors.GetNumElements() > 0) {
+            // Import Vertex Color (first instance)
+            if (bHasColors) {
                 TArrayView<const FVertexInstanceID> VertexInstances =
                     InMesh.GetVertexVertexInstanceIDs(VertexID);
                 if (VertexInstances.Num() > 0) {
                     FVector4f Color = InVertexInstanceColors[VertexInstances[0]];
-                    OutMesh.vert[VCGVertIdx].C() =
-                        vcg::Color4b((uint8)(Color.X * 255.f), (uint8)(Color.Y * 255.f),
-                                     (uint8)(Color.Z * 255.f), (uint8)(Color.W * 255.f));
-                } else {
-                    OutMesh.vert[VCGVertIdx].C() = vcg::Color4b::White;
+                    V.C() = vcg::Color4b((uint8)(Color.X * 255.f), (uint8)(Color.Y * 255.f),
+                                         (uint8)(Color.Z * 255.f), (uint8)(Color.W * 255.f));
                 }
-            } else {
-                OutMesh.vert[VCGVertIdx].C() = vcg::Color4b::White;
             }
-
-            VertexIDToVCGIndex.Add(VertexID, VCGVertIdx);
-            VCGVertIdx++;
-        }
+        });
 
         // 2. Add Faces (Triangles)
-        vcg::tri::Allocator<MyMesh>::AddFaces(OutMesh, InMesh.Triangles().Num());
-        int32 VCGFaceIdx = 0;
-
+        TArray<FTriangleID> TriangleIDs;
+        TriangleIDs.Reserve(InMesh.Triangles().Num());
         for (const FTriangleID TriangleID : InMesh.Triangles().GetElementIDs()) {
+            TriangleIDs.Add(TriangleID);
+        }
+        vcg::tri::Allocator<MyMesh>::AddFaces(OutMesh, TriangleIDs.Num());
+
+        // Triangles referencing a missing vertex are flagged deleted; Clean compacts them away.
+        std::atomic<int32> MissingTriangles{0};
+        ParallelFor(TriangleIDs.Num(), [&](int32 Index) {
+            const FTriangleID TriangleID = TriangleIDs[Index];
+            MyFace &F                    = OutMesh.face[Index];
             TArrayView<const FVertexInstanceID> VertexInstances =
                 InMesh.GetTriangleVertexInstances(TriangleID);
 
-            if (VertexInstances.Num() != 3)
-                continue; // Should be triangle
-
-            bool bHasMissingVertex = false;
-
-            for (int j = 0; j < 3; ++j) {
+            bool bHasMissingVertex = VertexInstances.Num() != 3;
+            for (int j = 0; j < 3 && !bHasMissingVertex; ++j) {
                 FVertexInstanceID InstanceID = VertexInstances[j];
-                FVertexID VertexID           = InMesh.GetVertexInstanceVertex(InstanceID);
-
-                if (int32 *IdxPtr = VertexIDToVCGIndex.Find(VertexID)) {
-                    OutMesh.face[VCGFaceIdx].V(j) = &OutMesh.vert[*IdxPtr];
-                } else {
+                const int32 VCGIndex =
+                    VertexIDToVCGIndex[InMesh.GetVertexInstanceVertex(InstanceID).GetValue()];
+                if (VCGIndex == INDEX_NONE) {
                     bHasMissingVertex = true;
+                    break;
                 }
+                F.V(j) = &OutMesh.vert[VCGIndex];
 
                 // UVs - Channel 0
-                if (InVertexInstanceUVs.GetNumChannels() > 0) {
-                    FVector2f UV                   = InVertexInstanceUVs.Get(InstanceID, 0);
-                    OutMesh.face[VCGFaceIdx].WT(j) = vcg::TexCoord2f(UV.X, UV.Y);
+                if (bHasUVs) {
+                    FVector2f UV = InVertexInstanceUVs.Get(InstanceID, 0);
+                    F.WT(j)      = vcg::TexCoord2f(UV.X, UV.Y);
                 }
             }
 
             // Material ID
-            FPolygonGroupID GroupID        = InMesh.GetTrianglePolygonGroup(TriangleID);
-            OutMesh.face[VCGFaceIdx].matId = GroupID.GetValue();
+            F.matId = InMesh.GetTrianglePolygonGroup(TriangleID).GetValue();
 
-            if (!bHasMissingVertex) {
-                VCGFaceIdx++;
+            if (bHasMissingVertex) {
+                F.SetD();
+                ++MissingTriangles;
             }
-        }
+        });
+        OutMesh.fn -= MissingTriangles.load();
 
         // Log unique material IDs found during conversion
         TMap<int32, int32> MatCounts;
-        for (int i = 0; i < VCGFaceIdx; ++i) {
-            MatCounts.FindOrAdd(OutMesh.face[i].matId)++;
+        for (const MyFace &F : OutMesh.face) {
+            if (!F.IsD()) {
+                MatCounts.FindOrAdd(F.matId)++;
+            }
         }
         UE_LOG(LogVCGMeshReduction, Log,
-               TEXT("ConvertToVCGMesh - Summary: Found %d unique materials"), MatCounts.Num());
+               TEXT("ConvertToVCGMesh - Summary: Found %d unique materials, skipped %d triangles"),
+               MatCounts.Num(), MissingTriangles.load());
         for (const auto &Pair : MatCounts) {
             UE_LOG(LogVCGMeshReduction, Log, TEXT("  MatID: %d -> %d faces"), Pair.Key, Pair.Value);
         }
+    }
+
+    // CompactMesh counterpart of ConvertToVCGMesh: the same dense ID walk, written straight into
+    // the flat arrays. Triangles referencing a missing vertex become degenerate for Clean.
+    static void ConvertToCompactMesh(const FMeshDescription &InMesh, CompactMesh &OutMesh) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ConvertToCompactMesh");
+        FStaticMeshConstAttributes InAttributes(InMesh);
+        TVertexAttributesConstRef<FVector3f> InVertexPositions = InAttributes.GetVertexPositions();
+        TVertexInstanceAttributesConstRef<FVector2f> InVertexInstanceUVs =
+            InAttributes.GetVertexInstanceUVs();
+        TVertexInstanceAttributesConstRef<FVector4f> InVertexInstanceColors =
+            InAttributes.GetVertexInstanceColors();
+        const bool bHasUVs    = InVertexInstanceUVs.GetNumChannels() > 0;
+        const bool bHasColors = InVertexInstanceColors.GetNumElements() > 0;
 
-        // Resize faces vector to actual count if we skipped any
-        if (VCGFaceIdx < OutMesh.face.size()) {
-            OutMesh.face.resize(VCGFaceIdx);
-            OutMesh.fn = VCGFaceIdx;
+        TArray<FVertexID> VertexIDs;
+        VertexIDs.Reserve(InMesh.Vertices().Num());
+        TArray<int32> VertexIDToIndex;
+        VertexIDToIndex.Init(INDEX_NONE, InMesh.Vertices().GetArraySize());
+        for (const FVertexID VertexID : InMesh.Vertices().GetElementIDs()) {
+            VertexIDToIndex[VertexID.GetValue()] = VertexIDs.Add(VertexID);
+        }
+        TArray<FTriangleID> TriangleIDs;
+        TriangleIDs.Reserve(InMesh.Triangles().Num());
+        for (const FTriangleID TriangleID : InMesh.Triangles().GetElementIDs()) {
+            TriangleIDs.Add(TriangleID);
         }
+        OutMesh.Clear();
+        OutMesh.Resize(VertexIDs.Num(), TriangleIDs.Num());
+
+        ParallelFor(VertexIDs.Num(), [&](int32 Index) {
+            const FVertexID VertexID = VertexIDs[Index];
+            const FVector3f &Pos     = InVertexPositions[VertexID];
+            float *P                 = &OutMesh.positions[size_t(Index) * 3];
+            P[0]                     = Pos.X;
+            P[1]                     = Pos.Y;
+            P[2]                     = Pos.Z;
+            if (bHasColors) {
+                TArrayView<const FVertexInstanceID> VertexInstances =
+                    InMesh.GetVertexVertexInstanceIDs(VertexID);
+                if (VertexInstances.Num() > 0) {
+                    FVector4f Color = InVertexInstanceColors[VertexInstances[0]];
+                    OutMesh.colors[Index] = CompactMesh::PackColor(
+                        vcg::Color4b((uint8)(Color.X * 255.f), (uint8)(Color.Y * 255.f),
+                                     (uint8)(Color.Z * 255.f), (uint8)(Color.W * 255.f)));
+                }
+            }
+        });
+
+        ParallelFor(TriangleIDs.Num(), [&](int32 Index) {
+            const FTriangleID TriangleID = TriangleIDs[Index];
+            TArrayView<const FVertexInstanceID> VertexInstances =
+                InMesh.GetTriangleVertexInstances(TriangleID);
+            uint32 *Corners = &OutMesh.indices[size_t(Index) * 3];
+            float *UVs      = &OutMesh.uvs[size_t(Index) * 6];
+            for (int j = 0; j < 3 && VertexInstances.Num() == 3; ++j) {
+                const FVertexInstanceID InstanceID = VertexInstances[j];
+                const int32 VertexIndex =
+                    VertexIDToIndex[InMesh.GetVertexInstanceVertex(InstanceID).GetValue()];
+                if (VertexIndex == INDEX_NONE) {
+                    Corners[0] = Corners[1] = Corners[2] = 0;
+                    break;
+                }
+                Corners[j] = uint32(VertexIndex);
+                if (bHasUVs) {
+                    FVector2f UV   = InVertexInstanceUVs.Get(InstanceID, 0);
+                    UVs[j * 2]     = UV.X;
+                    UVs[j * 2 + 1] = UV.Y;
+                }
+            }
+            OutMesh.matIds[Index] = InMesh.GetTrianglePolygonGroup(TriangleID).GetValue();
+        });
+        UE_LOG(LogVCGMeshReduction, Log,
+               TEXT("ConvertToCompactMesh - Vertices: %d, Triangles: %d, %llu bytes"),
+               VertexIDs.Num(), TriangleIDs.Num(), (uint64)OutMesh.MemoryBytes());
     }
 
-    void ConvertToFMeshDescription(const MyMesh &InVCGMesh, const FMeshDescription &OriginalMesh,
+    // Creating mesh description elements is serial, so vertices, vertex instances and triangles
+    // are created in one pass with dense index arrays instead of maps, and the attributes are
+    // filled in parallel afterwards. Corners share a vertex instance when they have the same
+    // vertex and UV: normals and colors come from the vertex, so those match as well.
+    static void ConvertToFMeshDescription(const MyMesh &InVCGMesh, const FMeshDescription &OriginalMesh,
                                    FMeshDescription &OutMesh) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ConvertToMeshDescription");
         OutMesh.Empty();
 
         FStaticMeshAttributes OutAttributes(OutMesh);
@@ -149,8 +264,8 @@ class FVCGMeshReduction : public IMeshReduction {
         }
         TVertexInstanceAttributesRef<FVector4f> OutColors = OutAttributes.GetVertexInstanceColors();
 
-        // Reconstruct PolygonGroups (Materials) from Input
-        TMap<int32, FPolygonGroupID> MatIdToNewPolygonGroup;
+        // Reconstruct PolygonGroups (Materials) from Input. matId is the input polygon group ID,
+        // so a dense array indexed by it replaces the lookup map.
         FStaticMeshConstAttributes InAttributes(OriginalMesh);
 
         TPolygonGroupAttributesConstRef<FName> InSlotNames =
@@ -161,83 +276,216 @@ class FVCGMeshReduction : public IMeshReduction {
         UE_LOG(LogVCGMeshReduction, Log, TEXT("Reconstruction Info: HasColors: %d"),
                bHasVertexColors);
 
-        TSet<int32> UniqueMatIds;
-        for (int i = 0; i < InVCGMesh.face.size(); ++i) {
-            if (!InVCGMesh.face[i].IsD()) {
-                UniqueMatIds.Add(InVCGMesh.face[i].matId);
-            }
-        }
-        UE_LOG(LogVCGMeshReduction, Log,
-               TEXT("Input Mesh PolygonGroups: %d, Unique Material IDs in VCG Faces: %d"),
-               OriginalMesh.PolygonGroups().Num(), UniqueMatIds.Num());
-
+        TArray<FPolygonGroupID> MatIdToNewPolygonGroup;
+        MatIdToNewPolygonGroup.Init(FPolygonGroupID(INDEX_NONE),
+                                    OriginalMesh.PolygonGroups().GetArraySize());
         for (const FPolygonGroupID InputGroupID : OriginalMesh.PolygonGroups().GetElementIDs()) {
             FPolygonGroupID NewGroupID = OutMesh.CreatePolygonGroup();
-            MatIdToNewPolygonGroup.Add(InputGroupID.GetValue(), NewGroupID);
+            MatIdToNewPolygonGroup[InputGroupID.GetValue()] = NewGroupID;
 
             OutSlotNames[NewGroupID] = InSlotNames[InputGroupID];
         }
+        FPolygonGroupID FallbackGroup(INDEX_NONE);
+        auto GroupForMatId = [&](int32 MatId) {
+            if (MatIdToNewPolygonGroup.IsValidIndex(MatId) &&
+                MatIdToNewPolygonGroup[MatId] != INDEX_NONE) {
+                return MatIdToNewPolygonGroup[MatId];
+            }
+            if (FallbackGroup == INDEX_NONE) {
+                FallbackGroup = OutMesh.PolygonGroups().Num() > 0
+                                    ? *OutMesh.PolygonGroups().GetElementIDs().begin()
+                                    : OutMesh.CreatePolygonGroup();
+            }
+            return FallbackGroup;
+        };
 
         // Reconstruct Vertices
-        TMap<const MyVertex *, FVertexID> VCGPtrToVertexID;
-
-        for (int i = 0; i < InVCGMesh.vert.size(); ++i) {
+        const int32 NumVerts = (int32)InVCGMesh.vert.size();
+        TArray<FVertexID> VCGToVertexID;
+        VCGToVertexID.Init(FVertexID(INDEX_NONE), NumVerts);
+        OutMesh.ReserveNewVertices(InVCGMesh.vn);
+        for (int32 i = 0; i < NumVerts; ++i) {
             if (!InVCGMesh.vert[i].IsD()) {
-                FVertexID NewVertID     = OutMesh.CreateVertex();
-                const vcg::Point3f &P   = InVCGMesh.vert[i].P();
-                OutPositions[NewVertID] = FVector3f(P.X(), P.Y(), P.Z());
-                VCGPtrToVertexID.Add(&InVCGMesh.vert[i], NewVertID);
+                VCGToVertexID[i] = OutMesh.CreateVertex();
             }
         }
 
-        // Reconstruct Faces
-        for (int i = 0; i < InVCGMesh.face.size(); ++i) {
-            if (!InVCGMesh.face[i].IsD()) {
-                FVertexInstanceID CornerInstances[3];
-                bool bValidFace = true;
-
-                for (int j = 0; j < 3; ++j) {
-                    const MyVertex *v = InVCGMesh.face[i].V(j);
-                    if (FVertexID *PID = VCGPtrToVertexID.Find(v)) {
-                        CornerInstances[j] = OutMesh.CreateVertexInstance(*PID);
-
-                        // The simplifier might compact UVs or just keep them on faces.
-                        // VCG stores per-face-vertex UVs in WT
-                        const vcg::TexCoord2f &uv = InVCGMesh.face[i].WT(j);
-                        OutUVs.Set(CornerInstances[j], 0, FVector2f(uv.U(), uv.V()));
-
-                        // Color
-                        const vcg::Color4b &c = InVCGMesh.face[i].V(j)->C();
-                        if (bHasVertexColors) {
-                            OutColors[CornerInstances[j]] =
-                                FVector4f(c[0] / 255.f, c[1] / 255.f, c[2] / 255.f, c[3] / 255.f);
-                        }
-
-                        // Normal
-                        // Use vertex normal for smooth shading
-                        // 如果需要平面着色，可以使用 face[i].N()
-                        const vcg::Point3f &n          = InVCGMesh.face[i].V(j)->N();
-                        OutNormals[CornerInstances[j]] = FVector3f(n.X(), n.Y(), n.Z());
-                    } else {
-                        bValidFace = false;
-                    }
+        // Reconstruct Faces. Each vertex keeps a chain of the instances created for it so far
+        // (FirstInstance, then Next), usually one per UV island touching it.
+        struct FInstanceSource {
+            int32 VCGVertex;
+            vcg::TexCoord2f UV;
+            int32 Next;
+        };
+        TArray<FInstanceSource> Instances;
+        Instances.Reserve(InVCGMesh.vn + InVCGMesh.vn / 4);
+        TArray<int32> FirstInstance;
+        FirstInstance.Init(INDEX_NONE, NumVerts);
+        OutMesh.ReserveNewVertexInstances(InVCGMesh.vn + InVCGMesh.vn / 4);
+        OutMesh.ReserveNewTriangles(InVCGMesh.fn);
+        OutMesh.ReserveNewPolygons(InVCGMesh.fn);
+
+        for (const MyFace &F : InVCGMesh.face) {
+            if (F.IsD()) {
+                continue;
+            }
+            FVertexInstanceID CornerInstances[3];
+            for (int j = 0; j < 3; ++j) {
+                const int32 VCGVertex     = (int32)vcg::tri::Index(InVCGMesh, F.cV(j));
+                const vcg::TexCoord2f &UV = F.cWT(j);
+                int32 Found               = FirstInstance[VCGVertex];
+                while (Found != INDEX_NONE && !(Instances[Found].UV.U() == UV.U() &&
+                                                Instances[Found].UV.V() == UV.V())) {
+                    Found = Instances[Found].Next;
                 }
+                if (Found == INDEX_NONE) {
+                    FVertexInstanceID NewInstance =
+                        OutMesh.CreateVertexInstance(VCGToVertexID[VCGVertex]);
+                    // IDs of a freshly emptied mesh description are handed out densely.
+                    check(NewInstance.GetValue() == Instances.Num());
+                    Found = Instances.Add({VCGVertex, UV, FirstInstance[VCGVertex]});
+                    FirstInstance[VCGVertex] = Found;
+                }
+                CornerInstances[j] = FVertexInstanceID(Found);
+            }
+            OutMesh.CreateTriangle(GroupForMatId(F.matId), CornerInstances);
+        }
 
-                if (bValidFace) {
-                    FPolygonGroupID GroupID(INDEX_NONE);
-                    if (FPolygonGroupID *FoundGroup =
-                            MatIdToNewPolygonGroup.Find(InVCGMesh.face[i].matId)) {
-                        GroupID = *FoundGroup;
-                    } else if (OutMesh.PolygonGroups().Num() > 0) {
-                        GroupID = *OutMesh.PolygonGroups().GetElementIDs().begin();
-                    } else {
-                        GroupID = OutMesh.CreatePolygonGroup();
-                        MatIdToNewPolygonGroup.Add(InVCGMesh.face[i].matId, GroupID);
-                    }
-                    OutMesh.CreatePolygon(GroupID, CornerInstances);
+        // Attributes, in parallel
+        ParallelFor(NumVerts, [&](int32 i) {
+            if (VCGToVertexID[i] != INDEX_NONE) {
+                const vcg::Point3f &P          = InVCGMesh.vert[i].cP();
+                OutPositions[VCGToVertexID[i]] = FVector3f(P.X(), P.Y(), P.Z());
+            }
+        });
+        ParallelFor(Instances.Num(), [&](int32 i) {
+            const FInstanceSource &Source = Instances[i];
+            const MyVertex &V             = InVCGMesh.vert[Source.VCGVertex];
+            const FVertexInstanceID InstanceID(i);
+            OutUVs.Set(InstanceID, 0, FVector2f(Source.UV.U(), Source.UV.V()));
+
+            // Use vertex normal for smooth shading
+            // 如果需要平面着色，可以使用 face[i].N()
+            const vcg::Point3f &n  = V.cN();
+            OutNormals[InstanceID] = FVector3f(n.X(), n.Y(), n.Z());
+
+            if (bHasVertexColors) {
+                const vcg::Color4b &c = V.cC();
+                OutColors[InstanceID] =
+                    FVector4f(c[0] / 255.f, c[1] / 255.f, c[2] / 255.f, c[3] / 255.f);
+            }
+        });
+        UE_LOG(LogVCGMeshReduction, Log,
+               TEXT("Reconstruction Info: %d vertices, %d vertex instances, %d triangles"),
+               OutMesh.Vertices().Num(), Instances.Num(), OutMesh.Triangles().Num());
+    }
+
+    // Maps EMeshFeatureImportance / SkeletalMeshOptimizationImportance (same values) to a weight.
+    static double ImportanceToWeight(uint8 Importance) {
+        switch (Importance) {
+        case 0:
+            return 0.0; // Off
+        case 1:
+            return 0.25; // Lowest
+        case 2:
+            return 0.5; // Low
+        case 3:
+            return 1.0; // Normal
+        case 4:
+            return 3.0; // High
+        case 5:
+            return 10.0; // Highest
+        default:
+            return 1.0;
+        }
+    }
+
+    static Simplifier::Params MakeParams(const FMeshReductionSettings &ReductionSettings) {
+        Simplifier::Params params;
+        params.ratio = ReductionSettings.PercentTriangles;
+
+        params.extraTCoordWeight = ImportanceToWeight((uint8)ReductionSettings.TextureImportance);
+        params.boundaryWeight = ImportanceToWeight((uint8)ReductionSettings.SilhouetteImportance);
+
+        if ((uint8)ReductionSettings.ShadingImportance >= 4) {
+            params.normalCheck = true;
+        }
+
+        // MaxDeviation alone (PercentTriangles left at 100%) reduces as far as the tolerance
+        // allows; together with a percentage, whichever limit is hit first stops the reduction.
+        if (ReductionSettings.MaxDeviation > 0.0f) {
+            params.maxError = ReductionSettings.MaxDeviation;
+            if (ReductionSettings.PercentTriangles >= 1.0f) {
+                params.ratio = 0.0f;
+            }
+        }
+        return params;
+    }
+
+    // Runs a Simplifier::Session in short steps. On the game thread a delayed slow task dialog
+    // shows the progress and offers a cancel button; on any thread the reduction stops once
+    // VCGCancelMeshReductions is called. Returns false if it was cancelled, in which case the mesh
+    // is only partially reduced.
+    static bool SimplifyWithProgress(MyMesh &m, const Simplifier::Params &InParams) {
+        const uint32 Generation = GVCGReductionGeneration.load();
+        TOptional<FScopedSlowTask> SlowTask;
+        if (IsInGameThread()) {
+            SlowTask.Emplace(1.0f, NSLOCTEXT("VCGMeshReduction", "Reducing", "Reducing mesh..."));
+            SlowTask->MakeDialogDelayed(1.0f, true);
+        }
+
+        Simplifier::Session Session(m, InParams);
+        float Reported = 0.0f;
+        while (Session.Step(50.0)) {
+            if (SlowTask.IsSet()) {
+                const float Progress = Session.Progress();
+                SlowTask->EnterProgressFrame(Progress - Reported);
+                Reported = Progress;
+                if (SlowTask->ShouldCancel()) {
+                    Session.Cancel();
                 }
             }
+            if (GVCGReductionGeneration.load() != Generation) {
+                Session.Cancel();
+            }
         }
+        return Session.Finish();
+    }
+
+    // Builds one reduced mesh per entry of Settings from a single decimation session. Only
+    // PercentTriangles may differ between the entries; the other settings are taken from the
+    // first one.
+    static void ReduceMeshDescriptionChain(TArray<FMeshDescription> &OutReducedMeshes,
+                                    const FMeshDescription &InMesh,
+                                    const TArray<FMeshReductionSettings> &Settings) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ReduceMeshDescriptionChain");
+        OutReducedMeshes.SetNum(Settings.Num());
+        if (Settings.Num() == 0) {
+            return;
+        }
+        UE_LOG(LogVCGMeshReduction, Log, TEXT("ReduceMeshDescriptionChain - Start. Levels: %d"),
+               Settings.Num());
+
+        MyMesh m;
+        ConvertToVCGMesh(InMesh, m);
+        Simplifier::Clean(m);
+
+        std::vector<int> Targets;
+        for (const FMeshReductionSettings &LevelSettings : Settings) {
+            Targets.push_back((int)(m.fn * LevelSettings.PercentTriangles));
+        }
+
+        Simplifier::SimplifyChain(
+            m, Targets,
+            [&](size_t Level, MyMesh &Lod) {
+                FMeshDescription &OutReducedMesh = OutReducedMeshes[(int32)Level];
+                ConvertToFMeshDescription(Lod, InMesh, OutReducedMesh);
+                FStaticMeshOperations::ComputeTriangleTangentsAndNormals(OutReducedMesh);
+                UE_LOG(LogVCGMeshReduction, Log,
+                       TEXT("  LOD%d - Output Vertices: %d, Polygons: %d"), (int32)Level,
+                       OutReducedMesh.Vertices().Num(), OutReducedMesh.Polygons().Num());
+            },
+            MakeParams(Settings[0]));
     }
 
     // IMeshReduction interface - UE5 Adapter
@@ -247,46 +495,35 @@ class FVCGMeshReduction : public IMeshReduction {
                           const FMeshDescription &InMesh,
                           const FOverlappingCorners &InOverlappingCorners,
                           const struct FMeshReductionSettings &ReductionSettings) override {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ReduceMeshDescription");
         UE_LOG(LogVCGMeshReduction, Log, TEXT("ReduceMeshDescription - Start. Target Percent: %f"),
                ReductionSettings.PercentTriangles);
 
         MyMesh m;
-
-        // 1. Convert FMeshDescription to MyMesh
-        ConvertToVCGMesh(InMesh, m);
-        Simplifier::Params params;
-        params.ratio = ReductionSettings.PercentTriangles;
-        // Map Importance settings
-        auto ImportanceToWeight = [](uint8 Importance) -> double {
-            switch (Importance) {
-            case 0:
-                return 0.0; // Off
-            case 1:
-                return 0.25; // Lowest
-            case 2:
-                return 0.5; // Low
-            case 3:
-                return 1.0; // Normal
-            case 4:
-                return 3.0; // High
-            case 5:
-                return 10.0; // Highest
-            default:
-                return 1.0;
+        Simplifier::Params params = MakeParams(ReductionSettings);
+        Simplifier::Stats Stats;
+        params.stats = &Stats;
+
+        if (CVarVCGCompactPath.GetValueOnAnyThread() != 0) {
+            // Compact path: only the reduced mesh is ever held as a MyMesh.
+            CompactMesh Compact;
+            ConvertToCompactMesh(InMesh, Compact);
+            Simplifier::Clean(Compact);
+            Simplifier::Simplify(Compact, params);
+            FromCompactMesh(Compact, m);
+        } else {
+            // 1. Convert FMeshDescription to MyMesh
+            ConvertToVCGMesh(InMesh, m);
+            Simplifier::Clean(m);
+
+            if (!SimplifyWithProgress(m, params)) {
+                UE_LOG(LogVCGMeshReduction, Warning,
+                       TEXT("ReduceMeshDescription - Cancelled at %d faces, keeping the partial "
+                            "result"),
+                       m.fn);
             }
-        };
-
-        params.extraTCoordWeight = ImportanceToWeight((uint8)ReductionSettings.TextureImportance);
-        params.boundaryWeight = ImportanceToWeight((uint8)ReductionSettings.SilhouetteImportance);
-
-        if ((uint8)ReductionSettings.ShadingImportance >= 4) {
-            params.normalCheck = true;
         }
 
-        Simplifier::Clean(m);
-
-        Simplifier::Simplify(m, params);
-
         UE_LOG(LogVCGMeshReduction, Log,
                TEXT("Simplification Done. VCG Mesh Vertices: %d, Faces: %d"), m.vert.size(),
                m.face.size());
@@ -300,12 +537,316 @@ class FVCGMeshReduction : public IMeshReduction {
         // 4. Recompute Tangents
         FStaticMeshOperations::ComputeTriangleTangentsAndNormals(OutReducedMesh);
 
-        OutMaxDeviation = 0.0f;
+        // Largest quadric distance of a performed collapse, which the engine uses to derive LOD
+        // screen sizes.
+        OutMaxDeviation = (float)Stats.collapses.maxDeviation;
     }
 
+#if WITH_EDITOR
+    // Per-vertex index of the imported point a vertex came from, carried through the simplifier
+    // next to the skin weights (the surviving vertex of a collapse keeps its own) so the reduced
+    // LOD keeps a MeshToImportVertexMap.
+    static constexpr const char *SourcePointAttribute = "sourcePoint";
+
+    // Maps every bone of the reference skeleton to itself, or, for bones pruned from the LOD
+    // (FSkeletalMeshLODInfo::BonesToRemove and their children), to the nearest kept ancestor.
+    static TArray<int32> MakeBoneRemap(const FReferenceSkeleton &RefSkeleton,
+                                       const FSkeletalMeshLODInfo &LODInfo) {
+        const int32 NumBones = RefSkeleton.GetRawBoneNum();
+        TArray<bool> Removed;
+        Removed.Init(false, NumBones);
+        for (const FBoneReference &Bone : LODInfo.BonesToRemove) {
+            const int32 BoneIndex = RefSkeleton.FindRawBoneIndex(Bone.BoneName);
+            if (BoneIndex != INDEX_NONE) {
+                Removed[BoneIndex] = true;
+            }
+        }
+        // Parents come before their children, so one pass propagates the removal down the
+        // hierarchy.
+        TArray<int32> Remap;
+        Remap.SetNumUninitialized(NumBones);
+        for (int32 BoneIndex = 0; BoneIndex < NumBones; ++BoneIndex) {
+            const int32 Parent = RefSkeleton.GetRawParentIndex(BoneIndex);
+            if (Parent != INDEX_NONE && Removed[Parent]) {
+                Removed[BoneIndex] = true;
+            }
+            Remap[BoneIndex] =
+                Removed[BoneIndex] && Parent != INDEX_NONE ? Remap[Parent] : BoneIndex;
+        }
+        return Remap;
+    }
+
+    // One vertex per soft skin vertex, with its influences remapped through BoneRemap and limited
+    // to MaxInfluences, and one face per triangle with UV channel 0 and the section material.
+    // Soft vertices are split at UV and normal seams; Clean welds them back together.
+    static void ConvertToVCGMesh(const FSkeletalMeshLODModel &InModel,
+                                 const TArray<int32> &BoneRemap, int32 MaxInfluences,
+                                 MyMesh &OutMesh) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ConvertSkeletalToVCGMesh");
+        OutMesh.Clear();
+        int32 NumVerts = 0;
+        int32 NumFaces = 0;
+        for (const FSkelMeshSection &Section : InModel.Sections) {
+            NumVerts = FMath::Max(NumVerts,
+                                  (int32)Section.BaseVertexIndex + Section.SoftVertices.Num());
+            NumFaces += (int32)Section.NumTriangles;
+        }
+        vcg::tri::Allocator<MyMesh>::AddVertices(OutMesh, NumVerts);
+        vcg::tri::Allocator<MyMesh>::AddFaces(OutMesh, NumFaces);
+        SkinHandle Skin = vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<SkinWeights>(
+            OutMesh, SkinWeights::kAttribute);
+        MyMesh::PerVertexAttributeHandle<int32> SourcePoint =
+            vcg::tri::Allocator<MyMesh>::GetPerVertexAttribute<int32>(OutMesh,
+                                                                      SourcePointAttribute);
+
+        int32 FaceBase = 0;
+        for (const FSkelMeshSection &Section : InModel.Sections) {
+            ParallelFor(Section.SoftVertices.Num(), [&](int32 i) {
+                const FSoftSkinVertex &SoftVertex = Section.SoftVertices[i];
+                const int32 Index                 = (int32)Section.BaseVertexIndex + i;
+                MyVertex &V                       = OutMesh.vert[Index];
+
+                V.P() = vcg::Point3f(SoftVertex.Position.X, SoftVertex.Position.Y,
+                                     SoftVertex.Position.Z);
+                V.C() = vcg::Color4b(SoftVertex.Color.R, SoftVertex.Color.G, SoftVertex.Color.B,
+                                     SoftVertex.Color.A);
+
+                // Raw weights are fixed point; Limit normalizes them.
+                SkinWeights Weights;
+                for (int32 k = 0; k < MAX_TOTAL_INFLUENCES; ++k) {
+                    if (SoftVertex.InfluenceWeights[k] > 0) {
+                        const int32 Bone = BoneRemap[Section.BoneMap[SoftVertex.InfluenceBones[k]]];
+                        Weights.Add((uint16_t)Bone, (float)SoftVertex.InfluenceWeights[k]);
+                    }
+                }
+                Weights.Limit(MaxInfluences);
+                Skin[Index]        = Weights;
+                SourcePoint[Index] = InModel.MeshToImportVertexMap.IsValidIndex(Index)
+                                         ? InModel.MeshToImportVertexMap[Index]
+                                         : Index;
+            });
+
+            ParallelFor((int32)Section.NumTriangles, [&](int32 t) {
+                MyFace &F = OutMesh.face[FaceBase + t];
+                for (int j = 0; j < 3; ++j) {
+                    const uint32 Index = InModel.IndexBuffer[Section.BaseIndex + t * 3 + j];
+                    const FVector2f &UV =
+                        Section.SoftVertices[Index - Section.BaseVertexIndex].UVs[0];
+                    F.V(j)  = &OutMesh.vert[Index];
+                    F.WT(j) = vcg::TexCoord2f(UV.X, UV.Y);
+                }
+                F.matId = Section.MaterialIndex;
+            });
+            FaceBase += (int32)Section.NumTriangles;
+        }
+    }
+
+    // Rebuilds a render LOD from the (compacted) reduced mesh through IMeshUtilities, the same
+    // path the importer takes: one wedge per corner, the simplifier's vertex normals as TangentZ,
+    // tangents computed by the builder.
+    static bool BuildSkeletalLODModel(MyMesh &InVCGMesh, const USkeletalMesh &SkeletalMesh,
+                                      const FSkeletalMeshLODInfo &LODInfo,
+                                      FSkeletalMeshLODModel &OutModel) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.BuildSkeletalLODModel");
+        vcg::tri::Allocator<MyMesh>::CompactEveryVector(InVCGMesh);
+        SkinHandle Skin = vcg::tri::Allocator<MyMesh>::FindPerVertexAttribute<SkinWeights>(
+            InVCGMesh, SkinWeights::kAttribute);
+        MyMesh::PerVertexAttributeHandle<int32> SourcePoint =
+            vcg::tri::Allocator<MyMesh>::FindPerVertexAttribute<int32>(InVCGMesh,
+                                                                       SourcePointAttribute);
+
+        const int32 NumVerts = (int32)InVCGMesh.vert.size();
+        const int32 NumFaces = (int32)InVCGMesh.face.size();
+        TArray<FVector3f> Points;
+        TArray<int32> PointToOriginalMap;
+        Points.SetNumUninitialized(NumVerts);
+        PointToOriginalMap.SetNumUninitialized(NumVerts);
+        ParallelFor(NumVerts, [&](int32 i) {
+            const vcg::Point3f &P = InVCGMesh.vert[i].cP();
+            Points[i]             = FVector3f(P.X(), P.Y(), P.Z());
+            PointToOriginalMap[i] = SourcePoint[i];
+        });
+
+        TArray<SkeletalMeshImportData::FVertInfluence> Influences;
+        Influences.Reserve(NumVerts * 4);
+        for (int32 i = 0; i < NumVerts; ++i) {
+            const SkinWeights &Weights = Skin[i];
+            for (int k = 0; k < SkinWeights::kMaxInfluences && Weights.weight[k] > 0.0f; ++k) {
+                SkeletalMeshImportData::FVertInfluence &Influence =
+                    Influences.AddDefaulted_GetRef();
+                Influence.Weight    = Weights.weight[k];
+                Influence.VertIndex = (uint32)i;
+                Influence.BoneIndex = (FBoneIndexType)Weights.bone[k];
+            }
+        }
+
+        TArray<SkeletalMeshImportData::FMeshWedge> Wedges;
+        TArray<SkeletalMeshImportData::FMeshFace> Faces;
+        Wedges.SetNumZeroed(NumFaces * 3);
+        Faces.SetNumZeroed(NumFaces);
+        ParallelFor(NumFaces, [&](int32 i) {
+            const MyFace &F                         = InVCGMesh.face[i];
+            SkeletalMeshImportData::FMeshFace &Face = Faces[i];
+            for (int j = 0; j < 3; ++j) {
+                const MyVertex &V                         = *F.cV(j);
+                SkeletalMeshImportData::FMeshWedge &Wedge = Wedges[i * 3 + j];
+                Wedge.iVertex    = (uint32)vcg::tri::Index(InVCGMesh, F.cV(j));
+                Wedge.UVs[0]     = FVector2f(F.cWT(j).U(), F.cWT(j).V());
+                Wedge.Color      = FColor(V.cC()[0], V.cC()[1], V.cC()[2], V.cC()[3]);
+                Face.iWedge[j]   = (uint32)(i * 3 + j);
+                Face.TangentZ[j] = FVector3f(V.cN().X(), V.cN().Y(), V.cN().Z());
+            }
+            Face.MeshMaterialIndex = (uint16)F.matId;
+            Face.SmoothingGroups   = 1;
+        });
+
+        IMeshUtilities &MeshUtilities =
+            FModuleManager::Get().LoadModuleChecked<IMeshUtilities>("MeshUtilities");
+        IMeshUtilities::MeshBuildOptions Options;
+        Options.FillOptions(LODInfo.BuildSettings);
+        Options.bComputeNormals  = false;
+        Options.bComputeTangents = true;
+        TArray<FText> WarningMessages;
+        TArray<FName> WarningNames;
+        const bool bBuilt = MeshUtilities.BuildSkeletalMesh(
+            OutModel, SkeletalMesh.GetPathName(), SkeletalMesh.GetRefSkeleton(), Influences, Wedges,
+            Faces, Points, PointToOriginalMap, Options, &WarningMessages, &WarningNames);
+        for (const FText &Message : WarningMessages) {
+            UE_LOG(LogVCGMeshReduction, Warning, TEXT("BuildSkeletalLODModel - %s"),
+                   *Message.ToString());
+        }
+        return bBuilt;
+    }
+
+    // Triangle target of a skeletal LOD. Vertex criteria are converted with the usual two
+    // triangles per vertex of a closed mesh, since the simplifier counts faces.
+    static int32 SkeletalTargetFaceCount(const FSkeletalMeshOptimizationSettings &Settings,
+                                         int32 NumFaces) {
+        const int64 ByTriangles = (int64)(NumFaces * Settings.NumOfTrianglesPercentage);
+        const int64 ByVerts     = (int64)(NumFaces * Settings.NumOfVertPercentage);
+        int64 Target            = NumFaces;
+        switch (Settings.TerminationCriterion.GetValue()) {
+        case SMTC_NumOfTriangles:
+            Target = ByTriangles;
+            break;
+        case SMTC_NumOfVerts:
+            Target = ByVerts;
+            break;
+        case SMTC_TriangleOrVert:
+            Target = FMath::Min(ByTriangles, ByVerts);
+            break;
+        case SMTC_AbsNumOfTriangles:
+            Target = Settings.MaxNumOfTriangles;
+            break;
+        case SMTC_AbsNumOfVerts:
+            Target = 2 * (int64)Settings.MaxNumOfVerts;
+            break;
+        case SMTC_AbsTriangleOrVert:
+            Target =
+                FMath::Min<int64>(Settings.MaxNumOfTriangles, 2 * (int64)Settings.MaxNumOfVerts);
+            break;
+        default:
+            break;
+        }
+        return (int32)FMath::Clamp<int64>(Target, 0, NumFaces);
+    }
+
+    static Simplifier::Params MakeParams(const FSkeletalMeshOptimizationSettings &Settings,
+                                         const MyMesh &m) {
+        Simplifier::Params params;
+        params.targetFaceCount   = SkeletalTargetFaceCount(Settings, m.fn);
+        params.extraTCoordWeight = ImportanceToWeight((uint8)Settings.TextureImportance);
+        params.boundaryWeight    = ImportanceToWeight((uint8)Settings.SilhouetteImportance);
+        params.skinWeight        = ImportanceToWeight((uint8)Settings.SkinningImportance);
+        if ((uint8)Settings.ShadingImportance >= 4) {
+            params.normalCheck = true;
+        }
+        params.maxInfluences =
+            FMath::Clamp(Settings.MaxBonesPerVertex, 1, SkinWeights::kMaxInfluences);
+
+        // MaxDeviationPercentage is relative to the bounding sphere radius.
+        if (Settings.MaxDeviationPercentage > 0.0f) {
+            vcg::Box3f Box;
+            for (const MyVertex &V : m.vert) {
+                if (!V.IsD()) {
+                    Box.Add(V.cP());
+                }
+            }
+            params.maxError = Settings.MaxDeviationPercentage * Box.Diag() * 0.5;
+        }
+        return params;
+    }
+#endif
+
     virtual bool ReduceSkeletalMesh(class USkeletalMesh *SkeletalMesh, int32 LODIndex,
                                     const class ITargetPlatform *TargetPlatform) override {
+#if WITH_EDITOR
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ReduceSkeletalMesh");
+        if (!SkeletalMesh) {
+            return false;
+        }
+        FSkeletalMeshModel *ImportedModel = SkeletalMesh->GetImportedModel();
+        FSkeletalMeshLODInfo *LODInfo     = SkeletalMesh->GetLODInfo(LODIndex);
+        if (!ImportedModel || !LODInfo) {
+            return false;
+        }
+        const FSkeletalMeshOptimizationSettings &Settings = LODInfo->ReductionSettings;
+
+        // Same clamp as the engine: a LOD is reduced from itself or a finer one.
+        const int32 BaseLOD = FMath::Clamp(Settings.BaseLOD, 0, LODIndex);
+        if (!ImportedModel->LODModels.IsValidIndex(BaseLOD)) {
+            return false;
+        }
+        UE_LOG(LogVCGMeshReduction, Log, TEXT("ReduceSkeletalMesh - %s LOD %d from LOD %d"),
+               *SkeletalMesh->GetName(), LODIndex, BaseLOD);
+
+        // The base LOD is fully read before LODModels[LODIndex] is replaced, so BaseLOD may be
+        // LODIndex itself.
+        const FReferenceSkeleton &RefSkeleton = SkeletalMesh->GetRefSkeleton();
+        const TArray<int32> BoneRemap         = MakeBoneRemap(RefSkeleton, *LODInfo);
+        MyMesh m;
+        ConvertToVCGMesh(ImportedModel->LODModels[BaseLOD], BoneRemap,
+                         FMath::Clamp(Settings.MaxBonesPerVertex, 1, SkinWeights::kMaxInfluences),
+                         m);
+        Simplifier::Clean(m, 0.0);
+
+        const Simplifier::Params params = MakeParams(Settings, m);
+        if (!SimplifyWithProgress(m, params)) {
+            UE_LOG(LogVCGMeshReduction, Warning,
+                   TEXT("ReduceSkeletalMesh - Cancelled at %d faces, keeping the partial result"),
+                   m.fn);
+        }
+
+        FSkeletalMeshLODModel *NewModel = new FSkeletalMeshLODModel();
+        if (!BuildSkeletalLODModel(m, *SkeletalMesh, *LODInfo, *NewModel)) {
+            delete NewModel;
+            return false;
+        }
+        TMap<FBoneIndexType, FBoneIndexType> BonesToRemove;
+        for (int32 BoneIndex = 0; BoneIndex < BoneRemap.Num(); ++BoneIndex) {
+            if (BoneRemap[BoneIndex] != BoneIndex) {
+                BonesToRemove.Add((FBoneIndexType)BoneIndex,
+                                  (FBoneIndexType)BoneRemap[BoneIndex]);
+            }
+        }
+        USkeletalMesh::CalculateRequiredBones(*NewModel, RefSkeleton, &BonesToRemove);
+
+        if (ImportedModel->LODModels.IsValidIndex(LODIndex)) {
+            ImportedModel->LODModels.RemoveAt(LODIndex);
+            ImportedModel->LODModels.Insert(NewModel, LODIndex);
+        } else {
+            check(LODIndex == ImportedModel->LODModels.Num());
+            ImportedModel->LODModels.Add(NewModel);
+        }
+        LODInfo->bHasBeenSimplified = true;
+
+        UE_LOG(LogVCGMeshReduction, Log,
+               TEXT("ReduceSkeletalMesh - Finished. Vertices: %d, Triangles: %d, Bones pruned: %d"),
+               NewModel->NumVertices, m.fn, BonesToRemove.Num());
+        return true;
+#else
         return false;
+#endif
     }
 
     virtual const FString &GetVersionString() const override {
@@ -327,22 +868,320 @@ class FVCGMeshReduction : public IMeshReduction {
 
     virtual bool IsReductionActive(
         const struct FSkeletalMeshOptimizationSettings &ReductionSettings) const override {
-        return false;
+        return IsReductionActive(ReductionSettings, MAX_uint32, MAX_uint32);
     }
 
     virtual bool
     IsReductionActive(const struct FSkeletalMeshOptimizationSettings &ReductionSettings,
                       uint32 NumVertices, uint32 NumTriangles) const override {
-        return false;
+        if (ReductionSettings.MaxDeviationPercentage > 0.0f) {
+            return true;
+        }
+        const bool bTriangles = ReductionSettings.NumOfTrianglesPercentage < 1.0f;
+        const bool bVerts     = ReductionSettings.NumOfVertPercentage < 1.0f;
+        switch (ReductionSettings.TerminationCriterion.GetValue()) {
+        case SMTC_NumOfTriangles:
+            return bTriangles;
+        case SMTC_NumOfVerts:
+            return bVerts;
+        case SMTC_TriangleOrVert:
+            return bTriangles || bVerts;
+        case SMTC_AbsNumOfTriangles:
+            return ReductionSettings.MaxNumOfTriangles < NumTriangles;
+        case SMTC_AbsNumOfVerts:
+            return ReductionSettings.MaxNumOfVerts < NumVertices;
+        case SMTC_AbsTriangleOrVert:
+            return ReductionSettings.MaxNumOfTriangles < NumTriangles ||
+                   ReductionSettings.MaxNumOfVerts < NumVertices;
+        default:
+            return false;
+        }
     }
 
     static FVCGMeshReduction *Create() { return new FVCGMeshReduction(); }
 };
 
+#if WITH_EDITOR
+// HLOD proxies: every part is appended to one MyMesh in world space, parts smaller than a pixel
+// at the proxy's screen size are dropped and the result is reduced with the QEM collapse until
+// the next collapse would move the surface by more than half a pixel. The flattened input
+// materials are packed into a grid atlas, one cell per material, and the UVs of each face are
+// moved into the cell of its material, so the proxy needs a single material.
+class FVCGMeshMerging : public IMeshMerging {
+  public:
+    virtual ~FVCGMeshMerging() {}
+
+    virtual void ProxyLOD(const TArray<FMeshMergeData> &InData,
+                          const FMeshProxySettings &InProxySettings,
+                          const TArray<FFlattenMaterial> &InputMaterials,
+                          const FGuid InJobGUID) override {
+        TArray<FMergePart> Parts;
+        for (const FMeshMergeData &Data : InData) {
+            Parts.Add({&Data, FTransform::Identity});
+        }
+        BuildProxy(Parts, InProxySettings, InputMaterials, InJobGUID);
+    }
+
+    virtual void ProxyLOD(const TArray<FInstancedMeshMergeData> &InData,
+                          const FMeshProxySettings &InProxySettings,
+                          const TArray<FFlattenMaterial> &InputMaterials,
+                          const FGuid InJobGUID) override {
+        TArray<FMergePart> Parts;
+        for (const FInstancedMeshMergeData &Data : InData) {
+            for (const FTransform &Transform : Data.InstanceTransforms) {
+                Parts.Add({&Data, Transform});
+            }
+        }
+        BuildProxy(Parts, InProxySettings, InputMaterials, InJobGUID);
+    }
+
+    virtual FString GetName() override { return FString("VCGMeshMerging"); }
+
+  private:
+    // Fraction of an atlas cell on each side that UVs stay clear of, so bilinear filtering and
+    // mips do not bleed between neighbouring materials.
+    static constexpr float CellInset = 1.0f / 32.0f;
+
+    // One placement of a merge input; instanced inputs yield one part per instance. Meshes of
+    // FMeshMergeData are already in world space.
+    struct FMergePart {
+        const FMeshMergeData *Data;
+        FTransform Transform;
+    };
+
+    static FBox PartBounds(const FMergePart &Part) {
+        FStaticMeshConstAttributes Attributes(*Part.Data->RawMesh);
+        TVertexAttributesConstRef<FVector3f> Positions = Attributes.GetVertexPositions();
+        FBox Box(ForceInit);
+        for (const FVertexID VertexID : Part.Data->RawMesh->Vertices().GetElementIDs()) {
+            Box += Part.Transform.TransformPosition(FVector(Positions[VertexID]));
+        }
+        return Box;
+    }
+
+    // Appends one part. MeshMergeUtilities numbers the polygon groups of the merge inputs by
+    // the index of their flattened material; faces of other groups use material 0.
+    static void AppendPart(const FMergePart &Part, int32 NumMaterials, int32 Columns,
+                           bool bVertexColors, MyMesh &OutMesh) {
+        const FMeshDescription &InMesh = *Part.Data->RawMesh;
+        FStaticMeshConstAttributes InAttributes(InMesh);
+        TVertexAttributesConstRef<FVector3f> InPositions = InAttributes.GetVertexPositions();
+        TVertexInstanceAttributesConstRef<FVector2f> InUVs = InAttributes.GetVertexInstanceUVs();
+        TVertexInstanceAttributesConstRef<FVector4f> InColors =
+            InAttributes.GetVertexInstanceColors();
+        const TArray<FVector2D> &BakedUVs = Part.Data->NewUVs;
+        const bool bHasUVs    = InUVs.GetNumChannels() > 0;
+        const bool bHasColors = bVertexColors && InColors.GetNumElements() > 0;
+
+        TArray<FVertexID> VertexIDs;
+        TArray<int32> VertexIDToVCGIndex;
+        VertexIDToVCGIndex.Init(INDEX_NONE, InMesh.Vertices().GetArraySize());
+        const int32 VertexBase = (int32)OutMesh.vert.size();
+        for (const FVertexID VertexID : InMesh.Vertices().GetElementIDs()) {
+            VertexIDToVCGIndex[VertexID.GetValue()] = VertexBase + VertexIDs.Add(VertexID);
+        }
+        TArray<FTriangleID> TriangleIDs;
+        TriangleIDs.Reserve(InMesh.Triangles().Num());
+        for (const FTriangleID TriangleID : InMesh.Triangles().GetElementIDs()) {
+            TriangleIDs.Add(TriangleID);
+        }
+        const int32 FaceBase = (int32)OutMesh.face.size();
+        vcg::tri::Allocator<MyMesh>::AddVertices(OutMesh, VertexIDs.Num());
+        vcg::tri::Allocator<MyMesh>::AddFaces(OutMesh, TriangleIDs.Num());
+
+        ParallelFor(VertexIDs.Num(), [&](int32 Index) {
+            const FVertexID VertexID = VertexIDs[Index];
+            MyVertex &V              = OutMesh.vert[VertexBase + Index];
+
+            const FVector P = Part.Transform.TransformPosition(FVector(InPositions[VertexID]));
+            V.P()           = vcg::Point3f((float)P.X, (float)P.Y, (float)P.Z);
+            V.C()           = vcg::Color4b::White;
+            if (bHasColors) {
+                TArrayView<const FVertexInstanceID> Instances =
+                    InMesh.GetVertexVertexInstanceIDs(VertexID);
+                if (Instances.Num() > 0) {
+                    const FVector4f Color = InColors[Instances[0]];
+                    V.C() = vcg::Color4b((uint8)(Color.X * 255.f), (uint8)(Color.Y * 255.f),
+                                         (uint8)(Color.Z * 255.f), (uint8)(Color.W * 255.f));
+                }
+            }
+        });
+
+        // Mirrored instances flip the winding.
+        const bool bFlip = Part.Transform.GetDeterminant() < 0.0f;
+        ParallelFor(TriangleIDs.Num(), [&](int32 Index) {
+            const FTriangleID TriangleID = TriangleIDs[Index];
+            MyFace &F                    = OutMesh.face[FaceBase + Index];
+            const int32 Group            = InMesh.GetTrianglePolygonGroup(TriangleID).GetValue();
+            const int32 Material         = Group >= 0 && Group < NumMaterials ? Group : 0;
+            const FVector2f Cell((float)(Material % Columns), (float)(Material / Columns));
+
+            TArrayView<const FVertexInstanceID> Instances =
+                InMesh.GetTriangleVertexInstances(TriangleID);
+            for (int j = 0; j < 3; ++j) {
+                const FVertexInstanceID InstanceID = Instances[bFlip ? 2 - j : j];
+                const FVertexID VertexID           = InMesh.GetVertexInstanceVertex(InstanceID);
+
+                F.V(j) = &OutMesh.vert[VertexIDToVCGIndex[VertexID.GetValue()]];
+
+                FVector2f UV(0.5f, 0.5f);
+                if (BakedUVs.IsValidIndex(InstanceID.GetValue())) {
+                    UV = FVector2f(BakedUVs[InstanceID.GetValue()]);
+                } else if (bHasUVs) {
+                    UV = InUVs.Get(InstanceID, 0);
+                }
+                // Into the inset part of the material's atlas cell.
+                UV.X = FMath::Clamp(UV.X, 0.0f, 1.0f) * (1.0f - 2.0f * CellInset) + CellInset;
+                UV.Y = FMath::Clamp(UV.Y, 0.0f, 1.0f) * (1.0f - 2.0f * CellInset) + CellInset;
+                UV   = (Cell + UV) / (float)Columns;
+
+                F.WT(j) = vcg::TexCoord2f(UV.X, UV.Y);
+            }
+            F.matId = 0;
+        });
+    }
+
+    static FColor DefaultSample(EFlattenMaterialProperties Property) {
+        switch (Property) {
+        case EFlattenMaterialProperties::Normal:
+            return FColor(128, 128, 255);
+        case EFlattenMaterialProperties::Opacity:
+        case EFlattenMaterialProperties::OpacityMask:
+        case EFlattenMaterialProperties::AmbientOcclusion:
+            return FColor::White;
+        default:
+            return FColor::Black;
+        }
+    }
+
+    // Packs the inputs into a Columns x Columns grid per property. A cell is as large as the
+    // largest input of that property, capped so the atlas fits MaxSize; inputs are resampled
+    // (nearest) into the inset area of their cell and stretched over the inset border.
+    static void BuildMaterialAtlas(const TArray<FFlattenMaterial> &InputMaterials, int32 Columns,
+                                   FIntPoint MaxSize, FFlattenMaterial &OutMaterial) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.BuildMaterialAtlas");
+        for (int32 p = 0; p < (int32)EFlattenMaterialProperties::NumFlattenMaterialProperties;
+             ++p) {
+            const EFlattenMaterialProperties Property = (EFlattenMaterialProperties)p;
+            FIntPoint CellSize(1, 1);
+            bool bHasData = false;
+            for (const FFlattenMaterial &Input : InputMaterials) {
+                if (Input.DoesPropertyContainData(Property)) {
+                    bHasData = true;
+                    CellSize = CellSize.ComponentMax(Input.GetPropertySize(Property));
+                }
+            }
+            if (!bHasData) {
+                continue;
+            }
+            CellSize = CellSize.ComponentMin(
+                FIntPoint(FMath::Max(MaxSize.X / Columns, 1), FMath::Max(MaxSize.Y / Columns, 1)));
+            const FIntPoint AtlasSize = CellSize * Columns;
+            OutMaterial.SetPropertySize(Property, AtlasSize);
+            TArray<FColor> &Samples = OutMaterial.GetPropertySamples(Property);
+            Samples.Init(DefaultSample(Property), AtlasSize.X * AtlasSize.Y);
+
+            ParallelFor(InputMaterials.Num(), [&](int32 Index) {
+                const FFlattenMaterial &Input = InputMaterials[Index];
+                if (!Input.DoesPropertyContainData(Property)) {
+                    return;
+                }
+                const TArray<FColor> &Source = Input.GetPropertySamples(Property);
+                const FIntPoint SourceSize   = Input.IsPropertyConstant(Property)
+                                                   ? FIntPoint(1, 1)
+                                                   : Input.GetPropertySize(Property);
+                const FIntPoint Origin((Index % Columns) * CellSize.X,
+                                       (Index / Columns) * CellSize.Y);
+                auto SourceTexel = [](int32 Texel, int32 Size, int32 SourceCount) {
+                    float T = ((Texel + 0.5f) / Size - CellInset) / (1.0f - 2.0f * CellInset);
+                    return FMath::Clamp((int32)(FMath::Clamp(T, 0.0f, 1.0f) * SourceCount), 0,
+                                        SourceCount - 1);
+                };
+                for (int32 y = 0; y < CellSize.Y; ++y) {
+                    const int32 SourceRow = SourceTexel(y, CellSize.Y, SourceSize.Y) * SourceSize.X;
+                    FColor *Row           = &Samples[(Origin.Y + y) * AtlasSize.X + Origin.X];
+                    for (int32 x = 0; x < CellSize.X; ++x) {
+                        Row[x] = Source[SourceRow + SourceTexel(x, CellSize.X, SourceSize.X)];
+                    }
+                }
+            });
+        }
+        for (const FFlattenMaterial &Input : InputMaterials) {
+            OutMaterial.bTwoSided |= Input.bTwoSided;
+        }
+    }
+
+    void BuildProxy(const TArray<FMergePart> &InParts, const FMeshProxySettings &InProxySettings,
+                    const TArray<FFlattenMaterial> &InputMaterials, const FGuid InJobGUID) {
+        TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier.ProxyLOD");
+        TArray<FMergePart> Parts;
+        TArray<FBox> Bounds;
+        FBox TotalBounds(ForceInit);
+        for (const FMergePart &Part : InParts) {
+            if (Part.Data->RawMesh && !Part.Data->bIsClippingMesh) {
+                Parts.Add(Part);
+                TotalBounds += Bounds.Add_GetRef(PartBounds(Part));
+            }
+        }
+        if (Parts.Num() == 0 || !TotalBounds.IsValid) {
+            FailedDelegate.ExecuteIfBound(InJobGUID, TEXT("No geometry to merge"));
+            return;
+        }
+
+        // The proxy covers ScreenSize pixels across its bounds.
+        const double Pixel = 2.0 * TotalBounds.GetExtent().Size() /
+                             FMath::Max(InProxySettings.ScreenSize, 1);
+        const int32 NumMaterials = FMath::Max(InputMaterials.Num(), 1);
+        const int32 Columns      = FMath::CeilToInt(FMath::Sqrt((float)NumMaterials));
+
+        MyMesh m;
+        int32 Dropped = 0;
+        for (int32 i = 0; i < Parts.Num(); ++i) {
+            if (2.0 * Bounds[i].GetExtent().Size() < Pixel) {
+                ++Dropped;
+                continue;
+            }
+            AppendPart(Parts[i], NumMaterials, Columns, InProxySettings.bAllowVertexColors, m);
+        }
+        UE_LOG(LogVCGMeshReduction, Log,
+               TEXT("ProxyLOD - %d parts, %d below one pixel dropped, %d faces merged"),
+               Parts.Num(), Dropped, m.fn);
+        Simplifier::Clean(m);
+
+        // Separate parts have open borders everywhere, so they are weighted instead of locked.
+        Simplifier::Params Params;
+        Params.ratio            = 0.0f;
+        Params.maxError         = 0.5 * Pixel;
+        Params.preserveBoundary = false;
+        FVCGMeshReduction::SimplifyWithProgress(m, Params);
+
+        // One polygon group for the atlas material.
+        FMeshDescription Groups;
+        FStaticMeshAttributes(Groups).Register();
+        Groups.CreatePolygonGroup();
+        FMeshDescription OutMesh;
+        FVCGMeshReduction::ConvertToFMeshDescription(m, Groups, OutMesh);
+        FStaticMeshOperations::ComputeTriangleTangentsAndNormals(OutMesh);
+
+        FFlattenMaterial OutMaterial;
+        BuildMaterialAtlas(InputMaterials, Columns, InProxySettings.MaterialSettings.TextureSize,
+                           OutMaterial);
+        UE_LOG(LogVCGMeshReduction, Log, TEXT("ProxyLOD - Finished. Triangles: %d, atlas %dx%d"),
+               OutMesh.Triangles().Num(), Columns, Columns);
+        CompleteDelegate.ExecuteIfBound(OutMesh, OutMaterial, InJobGUID);
+    }
+};
+
+TUniquePtr<FVCGMeshMerging> GVCGMeshMerging;
+#endif
+
 TUniquePtr<FVCGMeshReduction> GVCGMeshReduction;
 
 void FVCGMeshReductionModule::StartupModule() {
     GVCGMeshReduction.Reset(FVCGMeshReduction::Create());
+#if WITH_EDITOR
+    GVCGMeshMerging = MakeUnique<FVCGMeshMerging>();
+#endif
     IModularFeatures::Get().RegisterModularFeature(IMeshReductionModule::GetModularFeatureName(),
                                                    this);
 }
@@ -352,18 +1191,39 @@ void FVCGMeshReductionModule::ShutdownModule() {
                                                      this);
 
     GVCGMeshReduction = nullptr;
+#if WITH_EDITOR
+    GVCGMeshMerging = nullptr;
+#endif
 }
 
 IMeshReduction *FVCGMeshReductionModule::GetStaticMeshReductionInterface() {
     return GVCGMeshReduction.Get();
 }
 
-IMeshReduction *FVCGMeshReductionModule::GetSkeletalMeshReductionInterface() { return nullptr; }
+IMeshReduction *FVCGMeshReductionModule::GetSkeletalMeshReductionInterface() {
+    return GVCGMeshReduction.Get();
+}
 
-IMeshMerging *FVCGMeshReductionModule::GetMeshMergingInterface() { return nullptr; }
+IMeshMerging *FVCGMeshReductionModule::GetMeshMergingInterface() {
+#if WITH_EDITOR
+    return GVCGMeshMerging.Get();
+#else
+    return nullptr;
+#endif
+}
 
+// Proxies are built synchronously, so the distributed interface is the same one.
 class IMeshMerging *FVCGMeshReductionModule::GetDistributedMeshMergingInterface() {
-    return nullptr;
+    return GetMeshMergingInterface();
 }
 
 FString FVCGMeshReductionModule::GetName() { return FString("VCGMeshReduction"); }
+
+
+void VCGReduceMeshDescriptionChain(const FMeshDescription &InMesh,
+                                   const TArray<FMeshReductionSettings> &Settings,
+                                   TArray<FMeshDescription> &OutReducedMeshes) {
+    FVCGMeshReduction::ReduceMeshDescriptionChain(OutReducedMeshes, InMesh, Settings);
+}
+
+void VCGCancelMeshReductions() { ++GVCGReductionGeneration; }
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include "decimation_session.h"
+#include "parallel.h"
+#include "simplifier.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// --- 清理 ---
+// Simplifier::Clean in one fused pass: weld on a spatial hash grid, remap the faces, drop
+// degenerate, zero-area and duplicate faces and unreferenced vertices, then compact once.
+
+namespace {
+
+uint64_t Mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+uint64_t CellKey(int64_t x, int64_t y, int64_t z) {
+    return Mix(Mix(Mix(uint64_t(x)) ^ uint64_t(y)) ^ uint64_t(z));
+}
+
+// Grid cell of a position. With distance > 0 the cells are `distance` wide, so vertices within
+// the distance are in the same or a neighbouring cell; with distance == 0 the cell is the exact
+// position.
+void Cell(const vcg::Point3f &p, double distance, int64_t cell[3]) {
+    for (int k = 0; k < 3; ++k) {
+        if (distance > 0) {
+            cell[k] = int64_t(std::floor(double(p[k]) / distance));
+        } else {
+            float c = p[k] == 0.0f ? 0.0f : p[k]; // -0 and +0 weld
+            uint32_t bits;
+            memcpy(&bits, &c, sizeof(bits));
+            cell[k] = bits;
+        }
+    }
+}
+
+// Open addressing table from cell key to the run of sorted entries in that cell.
+class CellTable {
+  public:
+    struct Run {
+        uint64_t key;
+        uint32_t begin, end; // end == 0: empty slot
+    };
+
+    explicit CellTable(size_t runs) {
+        size_t capacity = 16;
+        while (capacity < runs * 2)
+            capacity *= 2;
+        slots.assign(capacity, Run{0, 0, 0});
+        mask = capacity - 1;
+    }
+
+    void Insert(uint64_t key, uint32_t begin, uint32_t end) {
+        size_t i = size_t(key) & mask;
+        while (slots[i].end != 0)
+            i = (i + 1) & mask;
+        slots[i] = Run{key, begin, end};
+    }
+
+    const Run *Find(uint64_t key) const {
+        for (size_t i = size_t(key) & mask; slots[i].end != 0; i = (i + 1) & mask) {
+            if (slots[i].key == key)
+                return &slots[i];
+        }
+        return nullptr;
+    }
+
+  private:
+    std::vector<Run> slots;
+    size_t mask;
+};
+
+// Maps every vertex to the vertex it is welded to (never a higher index). Each vertex first
+// picks the lowest-index vertex within `distance` in the 27 cells around it; following those
+// links then merges chains into a single representative. `position(i)` is the position of
+// vertex i, `live(i)` false for vertices that take no part.
+template <class Position, class Live>
+std::vector<uint32_t> WeldMap(size_t vn, Position position, Live live, double distance,
+                              int threads) {
+    struct Entry {
+        uint64_t key;
+        uint32_t vertex;
+    };
+    std::vector<Entry> entries(vn);
+    ParallelForRange(vn, threads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            int64_t c[3];
+            Cell(position(i), distance, c);
+            // Dead vertices go to a key of their own and are never looked up.
+            entries[i] = {live(i) ? CellKey(c[0], c[1], c[2]) : Mix(i), uint32_t(i)};
+        }
+    });
+    ParallelSort(entries.begin(), entries.end(), threads, [](const Entry &a, const Entry &b) {
+        return a.key != b.key ? a.key < b.key : a.vertex < b.vertex;
+    });
+
+    size_t runs = 0;
+    for (size_t i = 0; i < vn; ++i)
+        runs += (i == 0 || entries[i].key != entries[i - 1].key);
+    CellTable table(runs);
+    for (size_t begin = 0; begin < vn;) {
+        size_t end = begin + 1;
+        while (end < vn && entries[end].key == entries[begin].key)
+            ++end;
+        table.Insert(entries[begin].key, uint32_t(begin), uint32_t(end));
+        begin = end;
+    }
+
+    std::vector<uint32_t> rep(vn);
+    const int reach     = distance > 0 ? 1 : 0;
+    const double distSq = distance * distance;
+    ParallelForRange(vn, threads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            rep[i] = uint32_t(i);
+            if (!live(i))
+                continue;
+            const vcg::Point3f p = position(i);
+            int64_t c[3];
+            Cell(p, distance, c);
+            for (int dx = -reach; dx <= reach; ++dx) {
+                for (int dy = -reach; dy <= reach; ++dy) {
+                    for (int dz = -reach; dz <= reach; ++dz) {
+                        const CellTable::Run *run =
+                            table.Find(CellKey(c[0] + dx, c[1] + dy, c[2] + dz));
+                        if (!run)
+                            continue;
+                        // Entries of a cell are sorted by index: stop at the first match or once
+                        // they cannot improve on the current representative.
+                        for (uint32_t e = run->begin;
+                             e < run->end && entries[e].vertex < rep[i]; ++e) {
+                            const uint32_t w = entries[e].vertex;
+                            if (live(w) && double((position(w) - p).SquaredNorm()) <= distSq) {
+                                rep[i] = entries[e].vertex;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    // rep[i] <= i, so one pass in index order resolves chains.
+    for (size_t i = 0; i < vn; ++i)
+        rep[i] = rep[rep[i]];
+    return rep;
+}
+
+// Faces that repeat a lower-index face with the same three vertices in any order. `live(i)`
+// is false for faces that take no part, `corner(i, j)` is vertex j of face i.
+template <class Live, class Corner>
+std::vector<uint32_t> DuplicateFaces(size_t faceNum, Live live, Corner corner, int threads) {
+    struct FaceKey {
+        uint32_t v[3];
+        uint32_t face;
+    };
+    std::vector<FaceKey> keys(faceNum);
+    ParallelForRange(faceNum, threads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            FaceKey &k = keys[i];
+            k.face     = uint32_t(i);
+            if (!live(i)) {
+                k.v[0] = k.v[1] = k.v[2] = UINT32_MAX;
+                continue;
+            }
+            for (int j = 0; j < 3; ++j)
+                k.v[j] = corner(i, j);
+            std::sort(k.v, k.v + 3);
+        }
+    });
+    ParallelSort(keys.begin(), keys.end(), threads, [](const FaceKey &a, const FaceKey &b) {
+        if (a.v[0] != b.v[0])
+            return a.v[0] < b.v[0];
+        if (a.v[1] != b.v[1])
+            return a.v[1] < b.v[1];
+        if (a.v[2] != b.v[2])
+            return a.v[2] < b.v[2];
+        return a.face < b.face;
+    });
+    std::vector<uint32_t> duplicates;
+    for (size_t i = 1; i < keys.size() && keys[i].v[0] != UINT32_MAX; ++i) {
+        if (std::equal(keys[i].v, keys[i].v + 3, keys[i - 1].v))
+            duplicates.push_back(keys[i].face);
+    }
+    return duplicates;
+}
+
+} // namespace
+
+void Simplifier::Clean(MyMesh &m, double weldDistance, int threads) {
+    VCG_TRACE_SCOPE("Clean");
+    threads              = ResolveThreadCount(threads);
+    const size_t vn      = m.vert.size();
+    const size_t faceNum = m.face.size();
+
+    if (weldDistance < 0) {
+        vcg::Box3f box;
+        for (const MyVertex &v : m.vert) {
+            if (!v.IsD())
+                box.Add(v.cP());
+        }
+        weldDistance = box.IsNull() ? 0.0 : 1e-6 * double(box.Diag());
+    }
+    std::vector<uint32_t> rep = WeldMap(
+        vn, [&](size_t i) { return m.vert[i].cP(); }, [&](size_t i) { return !m.vert[i].IsD(); },
+        weldDistance, threads);
+
+    // Remap the faces to the welded vertices and drop the ones that collapsed.
+    std::vector<int> deletedFaces(threads, 0);
+    ParallelForRange(faceNum, threads, [&](size_t begin, size_t end, int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            MyFace &f = m.face[i];
+            if (f.IsD())
+                continue;
+            for (int j = 0; j < 3; ++j)
+                f.V(j) = &m.vert[rep[f.V(j) - &m.vert[0]]];
+            bool degenerate = f.V(0) == f.V(1) || f.V(1) == f.V(2) || f.V(2) == f.V(0) ||
+                              ((f.P(1) - f.P(0)) ^ (f.P(2) - f.P(0))).SquaredNorm() == 0.0f;
+            if (degenerate) {
+                f.SetD();
+                ++deletedFaces[thread];
+            }
+        }
+    });
+
+    // Duplicate faces (same three vertices in any order): keep the lowest index.
+    std::vector<uint32_t> duplicates = DuplicateFaces(
+        faceNum, [&](size_t i) { return !m.face[i].IsD(); },
+        [&](size_t i, int j) { return uint32_t(m.face[i].cV(j) - &m.vert[0]); }, threads);
+    for (uint32_t f : duplicates)
+        m.face[f].SetD();
+    deletedFaces[0] += int(duplicates.size());
+
+    // Unreferenced vertices, including the ones welded into another.
+    std::unique_ptr<std::atomic<uint8_t>[]> used(new std::atomic<uint8_t>[vn]());
+    ParallelForRange(faceNum, threads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            const MyFace &f = m.face[i];
+            if (f.IsD())
+                continue;
+            for (int j = 0; j < 3; ++j)
+                used[f.cV(j) - &m.vert[0]].store(1, std::memory_order_relaxed);
+        }
+    });
+    std::vector<int> deletedVerts(threads, 0);
+    ParallelForRange(vn, threads, [&](size_t begin, size_t end, int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!m.vert[i].IsD() && !used[i].load(std::memory_order_relaxed)) {
+                m.vert[i].SetD();
+                ++deletedVerts[thread];
+            }
+        }
+    });
+
+    for (int t = 0; t < threads; ++t) {
+        m.fn -= deletedFaces[t];
+        m.vn -= deletedVerts[t];
+    }
+    vcg::tri::Allocator<MyMesh>::CompactEveryVector(m);
+}
+
+void Simplifier::Clean(CompactMesh &m, double weldDistance, int threads) {
+    VCG_TRACE_SCOPE("CleanCompact");
+    threads              = ResolveThreadCount(threads);
+    const size_t vn      = m.VertexCount();
+    const size_t faceNum = m.FaceCount();
+    auto position        = [&](size_t i) {
+        const float *p = &m.positions[i * 3];
+        return vcg::Point3f(p[0], p[1], p[2]);
+    };
+
+    if (weldDistance < 0) {
+        vcg::Box3f box;
+        for (size_t i = 0; i < vn; ++i)
+            box.Add(position(i));
+        weldDistance = box.IsNull() ? 0.0 : 1e-6 * double(box.Diag());
+    }
+    std::vector<uint32_t> rep =
+        WeldMap(vn, position, [](size_t) { return true; }, weldDistance, threads);
+
+    std::vector<uint8_t> keep(faceNum);
+    ParallelForRange(faceNum, threads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t *v = &m.indices[i * 3];
+            for (int j = 0; j < 3; ++j)
+                v[j] = rep[v[j]];
+            const vcg::Point3f p0 = position(v[0]);
+
+            keep[i] = v[0] != v[1] && v[1] != v[2] && v[2] != v[0] &&
+                      ((position(v[1]) - p0) ^ (position(v[2]) - p0)).SquaredNorm() != 0.0f;
+        }
+    });
+    std::vector<uint32_t> duplicates = DuplicateFaces(
+        faceNum, [&](size_t i) { return keep[i] != 0; },
+        [&](size_t i, int j) { return m.indices[i * 3 + j]; }, threads);
+    for (uint32_t f : duplicates)
+        keep[f] = 0;
+    m.Compact(keep);
+}
\ No newline at end of file
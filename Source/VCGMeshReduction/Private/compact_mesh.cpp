@@ -0,0 +1,127 @@
+#include "compact_mesh.h"
+#include <algorithm>
+#include <vcg/complex/algorithms/update/bounding.h>
+#include <vcg/complex/algorithms/update/normal.h>
+
+void CompactMesh::Clear() {
+    positions.clear();
+    colors.clear();
+    indices.clear();
+    uvs.clear();
+    matIds.clear();
+}
+
+void CompactMesh::Resize(size_t vertexCount, size_t faceCount) {
+    positions.resize(vertexCount * 3, 0.0f);
+    colors.resize(vertexCount, 0xFFFFFFFFu);
+    indices.resize(faceCount * 3, 0);
+    uvs.resize(faceCount * 6, 0.0f);
+    matIds.resize(faceCount, 0);
+}
+
+size_t CompactMesh::MemoryBytes() const {
+    return positions.capacity() * sizeof(float) + colors.capacity() * sizeof(uint32_t) +
+           indices.capacity() * sizeof(uint32_t) + uvs.capacity() * sizeof(float) +
+           matIds.capacity() * sizeof(int32_t);
+}
+
+void CompactMesh::Compact(const std::vector<uint8_t> &keepFace) {
+    // New indices never exceed old ones, so both passes compact in place.
+    const size_t vn = VertexCount();
+    const size_t fn = FaceCount();
+    std::vector<uint32_t> remap(vn, UINT32_MAX);
+    size_t faces = 0;
+    for (size_t f = 0; f < fn; ++f) {
+        if (!keepFace[f])
+            continue;
+        for (int j = 0; j < 3; ++j) {
+            uint32_t v             = indices[f * 3 + j];
+            indices[faces * 3 + j] = v;
+            remap[v]               = 0;
+        }
+        std::copy(&uvs[f * 6], &uvs[f * 6] + 6, &uvs[faces * 6]);
+        matIds[faces++] = matIds[f];
+    }
+    uint32_t vertices = 0;
+    for (size_t v = 0; v < vn; ++v) {
+        if (remap[v] == UINT32_MAX)
+            continue;
+        remap[v] = vertices;
+        std::copy(&positions[v * 3], &positions[v * 3] + 3, &positions[size_t(vertices) * 3]);
+        colors[vertices++] = colors[v];
+    }
+    for (size_t i = 0; i < faces * 3; ++i)
+        indices[i] = remap[indices[i]];
+
+    Resize(vertices, faces);
+    positions.shrink_to_fit();
+    colors.shrink_to_fit();
+    indices.shrink_to_fit();
+    uvs.shrink_to_fit();
+    matIds.shrink_to_fit();
+}
+
+void ToCompactMesh(const MyMesh &src, CompactMesh &dst) {
+    std::vector<uint32_t> remap(src.vert.size(), UINT32_MAX);
+    uint32_t vn = 0;
+    for (size_t i = 0; i < src.vert.size(); ++i) {
+        if (!src.vert[i].IsD())
+            remap[i] = vn++;
+    }
+
+    dst.Clear();
+    dst.Resize(vn, size_t(src.fn));
+    for (size_t i = 0; i < src.vert.size(); ++i) {
+        if (remap[i] == UINT32_MAX)
+            continue;
+        const MyVertex &v = src.vert[i];
+        float *p          = &dst.positions[size_t(remap[i]) * 3];
+        for (int k = 0; k < 3; ++k)
+            p[k] = v.cP()[k];
+        dst.colors[remap[i]] = CompactMesh::PackColor(v.cC());
+    }
+    size_t fi = 0;
+    for (const MyFace &f : src.face) {
+        if (f.IsD())
+            continue;
+        for (int j = 0; j < 3; ++j) {
+            dst.indices[fi * 3 + j]     = remap[f.cV(j) - &src.vert[0]];
+            dst.uvs[fi * 6 + j * 2]     = f.cWT(j).U();
+            dst.uvs[fi * 6 + j * 2 + 1] = f.cWT(j).V();
+        }
+        dst.matIds[fi++] = f.matId;
+    }
+}
+
+void FromCompactMesh(const CompactMesh &src, MyMesh &dst) {
+    dst.Clear();
+    const size_t vn = src.VertexCount();
+    const size_t fn = src.FaceCount();
+    if (vn > 0)
+        vcg::tri::Allocator<MyMesh>::AddVertices(dst, vn);
+    if (fn > 0)
+        vcg::tri::Allocator<MyMesh>::AddFaces(dst, fn);
+
+    for (size_t i = 0; i < vn; ++i) {
+        const float *p  = &src.positions[i * 3];
+        dst.vert[i].P() = vcg::Point3f(p[0], p[1], p[2]);
+        dst.vert[i].C() = CompactMesh::UnpackColor(src.colors[i]);
+    }
+    for (size_t i = 0; i < fn; ++i) {
+        MyFace &f = dst.face[i];
+        for (int j = 0; j < 3; ++j) {
+            f.V(j)      = &dst.vert[src.indices[i * 3 + j]];
+            f.WT(j).U() = src.uvs[i * 6 + j * 2];
+            f.WT(j).V() = src.uvs[i * 6 + j * 2 + 1];
+            f.WT(j).N() = 0;
+        }
+        f.matId = src.matIds[i];
+    }
+
+    vcg::tri::UpdateBounding<MyMesh>::Box(dst);
+    if (dst.fn > 0) {
+        vcg::tri::UpdateNormal<MyMesh>::PerFaceNormalized(dst);
+        vcg::tri::UpdateNormal<MyMesh>::PerVertexAngleWeighted(dst);
+        vcg::tri::UpdateNormal<MyMesh>::NormalizePerVertex(dst);
+    }
+}
\ No newline at end of file
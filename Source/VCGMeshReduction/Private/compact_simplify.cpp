@@ -0,0 +1,559 @@
+#include "compact_mesh.h"
+#include "decimation_session.h"
+#include "parallel.h"
+#include "quadric_kernels.h"
+#include "simplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// --- 紧凑网格简化 ---
+// Simplifier::Simplify on a CompactMesh: quadric error half-edge collapses driven by a binary
+// heap, with the vertex-to-face adjacency held as one flat array instead of per-element
+// pointers. A half-edge collapse moves vertex `from` onto vertex `to`, so no new positions or
+// UVs are invented: every corner keeps an existing wedge UV, which is what makes UV seams safe
+// without the per-wedge quadrics of TriEdgeCollapseQuadricTex.
+
+namespace {
+
+const uint32_t kNone = UINT32_MAX;
+
+// Symmetric plane quadric, error(p) = p'Ap + 2b'p + c, in float. Positions are normalized to
+// the unit cube before they reach it, which keeps float precise enough for collapse ordering.
+// The coefficients are laid out as QuadricErrorBatch reads them.
+struct Quadric {
+    float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    float b0 = 0, b1 = 0, b2 = 0, c = 0;
+
+    // Plane n.p + d = 0 with unit normal n, weighted by w.
+    void AddPlane(const float n[3], float d, float w) {
+        a00 += w * n[0] * n[0];
+        a11 += w * n[1] * n[1];
+        a22 += w * n[2] * n[2];
+        a01 += w * n[0] * n[1];
+        a02 += w * n[0] * n[2];
+        a12 += w * n[1] * n[2];
+        b0 += w * n[0] * d;
+        b1 += w * n[1] * d;
+        b2 += w * n[2] * d;
+        c += w * d * d;
+    }
+
+    void Add(const Quadric &q) {
+        a00 += q.a00;
+        a11 += q.a11;
+        a22 += q.a22;
+        a01 += q.a01;
+        a02 += q.a02;
+        a12 += q.a12;
+        b0 += q.b0;
+        b1 += q.b1;
+        b2 += q.b2;
+        c += q.c;
+    }
+};
+static_assert(sizeof(Quadric) == 10 * sizeof(float), "QuadricErrorBatch layout");
+
+void Cross(const float a[3], const float b[3], const float c[3], float n[3]) {
+    const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+float Dot(const float a[3], const float b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+bool Normalize(float n[3]) {
+    float len = std::sqrt(Dot(n, n));
+    if (len <= 0.0f)
+        return false;
+    for (int k = 0; k < 3; ++k)
+        n[k] /= len;
+    return true;
+}
+
+// One decimation run over a CompactMesh. The working set is the mesh plus, per vertex, a
+// quadric, the adjacency offsets, the merge chain, a version and flags (57 bytes), per face
+// three adjacency entries (12 bytes) and the heap, about 1.5 candidates of 20 bytes per face.
+class CompactCollapser {
+  public:
+    CompactCollapser(CompactMesh &m, const Simplifier::Params &params, int threads);
+
+    void RunTo(size_t targetFaces);
+    // Removes dead faces and unreferenced vertices from the mesh and releases the adjacency.
+    void Finalize();
+
+  private:
+    // Collapse of `from` onto `to`; the versions tell whether either endpoint changed since.
+    struct Candidate {
+        float cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+    };
+
+    // Collapse directions costed together by one QuadricErrorBatch call. `paired` marks an
+    // entry whose edge continues with the reverse direction in the next entry.
+    struct CostBatch {
+        std::vector<uint32_t> from, to;
+        std::vector<uint8_t> paired;
+        std::vector<float> x, y, z, cost;
+
+        size_t Size() const { return from.size(); }
+    };
+
+    enum : uint8_t { kBorder = 1, kLocked = 2, kRemoved = 4 };
+
+    static bool Cheaper(const Candidate &x, const Candidate &y) { return x.cost > y.cost; }
+
+    const uint32_t *Face(uint32_t f) const { return &m.indices[size_t(f) * 3]; }
+    bool Dead(uint32_t f) const {
+        const uint32_t *v = Face(f);
+        return v[0] == v[1] || v[1] == v[2] || v[2] == v[0];
+    }
+    int Corner(uint32_t f, uint32_t v) const {
+        const uint32_t *i = Face(f);
+        return i[0] == v ? 0 : i[1] == v ? 1 : i[2] == v ? 2 : -1;
+    }
+    void Unit(uint32_t v, float p[3]) const {
+        for (int k = 0; k < 3; ++k)
+            p[k] = (m.positions[size_t(v) * 3 + k] - origin[k]) * invScale;
+    }
+
+    // Calls fn(face) for every live face around `v`, following the chain of the vertices merged
+    // into it since the adjacency was built.
+    template <class Fn> void ForEachFace(uint32_t v, Fn fn) const {
+        for (uint32_t u = v; u != kNone; u = chainNext[u]) {
+            for (uint32_t k = firstFace[u]; k < firstFace[u + 1]; ++k) {
+                if (!Dead(adjacency[k]))
+                    fn(adjacency[k]);
+            }
+        }
+    }
+
+    void BuildAdjacency();
+    void InitQuadrics();
+    void InitHeap();
+    bool BorderEdge(uint32_t a, uint32_t b) const;
+    bool Removable(uint32_t from, bool borderEdge) const {
+        return !(flags[from] & kLocked) && (!(flags[from] & kBorder) || borderEdge);
+    }
+    const float *Coefficients() const { return reinterpret_cast<const float *>(quadrics.data()); }
+    // Sum of the endpoint quadric errors at `to`.
+    float Cost(uint32_t from, uint32_t to) const {
+        float p[3], cost;
+        Unit(to, p);
+        QuadricErrorBatch(Coefficients(), quadrics.size(), &from, &to, &p[0], &p[1], &p[2], 1,
+                          &cost);
+        return cost;
+    }
+    // Queues the allowed directions of edge a-b; none if neither endpoint may move.
+    void Queue(uint32_t a, uint32_t b, CostBatch &batch) const;
+    // Costs the queued directions, calls emit(candidate) with the cheaper one of every edge and
+    // empties the batch.
+    template <class Emit> void Score(CostBatch &batch, Emit emit) const;
+    void Neighbours(uint32_t v, uint32_t skip, std::vector<uint32_t> &out) const;
+    bool Collapse(uint32_t from, uint32_t to, float cost);
+    void Push(const Candidate &c) {
+        heap.push_back(c);
+        std::push_heap(heap.begin(), heap.end(), Cheaper);
+        counters.heapHighWater = std::max<uint64_t>(counters.heapHighWater, heap.size());
+    }
+
+    CompactMesh &m;
+    Simplifier::Stats *stats;
+    const int threads;
+    const bool preserveBoundary, preserveTopology;
+    const float boundaryWeight;
+    float maxErrorSq; // in unit cube space, 0 = off
+    float origin[3];
+    float scale, invScale;
+
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> version;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> firstFace; // CSR offsets into adjacency, vertexCount + 1
+    std::vector<uint32_t> adjacency; // faces of each vertex at the last rebuild
+    std::vector<uint32_t> chainNext; // vertices merged into a vertex, kNone terminated
+    std::vector<uint32_t> chainTail;
+    std::vector<Candidate> heap;
+    size_t liveFaces    = 0;
+    size_t facesAtBuild = 0;
+    CollapseCounters counters;
+
+    // Scratch of Collapse.
+    std::vector<uint32_t> edgeFaces, movedFaces, ring0, ring1;
+    std::vector<float> newUVs;
+    CostBatch ringBatch;
+};
+
+CompactCollapser::CompactCollapser(CompactMesh &m, const Simplifier::Params &params,
+                                   int threads)
+    : m(m), stats(params.stats), threads(threads), preserveBoundary(params.preserveBoundary),
+      preserveTopology(params.preserveTopology), boundaryWeight(float(params.boundaryWeight)) {
+    const size_t vn = m.VertexCount();
+    float lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    for (size_t i = 0; i < vn; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            float p = m.positions[i * 3 + k];
+            lo[k]   = i == 0 ? p : std::min(lo[k], p);
+            hi[k]   = i == 0 ? p : std::max(hi[k], p);
+        }
+    }
+    scale = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    scale = scale > 0.0f ? scale : 1.0f;
+    for (int k = 0; k < 3; ++k)
+        origin[k] = lo[k];
+    invScale   = 1.0f / scale;
+    maxErrorSq = float(params.maxError / scale * params.maxError / scale);
+
+    version.assign(vn, 0);
+    flags.assign(vn, 0);
+    {
+        VCG_TRACE_SCOPE("CompactTopology");
+        PhaseTimer timer(stats, &Simplifier::Stats::topologyMs, "topology");
+        BuildAdjacency();
+    }
+    VCG_TRACE_SCOPE("CompactInit");
+    PhaseTimer timer(stats, &Simplifier::Stats::initMs, "init");
+    InitQuadrics();
+    InitHeap();
+}
+
+void CompactCollapser::BuildAdjacency() {
+    const size_t vn = m.VertexCount();
+    const size_t fn = m.FaceCount();
+    firstFace.assign(vn + 1, 0);
+    liveFaces = 0;
+    for (size_t f = 0; f < fn; ++f) {
+        if (Dead(uint32_t(f)))
+            continue;
+        ++liveFaces;
+        for (int j = 0; j < 3; ++j)
+            ++firstFace[Face(uint32_t(f))[j] + 1];
+    }
+    for (size_t v = 0; v < vn; ++v)
+        firstFace[v + 1] += firstFace[v];
+    adjacency.assign(liveFaces * 3, 0);
+    adjacency.shrink_to_fit();
+    std::vector<uint32_t> fill(firstFace.begin(), firstFace.end() - 1);
+    for (size_t f = 0; f < fn; ++f) {
+        if (Dead(uint32_t(f)))
+            continue;
+        for (int j = 0; j < 3; ++j)
+            adjacency[fill[Face(uint32_t(f))[j]]++] = uint32_t(f);
+    }
+    chainNext.assign(vn, kNone);
+    chainTail.resize(vn);
+    for (size_t v = 0; v < vn; ++v)
+        chainTail[v] = uint32_t(v);
+    facesAtBuild = liveFaces;
+}
+
+bool CompactCollapser::BorderEdge(uint32_t a, uint32_t b) const {
+    int shared = 0;
+    ForEachFace(a, [&](uint32_t f) { shared += Corner(f, b) >= 0; });
+    return shared == 1;
+}
+
+// Plane quadric of every face around a vertex, plus a plane through each border edge
+// perpendicular to its face so the border keeps its shape. Each vertex only writes its own
+// quadric and flags, so vertices are processed in parallel.
+void CompactCollapser::InitQuadrics() {
+    const size_t vn = m.VertexCount();
+    quadrics.assign(vn, Quadric());
+    std::vector<uint64_t> locked(threads, 0);
+    ParallelForRange(vn, threads, [&](size_t begin, size_t end, int thread) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t v = uint32_t(i);
+            Quadric &q       = quadrics[i];
+            ForEachFace(v, [&](uint32_t f) {
+                float p[3][3], n[3];
+                for (int j = 0; j < 3; ++j)
+                    Unit(Face(f)[j], p[j]);
+                Cross(p[0], p[1], p[2], n);
+                if (!Normalize(n))
+                    return;
+                q.AddPlane(n, -Dot(n, p[0]), 1.0f);
+
+                // The two edges of f that leave v.
+                int c = Corner(f, v);
+                for (int side = 1; side <= 2; ++side) {
+                    uint32_t w = Face(f)[(c + side) % 3];
+                    if (!BorderEdge(v, w))
+                        continue;
+                    flags[i] |= kBorder;
+                    const float *a = p[c], *b = p[(c + side) % 3];
+                    float e[3]     = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                    float bn[3]    = {e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2],
+                                      e[0] * n[1] - e[1] * n[0]};
+                    if (Normalize(bn))
+                        q.AddPlane(bn, -Dot(bn, a), boundaryWeight);
+                }
+            });
+            if (preserveBoundary && (flags[i] & kBorder)) {
+                flags[i] |= kLocked;
+                ++locked[thread];
+            }
+        }
+    });
+    if (stats) {
+        for (uint64_t n : locked)
+            stats->lockedVertices += n;
+    }
+}
+
+void CompactCollapser::Queue(uint32_t a, uint32_t b, CostBatch &batch) const {
+    bool border = ((flags[a] | flags[b]) & kBorder) && BorderEdge(a, b);
+    bool ab     = Removable(a, border);
+    bool ba     = Removable(b, border);
+    for (int d = 0; d < 2; ++d) {
+        if (!(d == 0 ? ab : ba))
+            continue;
+        uint32_t from = d == 0 ? a : b, to = d == 0 ? b : a;
+        float p[3];
+        Unit(to, p);
+        batch.from.push_back(from);
+        batch.to.push_back(to);
+        batch.paired.push_back(d == 0 && ba);
+        batch.x.push_back(p[0]);
+        batch.y.push_back(p[1]);
+        batch.z.push_back(p[2]);
+    }
+}
+
+template <class Emit> void CompactCollapser::Score(CostBatch &batch, Emit emit) const {
+    const size_t n = batch.Size();
+    batch.cost.resize(n);
+    QuadricErrorBatch(Coefficients(), quadrics.size(), batch.from.data(), batch.to.data(),
+                      batch.x.data(), batch.y.data(), batch.z.data(), n, batch.cost.data());
+    for (size_t i = 0; i < n;) {
+        // Ties go to the first direction, a onto b.
+        size_t pick   = batch.paired[i] && batch.cost[i + 1] < batch.cost[i] ? i + 1 : i;
+        uint32_t from = batch.from[pick], to = batch.to[pick];
+        emit(Candidate{batch.cost[pick], from, to, version[from], version[to]});
+        i += batch.paired[i] ? 2 : 1;
+    }
+    batch.from.clear();
+    batch.to.clear();
+    batch.paired.clear();
+    batch.x.clear();
+    batch.y.clear();
+    batch.z.clear();
+}
+
+// One candidate per edge: interior edges are seen from both faces, so only the face that runs
+// the edge from the lower to the higher index adds it; border edges have a single face. Edges
+// are costed a few hundred at a time.
+void CompactCollapser::InitHeap() {
+    const size_t fn = m.FaceCount();
+    std::vector<std::vector<Candidate>> perThread(threads);
+    ParallelForRange(fn, threads, [&](size_t begin, size_t end, int thread) {
+        std::vector<Candidate> &out = perThread[thread];
+        auto emit                   = [&](const Candidate &c) { out.push_back(c); };
+        CostBatch batch;
+        for (size_t f = begin; f < end; ++f) {
+            if (Dead(uint32_t(f)))
+                continue;
+            const uint32_t *v = Face(uint32_t(f));
+            for (int j = 0; j < 3; ++j) {
+                uint32_t a = v[j], b = v[(j + 1) % 3];
+                if (a > b && !((flags[a] & flags[b] & kBorder) && BorderEdge(a, b)))
+                    continue;
+                Queue(a, b, batch);
+            }
+            if (batch.Size() >= 512)
+                Score(batch, emit);
+        }
+        Score(batch, emit);
+    });
+    size_t total = 0;
+    for (const std::vector<Candidate> &c : perThread)
+        total += c.size();
+    heap.clear();
+    heap.reserve(total);
+    for (std::vector<Candidate> &c : perThread) {
+        heap.insert(heap.end(), c.begin(), c.end());
+        std::vector<Candidate>().swap(c);
+    }
+    std::make_heap(heap.begin(), heap.end(), Cheaper);
+    counters.heapHighWater = std::max<uint64_t>(counters.heapHighWater, heap.size());
+}
+
+void CompactCollapser::Neighbours(uint32_t v, uint32_t skip, std::vector<uint32_t> &out) const {
+    out.clear();
+    ForEachFace(v, [&](uint32_t f) {
+        for (int j = 0; j < 3; ++j) {
+            uint32_t w = Face(f)[j];
+            if (w != v && w != skip)
+                out.push_back(w);
+        }
+    });
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool CompactCollapser::Collapse(uint32_t from, uint32_t to, float cost) {
+    edgeFaces.clear();
+    movedFaces.clear();
+    ForEachFace(from, [&](uint32_t f) {
+        (Corner(f, to) >= 0 ? edgeFaces : movedFaces).push_back(f);
+    });
+    if (edgeFaces.empty())
+        return false;
+
+    // Link condition: the only vertices adjacent to both endpoints are the apexes of the faces
+    // on the edge, otherwise the collapse pinches the surface.
+    if (preserveTopology) {
+        Neighbours(from, to, ring0);
+        Neighbours(to, from, ring1);
+        size_t shared = 0;
+        for (size_t i = 0, j = 0; i < ring0.size() && j < ring1.size();) {
+            if (ring0[i] < ring1[j])
+                ++i;
+            else if (ring1[j] < ring0[i])
+                ++j;
+            else {
+                ++shared;
+                ++i;
+                ++j;
+            }
+        }
+        if (shared > edgeFaces.size())
+            return false;
+    }
+
+    float target[3];
+    Unit(to, target);
+    newUVs.resize(movedFaces.size() * 2);
+    for (size_t i = 0; i < movedFaces.size(); ++i) {
+        const uint32_t f = movedFaces[i];
+        const int c      = Corner(f, from);
+
+        // Reject faces that flip or vanish when `from` moves onto `to`.
+        float p[3][3], before[3], after[3];
+        for (int j = 0; j < 3; ++j)
+            Unit(Face(f)[j], p[j]);
+        Cross(p[0], p[1], p[2], before);
+        for (int k = 0; k < 3; ++k)
+            p[c][k] = target[k];
+        Cross(p[0], p[1], p[2], after);
+        if (Dot(before, after) <= 0.0f && Dot(before, before) > 0.0f)
+            return false;
+
+        // The corner takes the UV `to` has in an edge face that shares the UV of `from` here.
+        // A `from` wedge that touches no edge face lies across a seam the collapse would tear.
+        const float *uv = &m.uvs[size_t(f) * 6 + c * 2];
+        bool found      = false;
+        for (uint32_t g : edgeFaces) {
+            const float *guv = &m.uvs[size_t(g) * 6 + Corner(g, from) * 2];
+            if (guv[0] == uv[0] && guv[1] == uv[1]) {
+                const float *tuv  = &m.uvs[size_t(g) * 6 + Corner(g, to) * 2];
+                newUVs[i * 2]     = tuv[0];
+                newUVs[i * 2 + 1] = tuv[1];
+                found             = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+    }
+
+    for (uint32_t f : edgeFaces)
+        m.indices[size_t(f) * 3 + Corner(f, from)] = to; // now degenerate, so dead
+    for (size_t i = 0; i < movedFaces.size(); ++i) {
+        const uint32_t f                 = movedFaces[i];
+        const int c                      = Corner(f, from);
+        m.indices[size_t(f) * 3 + c]     = to;
+        m.uvs[size_t(f) * 6 + c * 2]     = newUVs[i * 2];
+        m.uvs[size_t(f) * 6 + c * 2 + 1] = newUVs[i * 2 + 1];
+    }
+    liveFaces -= edgeFaces.size();
+    quadrics[to].Add(quadrics[from]);
+    chainNext[chainTail[to]] = from;
+    chainTail[to]            = chainTail[from];
+    flags[from] |= kRemoved;
+    ++version[from];
+    ++version[to];
+    ++counters.performed;
+    counters.maxDeviation = std::max(counters.maxDeviation, std::sqrt(double(cost)) * scale);
+
+    // The chains get long and the flat adjacency mostly dead as faces go: rebuild it once half
+    // of the faces it was built from are gone.
+    if (liveFaces * 2 < facesAtBuild)
+        BuildAdjacency();
+
+    Neighbours(to, kNone, ring1);
+    for (uint32_t w : ring1)
+        Queue(to, w, ringBatch);
+    Score(ringBatch, [&](const Candidate &c) { Push(c); });
+    return true;
+}
+
+void CompactCollapser::RunTo(size_t targetFaces) {
+    VCG_TRACE_SCOPE("CompactCollapse");
+    PhaseTimer timer(stats, &Simplifier::Stats::collapseMs, "collapse");
+    while (liveFaces > targetFaces && !heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), Cheaper);
+        const Candidate c = heap.back();
+        heap.pop_back();
+        if (((flags[c.from] | flags[c.to]) & kRemoved) || version[c.from] != c.fromVersion ||
+            version[c.to] != c.toVersion) {
+            ++counters.stalePops;
+            continue;
+        }
+        // The heap is ordered by error, so nothing left in it is below the limit either.
+        if (maxErrorSq > 0.0f && c.cost > maxErrorSq) {
+            ++counters.errorReject;
+            break;
+        }
+        if (Collapse(c.from, c.to, c.cost))
+            continue;
+        // The cheaper direction failed its checks; the other one may still pass.
+        bool border = ((flags[c.from] | flags[c.to]) & kBorder) && BorderEdge(c.from, c.to);
+        if (Removable(c.to, border)) {
+            float cost = Cost(c.to, c.from);
+            if ((maxErrorSq <= 0.0f || cost <= maxErrorSq) && Collapse(c.to, c.from, cost))
+                continue;
+        }
+        ++counters.topologyReject;
+    }
+}
+
+void CompactCollapser::Finalize() {
+    VCG_TRACE_SCOPE("CompactFinalize");
+    PhaseTimer timer(stats, &Simplifier::Stats::collapseMs, "finalize");
+    std::vector<Candidate>().swap(heap);
+    std::vector<Quadric>().swap(quadrics);
+    std::vector<uint32_t>().swap(adjacency);
+    std::vector<uint32_t>().swap(firstFace);
+    std::vector<uint32_t>().swap(chainNext);
+    std::vector<uint32_t>().swap(chainTail);
+
+    std::vector<uint8_t> keep(m.FaceCount());
+    for (size_t f = 0; f < keep.size(); ++f)
+        keep[f] = !Dead(uint32_t(f));
+    m.Compact(keep);
+
+    if (stats) {
+        CollapseCounters &c = stats->collapses;
+        c.performed += counters.performed;
+        c.stalePops += counters.stalePops;
+        c.topologyReject += counters.topologyReject;
+        c.errorReject += counters.errorReject;
+        c.heapHighWater = std::max(c.heapHighWater, counters.heapHighWater);
+        c.maxDeviation  = std::max(c.maxDeviation, counters.maxDeviation);
+    }
+}
+
+} // namespace
+
+void Simplifier::Simplify(CompactMesh &m, const Params &params) {
+    size_t targetCount = params.targetFaceCount < 0 ? size_t(m.FaceCount() * params.ratio)
+                                                    : size_t(params.targetFaceCount);
+    CompactCollapser collapser(m, params, ResolveThreadCount(params.threads));
+    collapser.RunTo(targetCount);
+    collapser.Finalize();
+}
\ No newline at end of file
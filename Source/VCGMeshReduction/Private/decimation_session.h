@@ -0,0 +1,426 @@
+#pragma once
+
+#include "parallel.h"
+#include "simplifier.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <vcg/complex/algorithms/local_optimization.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric_tex.h>
+
+// Phase scopes for Unreal Insights. The UE module defines VCG_SIMPLIFIER_UE_TRACE; the CLI gets
+// the same phases from Simplifier::Stats instead.
+#if defined(VCG_SIMPLIFIER_UE_TRACE) && VCG_SIMPLIFIER_UE_TRACE
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#define VCG_TRACE_SCOPE(name) TRACE_CPUPROFILER_EVENT_SCOPE_STR("VCGSimplifier." name)
+#else
+#define VCG_TRACE_SCOPE(name)
+#endif
+
+// Adds the duration of its scope to one Stats field and records it as a phase. Does nothing
+// when `stats` is null.
+class PhaseTimer {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    PhaseTimer(Simplifier::Stats *stats, double Simplifier::Stats::*field, const char *name)
+        : stats(stats), field(field), name(name), start(Clock::now()) {}
+    ~PhaseTimer() {
+        if (!stats)
+            return;
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stats->*field += ms;
+        stats->phases.push_back(
+            {name, std::chrono::duration<double, std::milli>(start.time_since_epoch()).count(),
+             ms});
+    }
+    PhaseTimer(const PhaseTimer &)            = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  private:
+    Simplifier::Stats *stats;
+    double Simplifier::Stats::*field;
+    const char *name;
+    Clock::time_point start;
+};
+
+// One decimation run over a mesh: owns the quadric temporaries published through
+// MyQuadricHelper and the LocalOptimization heap, so several target face counts can be reached in
+// sequence without rebuilding either. All of its state is owned by the session and published on
+// the calling thread for the duration of each call, so consecutive calls may come from different
+// threads (but never concurrently).
+class DecimationSession {
+  public:
+    DecimationSession(MyMesh &m, const Simplifier::Params &params)
+        : m(PrepareLog(m, params)), geometryOnly(UseGeometryOnly(m, params)),
+          TD3(m.vert, ZeroQuadric()),
+          TD(geometryOnly ? nullptr
+                          : new MyQuadricHelper::Quadric5Temp(m.vert, EmptyWedgeList())),
+          TDv(m.vert, 0u),
+          DeciSession(m, CollapseParams()), stats(params.stats),
+          threads(ResolveThreadCount(params.threads)), engine(params.engine) {
+        MyQuadricHelper::Scope scope = Publish();
+        {
+            VCG_TRACE_SCOPE("Topology");
+            PhaseTimer timer(stats, &Simplifier::Stats::topologyMs, "topology");
+
+            // Preprocess
+            vcg::tri::UpdateTopology<MyMesh>::VertexFace(m);
+            vcg::tri::UpdateTopology<MyMesh>::FaceFace(m);
+
+            vcg::tri::UpdateFlags<MyMesh>::FaceBorderFromVF(m);
+            vcg::tri::UpdateNormal<MyMesh>::PerFace(m);
+
+            // 简化参数
+            if (vcg::tri::HasPerVertexAttribute(m, SkinWeights::kAttribute)) {
+                skin = vcg::tri::Allocator<MyMesh>::FindPerVertexAttribute<SkinWeights>(
+                    m, SkinWeights::kAttribute);
+            }
+            SetCommonParams(pp, params);
+            pp.ExtraTCoordWeight = params.extraTCoordWeight;
+            pp.BoundaryWeight    = params.boundaryWeight;
+            SetCommonParams(gp, params);
+            gp.BoundaryQuadricWeight = params.boundaryWeight;
+        }
+
+        {
+            VCG_TRACE_SCOPE("Init");
+            PhaseTimer timer(stats, &Simplifier::Stats::initMs, "init");
+            if (geometryOnly)
+                InitHeap<MyGeoCollapse>();
+            else
+                InitHeap<MyCollapse>();
+            DeciSession.SetTimeBudget(0.1f);
+        }
+
+        // Init clears the writable flag of border vertices when PreserveBoundary is set.
+        if (stats) {
+            CollapseCounters &counters = stats->collapses;
+            counters.heapHighWater =
+                std::max<uint64_t>(counters.heapHighWater, DeciSession.h.size());
+            for (const MyVertex &v : m.vert) {
+                if (!v.IsD() && !v.IsW())
+                    ++stats->lockedVertices;
+            }
+        }
+    }
+
+    // Collapses edges until the mesh has at most targetCount faces or the heap runs dry.
+    void RunTo(int targetCount) {
+        MyQuadricHelper::Scope scope = Publish();
+        VCG_TRACE_SCOPE("Collapse");
+        PhaseTimer timer(stats, &Simplifier::Stats::collapseMs, "collapse");
+        if (engine == Simplifier::Engine::IndependentSet) {
+            RunRounds(targetCount, std::chrono::steady_clock::time_point::max());
+            return;
+        }
+        DeciSession.SetTargetSimplices(targetCount);
+        while (DeciSession.DoOptimization() && m.fn > targetCount) {
+            // 可以在这里添加进度更新的回调
+        }
+    }
+
+    // Collapses edges for about budgetSeconds of wall time, checked between rounds or batches of
+    // kStepOperations collapses. Returns false once the mesh has at most targetCount faces or
+    // the heap is empty.
+    bool Step(int targetCount, float budgetSeconds) {
+        MyQuadricHelper::Scope scope = Publish();
+        VCG_TRACE_SCOPE("Collapse");
+        PhaseTimer timer(stats, &Simplifier::Stats::collapseMs, "collapse");
+        auto budget   = std::chrono::duration<float>(budgetSeconds);
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget);
+        if (engine == Simplifier::Engine::IndependentSet)
+            return RunRounds(targetCount, deadline) && m.fn > targetCount;
+
+        // vcglib's own time budget is process CPU time (clock()), which runs ahead of the wall
+        // clock while other threads work: bound each DoOptimization by a number of collapses.
+        DeciSession.SetTargetSimplices(targetCount);
+        DeciSession.SetTargetOperations(kStepOperations);
+        bool heapLeft = true;
+        do {
+            heapLeft = DeciSession.DoOptimization();
+        } while (heapLeft && m.fn > targetCount && std::chrono::steady_clock::now() < deadline);
+        return heapLeft && m.fn > targetCount;
+    }
+
+    void Finalize() {
+        MyQuadricHelper::Scope scope = Publish();
+        VCG_TRACE_SCOPE("Finalize");
+        PhaseTimer timer(stats, &Simplifier::Stats::collapseMs, "finalize");
+        if (geometryOnly)
+            DeciSession.Finalize<MyGeoCollapse>();
+        else
+            DeciSession.Finalize<MyCollapse>();
+    }
+
+    // True when the session runs MyGeoCollapse rather than MyCollapse.
+    bool GeometryOnly() const { return geometryOnly; }
+
+  private:
+    typedef vcg::LocalOptimization<MyMesh>::HeapElem HeapElem;
+
+    // An independent-set round looks at the cheapest m.fn / kRoundDivisor candidates, and at no
+    // fewer than kMinRoundCandidates.
+    static constexpr size_t kRoundDivisor       = 64;
+    static constexpr size_t kMinRoundCandidates = 256;
+    // Collapses per DoOptimization call in a serial Step, between two looks at the clock.
+    static constexpr int kStepOperations = 1000;
+
+    vcg::BaseParameterClass *CollapseParams() {
+        return geometryOnly ? static_cast<vcg::BaseParameterClass *>(&gp) : &pp;
+    }
+
+    // Independent-set rounds until the mesh has at most targetCount faces, the heap is empty or
+    // the deadline has passed. Returns false once the heap is empty.
+    bool RunRounds(int targetCount, std::chrono::steady_clock::time_point deadline) {
+        bool heapLeft = !DeciSession.h.empty();
+        while (heapLeft && m.fn > targetCount && std::chrono::steady_clock::now() < deadline) {
+            heapLeft = geometryOnly ? RunRound<MyGeoCollapse>(targetCount)
+                                    : RunRound<MyCollapse>(targetCount);
+        }
+        return heapLeft;
+    }
+
+    // One round of the independent-set engine. Pops the cheapest candidates and keeps the ones
+    // whose neighbourhoods (the vertices of the faces around both endpoints) do not overlap those
+    // of the collapses already kept; the others go back to the heap. No kept collapse can change
+    // the priority or the feasibility of another, so they are performed in heap order as the
+    // serial loop would. The collapses around the surviving vertices are then scored on the
+    // session's threads and queued in a fixed order, so the result does not depend on the thread
+    // count. Returns false once the heap is empty.
+    template <class Collapse> bool RunRound(int targetCount) {
+        std::vector<HeapElem> &h        = DeciSession.h;
+        vcg::BaseParameterClass *params = CollapseParams();
+        const size_t window             =
+            std::max(kMinRoundCandidates, size_t(m.fn) / kRoundDivisor);
+        if (claimed.empty())
+            claimed.assign(m.vert.size(), 0);
+
+        std::vector<Collapse *> kept;
+        std::vector<HeapElem> deferred;
+        std::vector<size_t> ring, touched;
+        int faces = m.fn;
+        for (size_t popped = 0; popped < window && faces > targetCount && !h.empty(); ++popped) {
+            if (h.size() > m.fn * DeciSession.HeapSimplexRatio)
+                DeciSession.ClearHeap();
+            std::pop_heap(h.begin(), h.end());
+            HeapElem top = h.back();
+            h.pop_back();
+            DeciSession.currMetric = top.pri;
+
+            Collapse *c = static_cast<Collapse *>(top.locModPtr);
+            if (!c->IsUpToDate()) {
+                delete c;
+                continue;
+            }
+            int deleted = Neighbourhood(c->Pair(), ring);
+            if (std::any_of(ring.begin(), ring.end(), [&](size_t v) { return claimed[v]; })) {
+                deferred.push_back(top);
+                continue;
+            }
+            if (!c->IsFeasible(params)) {
+                delete c;
+                continue;
+            }
+            for (size_t v : ring)
+                claimed[v] = 1;
+            touched.insert(touched.end(), ring.begin(), ring.end());
+            faces -= deleted;
+            kept.push_back(c);
+        }
+        for (const HeapElem &e : deferred) {
+            h.push_back(e);
+            std::push_heap(h.begin(), h.end());
+        }
+        for (size_t v : touched)
+            claimed[v] = 0;
+
+        // What MyCollapseBase::UpdateHeap does after each collapse, with the scoring deferred.
+        typedef typename Collapse::ParameterType Parameter;
+        std::vector<MyVertexPair> pairs;
+        for (Collapse *c : kept) {
+            MyVertexPair pair = c->Pair();
+            c->Execute(m, params);
+            delete c;
+            Collapse::Requeue(pair, *static_cast<Parameter *>(params), pairs);
+        }
+        std::vector<HeapElem> scored(pairs.size());
+        Score<Collapse>(pairs, scored.data());
+        for (const HeapElem &e : scored) {
+            h.push_back(e);
+            std::push_heap(h.begin(), h.end());
+        }
+        if (stats) {
+            CollapseCounters &counters = stats->collapses;
+            counters.heapHighWater     = std::max<uint64_t>(counters.heapHighWater, h.size());
+        }
+        return !h.empty();
+    }
+
+    // Constructs, and so scores, the collapse of pairs[i] into out[i] on the session's threads.
+    // vcglib scores a collapse by moving both endpoints to the new position for a moment and
+    // looking at the faces around them, so a collapse holds its endpoints and their neighbours
+    // while it is scored. Locks are taken in index order, so they cannot deadlock. Staleness is
+    // tracked by vertex versions instead of GlobalMark() (see MyCollapseBase), so the mark is 0.
+    template <class Collapse> void Score(const std::vector<MyVertexPair> &pairs, HeapElem *out) {
+        if (threads == 1) {
+            for (size_t i = 0; i < pairs.size(); ++i)
+                out[i] = HeapElem(new Collapse(pairs[i], 0, CollapseParams()));
+            return;
+        }
+        if (!busy)
+            busy.reset(new std::atomic<uint8_t>[m.vert.size()]());
+        ParallelForRange(pairs.size(), threads, [&](size_t begin, size_t end, int) {
+            MyQuadricHelper::Scope scope(&TD3, TD.get(), &TDv);
+            std::vector<size_t> ring;
+            for (size_t i = begin; i < end; ++i) {
+                Neighbourhood(pairs[i], ring);
+                for (size_t v : ring) {
+                    while (busy[v].exchange(1, std::memory_order_acquire))
+                        std::this_thread::yield();
+                }
+                out[i] = HeapElem(new Collapse(pairs[i], 0, CollapseParams()));
+                for (size_t v : ring)
+                    busy[v].store(0, std::memory_order_release);
+            }
+        });
+    }
+
+    // Sorted indices of the vertices of the faces around both endpoints of `pair`. Returns the
+    // number of faces the collapse deletes (the ones on the edge).
+    int Neighbourhood(const MyVertexPair &pair, std::vector<size_t> &ring) const {
+        ring.clear();
+        int shared = 0;
+        for (int k = 0; k < 2; ++k) {
+            vcg::face::VFIterator<MyFace> vfi(const_cast<MyVertex *>(pair.cV(k)));
+            for (; !vfi.End(); ++vfi) {
+                for (int j = 0; j < 3; ++j)
+                    ring.push_back(size_t(vfi.F()->cV(j) - &m.vert[0]));
+                if (k == 0)
+                    shared += vfi.F()->cV(0) == pair.cV(1) || vfi.F()->cV(1) == pair.cV(1) ||
+                              vfi.F()->cV(2) == pair.cV(1);
+            }
+        }
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+        return shared;
+    }
+
+    // DeciSession.Init<Collapse>() with the scoring of the candidates and the heapify spread over
+    // the session's threads. vcglib's Init still runs serially, with MyPendingCollapse, for the
+    // border locking, the quadrics and the candidate list; every candidate is then scored in its
+    // slot and ParallelMakeHeap builds the heap, so the heap is the one the serial Init builds.
+    // The quadrics are left to vcglib: per-thread partial sums would change their rounding.
+    template <class Collapse> void InitHeap() {
+        if (threads == 1) {
+            DeciSession.Init<Collapse>();
+            return;
+        }
+        std::vector<HeapElem> &h = DeciSession.h;
+        vcg::tri::InitVertexIMark(m);
+        DeciSession.HeapSimplexRatio = Collapse::HeapSimplexRatio(CollapseParams());
+        Collapse::PendingInit::Init(m, h, CollapseParams());
+
+        std::vector<MyVertexPair> pairs;
+        pairs.reserve(h.size());
+        for (HeapElem &e : h) {
+            pairs.push_back(static_cast<MyPendingCollapse *>(e.locModPtr)->pair);
+            delete e.locModPtr;
+        }
+        Score<Collapse>(pairs, h.data());
+        ParallelMakeHeap(h.begin(), h.end(), threads, std::less<HeapElem>());
+        if (!h.empty())
+            DeciSession.currMetric = h.front().pri;
+    }
+
+    MyQuadricHelper::Scope Publish() {
+        return MyQuadricHelper::Scope(&TD3, TD.get(), &TDv, stats ? &stats->collapses : nullptr);
+    }
+
+    static bool UseGeometryOnly(const MyMesh &m, const Simplifier::Params &params) {
+        switch (params.collapseKind) {
+        case Simplifier::CollapseKind::GeometryOnly:
+            return true;
+        case Simplifier::CollapseKind::Textured:
+            return false;
+        default:
+            return !HasTexCoords(m);
+        }
+    }
+    // Loaders give every wedge the same UV when the input has none.
+    static bool HasTexCoords(const MyMesh &m) {
+        const vcg::TexCoord2f *first = nullptr;
+        for (const MyFace &f : m.face) {
+            if (f.IsD())
+                continue;
+            for (int j = 0; j < 3; ++j) {
+                if (!first)
+                    first = &f.cWT(j);
+                else if (f.cWT(j).U() != first->U() || f.cWT(j).V() != first->V())
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // The settings MyCollapseParameter and MyGeoCollapseParameter share.
+    template <class Parameter>
+    void SetCommonParams(Parameter &p, const Simplifier::Params &params) {
+        p.SetDefaultParams();
+        p.PreserveBoundary = params.preserveBoundary;
+        p.PreserveTopology = params.preserveTopology;
+        p.QualityThr       = params.qualityThr;
+        p.NormalCheck      = params.normalCheck;
+        p.OptimalPlacement = params.optimalPlacement;
+        p.collapseLog      = params.collapseLog;
+        p.maxError         = params.maxError;
+        if (skin.IsValid()) {
+            p.skin          = &skin;
+            p.skinWeight    = params.skinWeight;
+            p.maxInfluences = params.maxInfluences;
+        }
+    }
+
+    // Collapses are logged by index, so the base mesh must not contain deleted elements.
+    static MyMesh &PrepareLog(MyMesh &m, const Simplifier::Params &params) {
+        if (params.collapseLog) {
+            vcg::tri::Allocator<MyMesh>::CompactEveryVector(m);
+            params.collapseLog->SetBase(m);
+        }
+        return m;
+    }
+    static vcg::math::Quadric<double> ZeroQuadric() {
+        vcg::math::Quadric<double> q;
+        q.SetZero();
+        return q;
+    }
+    static std::vector<std::pair<vcg::TexCoord2<float>, vcg::Quadric5<double>>> EmptyWedgeList() {
+        return {};
+    }
+
+    MyMesh &m;
+    const bool geometryOnly;
+    MyCollapseParameter pp;
+    MyGeoCollapseParameter gp;
+    MyQuadricHelper::QuadricTemp TD3;
+    std::unique_ptr<MyQuadricHelper::Quadric5Temp> TD; // only for MyCollapse
+    MyQuadricHelper::VersionTemp TDv;
+    SkinHandle skin;
+    vcg::LocalOptimization<MyMesh> DeciSession;
+    Simplifier::Stats *stats;
+    const int threads; // scoring only; collapses always run on the calling thread
+    const Simplifier::Engine engine;
+    std::vector<uint8_t> claimed;                  // independent-set rounds
+    std::unique_ptr<std::atomic<uint8_t>[]> busy; // parallel scoring
+};
+
+// Partitions `m` into spatial clusters, simplifies them concurrently with their shared vertices
+// locked and finishes with a serial pass around the seams until m.fn <= targetCount.
+// Implemented in partitioned_simplify.cpp.
+void SimplifyPartitioned(MyMesh &m, const Simplifier::Params &params, int targetCount,
+                         int threads);
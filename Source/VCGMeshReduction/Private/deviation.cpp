@@ -0,0 +1,329 @@
+#include "deviation.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Integer hash (lowbias32) -> [0, 1).
+float Hash(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ seed * 0xC2B2AE3Du;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return float(h >> 8) / float(1u << 24);
+}
+
+// A triangle as one corner and the two edges leaving it, the form the closest-point test uses.
+struct Triangle {
+    vcg::Point3f a, ab, ac;
+};
+
+float BoxDistanceSq(const vcg::Box3f &box, const vcg::Point3f &p) {
+    float d = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        float v = std::max(std::max(box.min[k] - p[k], p[k] - box.max[k]), 0.0f);
+        d += v * v;
+    }
+    return d;
+}
+
+// Closest point of `t` to `p` (Ericson, Real-Time Collision Detection 5.1.5).
+vcg::Point3f ClosestPoint(const Triangle &t, const vcg::Point3f &p) {
+    const vcg::Point3f ap = p - t.a;
+    const float d1 = t.ab * ap, d2 = t.ac * ap;
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return t.a;
+    const vcg::Point3f bp = ap - t.ab;
+    const float d3 = t.ab * bp, d4 = t.ac * bp;
+    if (d3 >= 0.0f && d4 <= d3)
+        return t.a + t.ab;
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return t.a + t.ab * (d1 / (d1 - d3));
+    const vcg::Point3f cp = ap - t.ac;
+    const float d5 = t.ab * cp, d6 = t.ac * cp;
+    if (d6 >= 0.0f && d5 <= d6)
+        return t.a + t.ac;
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return t.a + t.ac * (d2 / (d2 - d6));
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return t.a + t.ab + (t.ac - t.ab) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    const float denom = 1.0f / (va + vb + vc);
+    return t.a + t.ab * (vb * denom) + t.ac * (vc * denom);
+}
+
+// Bounding volume hierarchy over the live faces of a mesh, split at the centroid median of the
+// longest axis. Triangles are stored in leaf order so a leaf tests a contiguous run of them.
+class TriangleBVH {
+  public:
+    explicit TriangleBVH(const MyMesh &m) {
+        std::vector<Triangle> input;
+        input.reserve(m.fn);
+        for (const MyFace &f : m.face) {
+            if (f.IsD())
+                continue;
+            const vcg::Point3f &a = f.cP(0);
+            input.push_back({a, f.cP(1) - a, f.cP(2) - a});
+        }
+        if (input.empty())
+            return;
+
+        centroids.resize(input.size());
+        order.resize(input.size());
+        for (size_t i = 0; i < input.size(); ++i) {
+            centroids[i] = input[i].a + (input[i].ab + input[i].ac) / 3.0f;
+            order[i]     = uint32_t(i);
+        }
+        nodes.reserve(2 * input.size() / kLeafSize + 1);
+        Build(input, 0, uint32_t(input.size()), 1);
+        // The median split halves every node, so depth stays near log2 of the face count.
+        assert(depth < kStackSize);
+
+        triangles.resize(input.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            triangles[i] = input[order[i]];
+        std::vector<vcg::Point3f>().swap(centroids);
+        std::vector<uint32_t>().swap(order);
+    }
+
+    bool Empty() const { return nodes.empty(); }
+    const vcg::Box3f &Bounds() const { return nodes[0].box; }
+
+    // Squared distance from `p` to the surface. `bestSq` is a known upper bound (the squared
+    // distance to `closest`, a point on the surface) or infinity; both are updated.
+    float Closest(const vcg::Point3f &p, float bestSq, vcg::Point3f &closest) const {
+        // Each level of the path to the current node leaves at most one sibling on the stack.
+        uint32_t stack[kStackSize];
+        int top      = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index   = stack[--top];
+            const Node &node = nodes[index];
+            if (node.count > 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                    vcg::Point3f q = ClosestPoint(triangles[i], p);
+                    float d        = (q - p).SquaredNorm();
+                    if (d < bestSq) {
+                        bestSq  = d;
+                        closest = q;
+                    }
+                }
+                continue;
+            }
+            // Visit the nearer child first; skip children that cannot beat the best so far.
+            uint32_t left = index + 1, right = node.first;
+            float dl = BoxDistanceSq(nodes[left].box, p);
+            float dr = BoxDistanceSq(nodes[right].box, p);
+            if (dl > dr) {
+                std::swap(left, right);
+                std::swap(dl, dr);
+            }
+            if (dr < bestSq)
+                stack[top++] = right;
+            if (dl < bestSq)
+                stack[top++] = left;
+        }
+        return bestSq;
+    }
+
+  private:
+    static const uint32_t kLeafSize = 4;
+    static const int kStackSize      = 64;
+
+    // Leaf: triangles [first, first + count). Inner node (count == 0): the left child follows the
+    // node, `first` is the right child.
+    struct Node {
+        vcg::Box3f box;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    uint32_t Build(const std::vector<Triangle> &input, uint32_t begin, uint32_t end, int level) {
+        depth          = std::max(depth, level);
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back(Node());
+        vcg::Box3f box, centroidBox;
+        for (uint32_t i = begin; i < end; ++i) {
+            const Triangle &t = input[order[i]];
+            box.Add(t.a);
+            box.Add(t.a + t.ab);
+            box.Add(t.a + t.ac);
+            centroidBox.Add(centroids[order[i]]);
+        }
+        nodes[index].box = box;
+        if (end - begin <= kLeafSize) {
+            nodes[index].first = begin;
+            nodes[index].count = end - begin;
+            return index;
+        }
+
+        vcg::Point3f extent = centroidBox.Dim();
+        int axis = extent[0] > extent[1] ? (extent[0] > extent[2] ? 0 : 2)
+                                         : (extent[1] > extent[2] ? 1 : 2);
+        uint32_t mid = begin + (end - begin) / 2;
+        std::nth_element(
+            order.begin() + begin, order.begin() + mid, order.begin() + end,
+            [&](uint32_t x, uint32_t y) { return centroids[x][axis] < centroids[y][axis]; });
+        Build(input, begin, mid, level + 1);
+        uint32_t right     = Build(input, mid, end, level + 1);
+        nodes[index].first = right;
+        nodes[index].count = 0;
+        return index;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;
+    std::vector<vcg::Point3f> centroids; // build only
+    std::vector<uint32_t> order;         // build only
+    int depth = 0;                       // levels of the tree, root only = 1
+};
+
+struct Accumulator {
+    double sum     = 0.0;
+    double sumSq   = 0.0;
+    double max     = 0.0;
+    size_t samples = 0;
+
+    void Add(double d) {
+        sum += d;
+        sumSq += d * d;
+        max = std::max(max, d);
+        ++samples;
+    }
+    void Merge(const Accumulator &other) {
+        sum += other.sum;
+        sumSq += other.sumSq;
+        max = std::max(max, other.max);
+        samples += other.samples;
+    }
+    Deviation::Distance Finish() const {
+        Deviation::Distance d;
+        d.max     = max;
+        d.mean    = samples ? sum / samples : 0.0;
+        d.rms     = samples ? std::sqrt(sumSq / samples) : 0.0;
+        d.samples = samples;
+        return d;
+    }
+};
+
+struct ThreadAccumulator {
+    Accumulator all;
+    std::unordered_map<int, Accumulator> byMaterial;
+};
+
+double FaceArea(const MyFace &f) {
+    return double(((f.cP(1) - f.cP(0)) ^ (f.cP(2) - f.cP(0))).Norm()) * 0.5;
+}
+
+// Samples the live faces of `from` by area and measures each sample against `to`.
+Deviation::OneSided Sample(const MyMesh &from, const TriangleBVH &to,
+                           const Deviation::Params &params, int threads, Accumulator &total) {
+    Deviation::OneSided result;
+    if (to.Empty())
+        return result;
+
+    // Blocks of faces handed out to the threads; each thread owns its accumulators.
+    const size_t kBlock = 4096;
+    const size_t blocks = (from.face.size() + kBlock - 1) / kBlock;
+    std::vector<double> blockArea(blocks, 0.0);
+    ParallelForEach(blocks, threads, [&](size_t b, int) {
+        size_t end = std::min(from.face.size(), (b + 1) * kBlock);
+        for (size_t i = b * kBlock; i < end; ++i) {
+            if (!from.face[i].IsD())
+                blockArea[b] += FaceArea(from.face[i]);
+        }
+    });
+    double area = 0.0;
+    for (double a : blockArea)
+        area += a;
+    if (area <= 0.0)
+        return result;
+    const double density = double(params.samples) / area;
+
+    std::vector<ThreadAccumulator> perThread(threads);
+    ParallelForEach(blocks, threads, [&](size_t b, int thread) {
+        ThreadAccumulator &acc = perThread[thread];
+        int lastMat            = std::numeric_limits<int>::min();
+        Accumulator *mat       = nullptr;
+        // The closest point of the previous sample bounds the next query, which lets it prune
+        // most of the tree: consecutive samples lie on the same or a neighbouring face.
+        bool haveHint = false;
+        vcg::Point3f hint;
+        size_t end = std::min(from.face.size(), (b + 1) * kBlock);
+        for (size_t i = b * kBlock; i < end; ++i) {
+            const MyFace &f = from.face[i];
+            if (f.IsD())
+                continue;
+            // floor(expected) samples plus one more with the probability of the remainder.
+            double expected = FaceArea(f) * density;
+            size_t count    = size_t(expected);
+            if (Hash(uint32_t(i), 0xFFFFFFFFu, params.seed) < expected - double(count))
+                ++count;
+            if (count == 0)
+                continue;
+            if (f.matId != lastMat) {
+                lastMat = f.matId;
+                mat     = &acc.byMaterial[f.matId];
+            }
+            const vcg::Point3f a = f.cP(0), ab = f.cP(1) - a, ac = f.cP(2) - a;
+            for (size_t k = 0; k < count; ++k) {
+                float r1 = Hash(uint32_t(i), uint32_t(2 * k), params.seed);
+                float r2 = Hash(uint32_t(i), uint32_t(2 * k + 1), params.seed);
+                if (r1 + r2 > 1.0f) {
+                    r1 = 1.0f - r1;
+                    r2 = 1.0f - r2;
+                }
+                vcg::Point3f p = a + ab * r1 + ac * r2;
+                float bound    = haveHint ? (hint - p).SquaredNorm()
+                                          : std::numeric_limits<float>::infinity();
+                double d       = std::sqrt(double(to.Closest(p, bound, hint)));
+                haveHint       = true;
+                acc.all.Add(d);
+                mat->Add(d);
+            }
+        }
+    });
+
+    Accumulator all;
+    std::map<int, Accumulator> byMaterial;
+    for (const ThreadAccumulator &acc : perThread) {
+        all.Merge(acc.all);
+        for (const auto &entry : acc.byMaterial)
+            byMaterial[entry.first].Merge(entry.second);
+    }
+    result.all = all.Finish();
+    for (const auto &entry : byMaterial)
+        result.byMaterial[entry.first] = entry.second.Finish();
+    total.Merge(all);
+    return result;
+}
+
+} // namespace
+
+Deviation::Result Deviation::Measure(const MyMesh &a, const MyMesh &b, const Params &params) {
+    int threads = ResolveThreadCount(params.threads);
+
+    // Both trees are built concurrently; each build is serial.
+    std::unique_ptr<TriangleBVH> trees[2];
+    ParallelForEach(2, threads,
+                    [&](size_t i, int) { trees[i].reset(new TriangleBVH(i ? b : a)); });
+
+    Result result;
+    Accumulator total;
+    result.forward   = Sample(a, *trees[1], params, threads, total);
+    result.backward  = Sample(b, *trees[0], params, threads, total);
+    result.hausdorff = std::max(result.forward.all.max, result.backward.all.max);
+    result.rms       = total.Finish().rms;
+    result.diagonal  = trees[0]->Empty() ? 0.0 : double(trees[0]->Bounds().Diag());
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,410 @@
+#include "gpu_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// --- 渲染顺序 ---
+
+namespace {
+
+// Forsyth's vertex cache model and scoring constants.
+const int kForsythCacheSize    = 32;
+const float kCacheDecayPower   = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+
+// The hardware the analysis models.
+const uint32_t kFifoCacheSize = 16;
+const size_t kFetchLineBytes  = 64;
+const size_t kFetchCacheLines = 256; // direct mapped, 16 KB
+const int kOverdrawGrid       = 256;
+
+// Score of a vertex at `cachePosition` (-1: not cached) with `remaining` triangles left to draw.
+class ScoreTable {
+  public:
+    ScoreTable() {
+        for (int i = 0; i < kForsythCacheSize; ++i) {
+            // The last triangle's vertices score the same whatever order they were drawn in.
+            cache[i] = i < 3 ? kLastTriangleScore
+                             : std::pow(1.0f - float(i - 3) / float(kForsythCacheSize - 3),
+                                        kCacheDecayPower);
+        }
+        for (uint32_t n = 1; n < kValences; ++n)
+            valence[n] = Valence(n);
+    }
+
+    float operator()(int cachePosition, uint32_t remaining) const {
+        if (remaining == 0)
+            return -1.0f;
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return score + (remaining < kValences ? valence[remaining] : Valence(remaining));
+    }
+
+  private:
+    static const uint32_t kValences = 64;
+
+    // Vertices with few triangles left are boosted, so lone triangles get drawn.
+    static float Valence(uint32_t remaining) {
+        return kValenceBoostScale * std::pow(float(remaining), -kValenceBoostPower);
+    }
+
+    float cache[kForsythCacheSize];
+    float valence[kValences] = {};
+};
+
+// FIFO post-transform cache. A vertex is cached while fewer than kFifoCacheSize misses followed
+// its own.
+class FifoCache {
+  public:
+    explicit FifoCache(size_t vertexCount) : inserted(vertexCount, 0) {}
+
+    bool Miss(uint32_t v) {
+        if (time - inserted[v] <= kFifoCacheSize)
+            return false;
+        inserted[v] = time++;
+        return true;
+    }
+    void Flush() { time += kFifoCacheSize + 1; }
+
+  private:
+    std::vector<uint64_t> inserted;
+    uint64_t time = kFifoCacheSize + 1;
+};
+
+struct Vec3 {
+    double x, y, z;
+};
+
+Vec3 Position(const float *positions, uint32_t v) {
+    const float *p = positions + size_t(v) * 3;
+    return {p[0], p[1], p[2]};
+}
+
+// Area-weighted normal (twice the area long) and centroid of triangle t.
+void Triangle(const uint32_t *indices, const float *positions, size_t t, Vec3 &normal,
+              Vec3 &centroid) {
+    Vec3 a   = Position(positions, indices[t * 3]);
+    Vec3 b   = Position(positions, indices[t * 3 + 1]);
+    Vec3 c   = Position(positions, indices[t * 3 + 2]);
+    Vec3 e   = {b.x - a.x, b.y - a.y, b.z - a.z};
+    Vec3 f   = {c.x - a.x, c.y - a.y, c.z - a.z};
+    normal   = {e.y * f.z - e.z * f.y, e.z * f.x - e.x * f.z, e.x * f.y - e.y * f.x};
+    centroid = {(a.x + b.x + c.x) / 3, (a.y + b.y + c.y) / 3, (a.z + b.z + c.z) / 3};
+}
+
+// Fragments shaded per pixel covered when the triangles are drawn in order with depth testing
+// and back-face culling, summed over orthographic views along +-x, +-y and +-z.
+double Overdraw(const uint32_t *indices, size_t indexCount, const float *positions) {
+    float lo[3], hi[3];
+    std::fill(lo, lo + 3, std::numeric_limits<float>::max());
+    std::fill(hi, hi + 3, std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < indexCount; ++i) {
+        const float *p = positions + size_t(indices[i]) * 3;
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+
+    const float far = std::numeric_limits<float>::max();
+    std::vector<float> depth(size_t(kOverdrawGrid) * kOverdrawGrid);
+    size_t shaded = 0, covered = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const int u = (axis + 1) % 3, w = (axis + 2) % 3;
+        if (hi[u] <= lo[u] || hi[w] <= lo[w])
+            continue;
+        const float su = kOverdrawGrid / (hi[u] - lo[u]);
+        const float sw = kOverdrawGrid / (hi[w] - lo[w]);
+        for (float sign : {1.0f, -1.0f}) {
+            std::fill(depth.begin(), depth.end(), far);
+            for (size_t t = 0; t < indexCount / 3; ++t) {
+                float x[3], y[3], z[3];
+                for (int j = 0; j < 3; ++j) {
+                    const float *p = positions + size_t(indices[t * 3 + j]) * 3;
+                    x[j]           = (p[u] - lo[u]) * su;
+                    y[j]           = (p[w] - lo[w]) * sw;
+                    z[j]           = -sign * p[axis]; // the viewer looks from +sign * infinity
+                }
+                // The projected area is the normal's component along the axis.
+                float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+                if (sign * area <= 0)
+                    continue;
+                int x0 = std::max(int(std::floor(std::min({x[0], x[1], x[2]}))), 0);
+                int x1 = std::min(int(std::ceil(std::max({x[0], x[1], x[2]}))), kOverdrawGrid);
+                int y0 = std::max(int(std::floor(std::min({y[0], y[1], y[2]}))), 0);
+                int y1 = std::min(int(std::ceil(std::max({y[0], y[1], y[2]}))), kOverdrawGrid);
+                for (int py = y0; py < y1; ++py) {
+                    for (int px = x0; px < x1; ++px) {
+                        float cx = px + 0.5f, cy = py + 0.5f;
+                        float b0 = (x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1]);
+                        float b1 = (x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2]);
+                        float b2 = (x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0]);
+                        if (b0 * sign < 0 || b1 * sign < 0 || b2 * sign < 0)
+                            continue;
+                        float d  = (b0 * z[0] + b1 * z[1] + b2 * z[2]) / area;
+                        float &s = depth[size_t(py) * kOverdrawGrid + px];
+                        if (d < s) {
+                            s = d;
+                            ++shaded;
+                        }
+                    }
+                }
+            }
+            covered += size_t(std::count_if(depth.begin(), depth.end(),
+                                            [&](float d) { return d != far; }));
+        }
+    }
+    return covered ? double(shaded) / double(covered) : 0.0;
+}
+
+} // namespace
+
+GpuEfficiency AnalyzeGpuEfficiency(const uint32_t *indices, size_t indexCount,
+                                   const float *positions, size_t vertexCount,
+                                   size_t vertexStride) {
+    GpuEfficiency result;
+    const size_t triangles = indexCount / 3;
+    if (triangles == 0)
+        return result;
+
+    // The vertex is fetched when the shader runs, i.e. on a post-transform cache miss.
+    FifoCache cache(vertexCount);
+    std::vector<uint8_t> used(vertexCount, 0);
+    std::vector<size_t> lines(kFetchCacheLines, std::numeric_limits<size_t>::max());
+    size_t misses = 0, unique = 0, fetched = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        const uint32_t v = indices[i];
+        unique += !used[v];
+        used[v] = 1;
+        if (!cache.Miss(v))
+            continue;
+        ++misses;
+        const size_t begin = size_t(v) * vertexStride;
+        for (size_t line = begin / kFetchLineBytes;
+             line <= (begin + vertexStride - 1) / kFetchLineBytes; ++line) {
+            size_t &slot = lines[line % kFetchCacheLines];
+            if (slot != line) {
+                slot = line;
+                fetched += kFetchLineBytes;
+            }
+        }
+    }
+    result.acmr      = double(misses) / double(triangles);
+    result.atvr      = double(misses) / double(unique);
+    result.overdraw  = Overdraw(indices, indexCount, positions);
+    result.overfetch = double(fetched) / double(unique * vertexStride);
+    return result;
+}
+
+void OptimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount) {
+    const size_t triangles = indexCount / 3;
+    if (triangles < 2)
+        return;
+    static const ScoreTable score;
+
+    // Triangles of every vertex; the first remaining[v] entries of its list are not drawn yet.
+    std::vector<uint32_t> remaining(vertexCount, 0), first(vertexCount + 1, 0);
+    std::vector<uint32_t> adjacent(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+        ++remaining[indices[i]];
+    for (size_t v = 0; v < vertexCount; ++v)
+        first[v + 1] = first[v] + remaining[v];
+    {
+        std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+            adjacent[fill[indices[i]]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount), triangleScore(triangles, 0.0f);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = score(-1, remaining[v]);
+    for (size_t i = 0; i < indexCount; ++i)
+        triangleScore[i / 3] += vertexScore[indices[i]];
+
+    auto rescore = [&](uint32_t v) {
+        float s        = score(cachePosition[v], remaining[v]);
+        float d        = s - vertexScore[v];
+        vertexScore[v] = s;
+        for (uint32_t k = 0; k < remaining[v]; ++k)
+            triangleScore[adjacent[first[v] + k]] += d;
+    };
+
+    const size_t none = std::numeric_limits<size_t>::max();
+    std::vector<uint8_t> emitted(triangles, 0);
+    std::vector<uint32_t> order(indexCount);
+    uint32_t cache[kForsythCacheSize + 3];
+    int cacheCount = 0;
+    size_t cursor  = 0;
+    size_t best    = size_t(std::max_element(triangleScore.begin(), triangleScore.end()) -
+                         triangleScore.begin());
+    for (size_t k = 0; k < triangles; ++k) {
+        // Nothing in the cache has a triangle left: continue with the next one in input order.
+        if (best == none) {
+            while (emitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+        const uint32_t *tri = indices + best * 3;
+        std::copy(tri, tri + 3, order.begin() + k * 3);
+        emitted[best] = 1;
+        for (int j = 0; j < 3; ++j) {
+            uint32_t *list = &adjacent[first[tri[j]]];
+            uint32_t &n    = remaining[tri[j]];
+            for (uint32_t i = 0; i < n; ++i) {
+                if (list[i] == best) {
+                    std::swap(list[i], list[n - 1]);
+                    --n;
+                    break;
+                }
+            }
+        }
+
+        // LRU: the triangle's vertices move to the front, the rest keep their order.
+        uint32_t next[kForsythCacheSize + 3];
+        int nextCount = 0;
+        for (int j = 0; j < 3; ++j) {
+            if (std::find(next, next + nextCount, tri[j]) == next + nextCount)
+                next[nextCount++] = tri[j];
+        }
+        for (int i = 0; i < cacheCount; ++i) {
+            if (std::find(tri, tri + 3, cache[i]) == tri + 3)
+                next[nextCount++] = cache[i];
+        }
+        for (int i = kForsythCacheSize; i < nextCount; ++i) {
+            cachePosition[next[i]] = -1;
+            rescore(next[i]);
+        }
+        cacheCount = std::min(nextCount, kForsythCacheSize);
+        std::copy(next, next + cacheCount, cache);
+        for (int i = 0; i < cacheCount; ++i) {
+            cachePosition[cache[i]] = i;
+            rescore(cache[i]);
+        }
+
+        best            = none;
+        float bestScore = 0.0f;
+        for (int i = 0; i < cacheCount; ++i) {
+            const uint32_t v = cache[i];
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                uint32_t t = adjacent[first[v] + j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best      = t;
+                }
+            }
+        }
+    }
+    std::copy(order.begin(), order.end(), indices);
+}
+
+void OptimizeOverdraw(uint32_t *indices, size_t indexCount, const float *positions,
+                      size_t vertexCount, float threshold) {
+    const size_t triangles = indexCount / 3;
+    if (triangles < 2)
+        return;
+
+    // Hard boundaries where the order jumps (all three vertices miss the cache).
+    FifoCache cache(vertexCount);
+    std::vector<uint8_t> misses(triangles);
+    std::vector<size_t> hard;
+    for (size_t t = 0; t < triangles; ++t) {
+        misses[t] = uint8_t(cache.Miss(indices[t * 3]) + cache.Miss(indices[t * 3 + 1]) +
+                            cache.Miss(indices[t * 3 + 2]));
+        if (t == 0 || misses[t] == 3)
+            hard.push_back(t);
+    }
+    hard.push_back(triangles);
+
+    // Soft boundaries inside each run: a cluster ends as soon as its own ACMR, simulated from a
+    // cold cache, comes within `threshold` of the run's.
+    std::vector<size_t> bounds;
+    for (size_t r = 0; r + 1 < hard.size(); ++r) {
+        const size_t begin = hard[r], end = hard[r + 1];
+        size_t runMisses   = 0;
+        for (size_t t = begin; t < end; ++t)
+            runMisses += misses[t];
+        const double limit = threshold * double(runMisses) / double(end - begin);
+
+        bounds.push_back(begin);
+        cache.Flush();
+        size_t start = begin, clusterMisses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int j = 0; j < 3; ++j)
+                clusterMisses += cache.Miss(indices[t * 3 + j]);
+            if (t + 1 < end && double(clusterMisses) <= limit * double(t + 1 - start)) {
+                bounds.push_back(t + 1);
+                start         = t + 1;
+                clusterMisses = 0;
+                cache.Flush();
+            }
+        }
+    }
+    bounds.push_back(triangles);
+
+    // Clusters on the outside facing out are drawn first: they tend to hide the others.
+    Vec3 meshCentroid = {0, 0, 0};
+    double meshArea   = 0;
+    std::vector<Vec3> clusterCentroid(bounds.size() - 1), clusterNormal(bounds.size() - 1);
+    for (size_t c = 0; c + 1 < bounds.size(); ++c) {
+        Vec3 centroid = {0, 0, 0}, normal = {0, 0, 0};
+        double area   = 0;
+        for (size_t t = bounds[c]; t < bounds[c + 1]; ++t) {
+            Vec3 n, p;
+            Triangle(indices, positions, t, n, p);
+            double a = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            centroid = {centroid.x + p.x * a, centroid.y + p.y * a, centroid.z + p.z * a};
+            normal   = {normal.x + n.x, normal.y + n.y, normal.z + n.z};
+            area += a;
+        }
+        meshCentroid = {meshCentroid.x + centroid.x, meshCentroid.y + centroid.y,
+                        meshCentroid.z + centroid.z};
+        meshArea += area;
+        if (area > 0)
+            centroid = {centroid.x / area, centroid.y / area, centroid.z / area};
+        double length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length > 0)
+            normal = {normal.x / length, normal.y / length, normal.z / length};
+        clusterCentroid[c] = centroid;
+        clusterNormal[c]   = normal;
+    }
+    if (meshArea > 0)
+        meshCentroid = {meshCentroid.x / meshArea, meshCentroid.y / meshArea,
+                        meshCentroid.z / meshArea};
+
+    std::vector<double> facing(bounds.size() - 1);
+    std::vector<size_t> clusters(bounds.size() - 1);
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        const Vec3 &p = clusterCentroid[c], &n = clusterNormal[c];
+        Vec3 d        = {p.x - meshCentroid.x, p.y - meshCentroid.y, p.z - meshCentroid.z};
+        facing[c]     = d.x * n.x + d.y * n.y + d.z * n.z;
+        clusters[c]   = c;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [&](size_t a, size_t b) { return facing[a] > facing[b]; });
+
+    std::vector<uint32_t> order;
+    order.reserve(triangles * 3);
+    for (size_t c : clusters)
+        order.insert(order.end(), indices + bounds[c] * 3, indices + bounds[c + 1] * 3);
+    std::copy(order.begin(), order.end(), indices);
+}
+
+std::vector<uint32_t> OptimizeVertexFetch(uint32_t *indices, size_t indexCount,
+                                          size_t vertexCount) {
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertexCount, unused);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        uint32_t &v = remap[indices[i]];
+        if (v == unused)
+            v = next++;
+        indices[i] = v;
+    }
+    for (uint32_t &v : remap) {
+        if (v == unused)
+            v = next++;
+    }
+    return remap;
+}
\ No newline at end of file
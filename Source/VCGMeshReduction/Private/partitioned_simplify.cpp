@@ -0,0 +1,266 @@
+#include "decimation_session.h"
+#include "parallel.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+// Below this many faces per cluster the seams cost more than the parallelism gains.
+const size_t kMinFacesPerCluster = 20000;
+
+const int kSharedVertex = -2;
+
+struct Cluster {
+    MyMesh mesh;
+    std::vector<int> globalVert; // local vertex index -> vertex index in the input mesh
+    int targetCount = 0;
+};
+
+// Recursive median split of the face barycenters along the longest axis of their bounding box,
+// assigning [firstCluster, firstCluster + clusterCount) to the faces in [first, last).
+void SplitClusters(uint32_t *first, uint32_t *last, int firstCluster, int clusterCount,
+                   const std::vector<vcg::Point3f> &centers, std::vector<int> &faceCluster) {
+    if (clusterCount == 1) {
+        for (uint32_t *f = first; f != last; ++f)
+            faceCluster[*f] = firstCluster;
+        return;
+    }
+
+    vcg::Box3f box;
+    for (uint32_t *f = first; f != last; ++f)
+        box.Add(centers[*f]);
+    vcg::Point3f dim = box.Dim();
+    int axis         = (dim[0] >= dim[1] && dim[0] >= dim[2]) ? 0 : (dim[1] >= dim[2] ? 1 : 2);
+
+    int leftCount = clusterCount / 2;
+    uint32_t *mid = first + (last - first) * leftCount / clusterCount;
+    std::nth_element(first, mid, last,
+                     [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+    SplitClusters(first, mid, firstCluster, leftCount, centers, faceCluster);
+    SplitClusters(mid, last, firstCluster + leftCount, clusterCount - leftCount, centers,
+                  faceCluster);
+}
+
+// Copies the given faces of `m` into cluster.mesh. Vertices shared with other clusters are made
+// read-only so that the cluster session never moves or removes them, and so are the ones the
+// caller locked (`writable` false).
+void BuildCluster(const MyMesh &m, const std::vector<uint32_t> &faces,
+                  const std::vector<int> &vertCluster, const std::vector<char> &writable,
+                  Cluster &cluster) {
+    std::vector<int> &globalVert = cluster.globalVert;
+    globalVert.clear();
+    for (uint32_t f : faces) {
+        for (int j = 0; j < 3; ++j)
+            globalVert.push_back(int(m.face[f].cV(j) - &m.vert[0]));
+    }
+    std::sort(globalVert.begin(), globalVert.end());
+    globalVert.erase(std::unique(globalVert.begin(), globalVert.end()), globalVert.end());
+
+    MyMesh &sub = cluster.mesh;
+    vcg::tri::Allocator<MyMesh>::AddVertices(sub, globalVert.size());
+    for (size_t i = 0; i < globalVert.size(); ++i) {
+        const MyVertex &src = m.vert[globalVert[i]];
+        MyVertex &dst       = sub.vert[i];
+        dst.P()             = src.cP();
+        dst.N()             = src.cN();
+        dst.C()             = src.cC();
+        if (vertCluster[globalVert[i]] == kSharedVertex || !writable[globalVert[i]])
+            dst.ClearW();
+    }
+
+    vcg::tri::Allocator<MyMesh>::AddFaces(sub, faces.size());
+    for (size_t i = 0; i < faces.size(); ++i) {
+        const MyFace &src = m.face[faces[i]];
+        MyFace &dst       = sub.face[i];
+        for (int j = 0; j < 3; ++j) {
+            int g     = int(src.cV(j) - &m.vert[0]);
+            size_t l  = std::lower_bound(globalVert.begin(), globalVert.end(), g) -
+                       globalVert.begin();
+            dst.V(j)  = &sub.vert[l];
+            dst.WT(j) = src.cWT(j);
+        }
+        dst.N()   = src.cN();
+        dst.matId = src.matId;
+    }
+}
+
+} // namespace
+
+void SimplifyPartitioned(MyMesh &m, const Simplifier::Params &params, int targetCount,
+                         int threads) {
+    vcg::tri::Allocator<MyMesh>::CompactEveryVector(m);
+    const size_t fn = m.face.size();
+    const size_t vn = m.vert.size();
+
+    int clusterCount = (int)std::min<size_t>(size_t(threads), fn / kMinFacesPerCluster);
+    if (clusterCount < 2) {
+        DecimationSession session(m, params);
+        session.RunTo(targetCount);
+        session.Finalize();
+        return;
+    }
+
+    // The caller's locks: every pass below respects them, and they are what is left at the end.
+    std::vector<char> writable(vn);
+    for (size_t v = 0; v < vn; ++v)
+        writable[v] = m.vert[v].IsW();
+
+    // 1. Spatial clusters
+    std::vector<vcg::Point3f> centers(fn);
+    ParallelForRange(fn, threads, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            const MyFace &f = m.face[i];
+            centers[i]      = (f.cP(0) + f.cP(1) + f.cP(2)) / 3.0f;
+        }
+    });
+    std::vector<uint32_t> order(fn);
+    std::iota(order.begin(), order.end(), 0u);
+    std::vector<int> faceCluster(fn, 0);
+    SplitClusters(order.data(), order.data() + fn, 0, clusterCount, centers, faceCluster);
+
+    // 2. Vertices referenced by faces of more than one cluster form the cut and stay locked.
+    std::vector<int> vertCluster(vn, -1);
+    std::vector<std::vector<uint32_t>> clusterFaces(clusterCount);
+    for (size_t i = 0; i < fn; ++i) {
+        int c = faceCluster[i];
+        clusterFaces[c].push_back(uint32_t(i));
+        for (int j = 0; j < 3; ++j) {
+            int &owner = vertCluster[m.face[i].cV(j) - &m.vert[0]];
+            if (owner == -1)
+                owner = c;
+            else if (owner != c)
+                owner = kSharedVertex;
+        }
+    }
+
+    // 3. Simplify every cluster to its share of the target.
+    std::vector<Cluster> clusters(clusterCount);
+    const double ratio = double(targetCount) / double(fn);
+    ParallelForEach(clusters.size(), threads, [&](size_t c, int) {
+        Cluster &cluster = clusters[c];
+        BuildCluster(m, clusterFaces[c], vertCluster, writable, cluster);
+        cluster.targetCount = int(clusterFaces[c].size() * ratio);
+
+        Simplifier::Params clusterParams = params;
+        clusterParams.collapseLog        = nullptr;
+        clusterParams.threads            = 1; // the clusters already use every thread
+        DecimationSession session(cluster.mesh, clusterParams);
+        session.RunTo(cluster.targetCount);
+        session.Finalize();
+    });
+
+    // 4. Merge: locked vertices are shared, everything else comes from exactly one cluster.
+    MyMesh merged;
+    std::vector<int> sharedIndex(vn, -1);
+    size_t mergedVerts = 0;
+    size_t mergedFaces = 0;
+    for (size_t v = 0; v < vn; ++v) {
+        if (vertCluster[v] == kSharedVertex)
+            sharedIndex[v] = int(mergedVerts++);
+    }
+    for (const Cluster &cluster : clusters) {
+        for (size_t i = 0; i < cluster.mesh.vert.size(); ++i) {
+            if (!cluster.mesh.vert[i].IsD() &&
+                vertCluster[cluster.globalVert[i]] != kSharedVertex)
+                ++mergedVerts;
+        }
+        mergedFaces += cluster.mesh.fn;
+    }
+
+    vcg::tri::Allocator<MyMesh>::AddVertices(merged, mergedVerts);
+    vcg::tri::Allocator<MyMesh>::AddFaces(merged, mergedFaces);
+    std::vector<char> mergedWritable(mergedVerts, 1);
+    for (size_t v = 0; v < vn; ++v) {
+        if (sharedIndex[v] < 0)
+            continue;
+        MyVertex &dst                  = merged.vert[sharedIndex[v]];
+        dst.P()                        = m.vert[v].cP();
+        dst.C()                        = m.vert[v].cC();
+        mergedWritable[sharedIndex[v]] = writable[v];
+    }
+
+    size_t nextVert = std::count_if(sharedIndex.begin(), sharedIndex.end(),
+                                    [](int i) { return i >= 0; });
+    size_t nextFace = 0;
+    std::vector<int> localToMerged;
+    for (Cluster &cluster : clusters) {
+        MyMesh &sub = cluster.mesh;
+        localToMerged.assign(sub.vert.size(), -1);
+        for (size_t i = 0; i < sub.vert.size(); ++i) {
+            if (sub.vert[i].IsD())
+                continue;
+            int g = cluster.globalVert[i];
+            if (vertCluster[g] == kSharedVertex) {
+                localToMerged[i] = sharedIndex[g];
+            } else {
+                MyVertex &dst            = merged.vert[nextVert];
+                dst.P()                  = sub.vert[i].cP();
+                dst.C()                  = sub.vert[i].cC();
+                mergedWritable[nextVert] = writable[g];
+                localToMerged[i]         = int(nextVert++);
+            }
+        }
+        for (const MyFace &f : sub.face) {
+            if (f.IsD())
+                continue;
+            MyFace &dst = merged.face[nextFace++];
+            for (int j = 0; j < 3; ++j) {
+                dst.V(j)  = &merged.vert[localToMerged[f.cV(j) - &sub.vert[0]]];
+                dst.WT(j) = f.cWT(j);
+            }
+            dst.matId = f.matId;
+        }
+        sub.Clear();
+    }
+    Simplifier::CopyMesh(merged, m);
+    merged.Clear();
+    // CopyMesh keeps the vertex order (merged has no deleted vertices) but not the flags.
+    auto restoreLocks = [&]() {
+        for (size_t v = 0; v < m.vert.size(); ++v) {
+            if (mergedWritable[v])
+                m.vert[v].SetW();
+            else
+                m.vert[v].ClearW();
+        }
+    };
+    restoreLocks();
+
+    // 5. Seam pass: only the vertices within two rings of the former cut may collapse.
+    if (m.fn > targetCount) {
+        std::vector<char> region(m.vert.size(), 0);
+        for (size_t v = 0; v < vn; ++v) {
+            if (sharedIndex[v] >= 0)
+                region[sharedIndex[v]] = 1;
+        }
+        for (int ring = 0; ring < 2; ++ring) {
+            std::vector<char> grown(region);
+            for (const MyFace &f : m.face) {
+                int i0 = int(f.cV(0) - &m.vert[0]);
+                int i1 = int(f.cV(1) - &m.vert[0]);
+                int i2 = int(f.cV(2) - &m.vert[0]);
+                if (region[i0] || region[i1] || region[i2])
+                    grown[i0] = grown[i1] = grown[i2] = 1;
+            }
+            region.swap(grown);
+        }
+        for (size_t v = 0; v < m.vert.size(); ++v) {
+            if (!region[v])
+                m.vert[v].ClearW();
+        }
+
+        {
+            DecimationSession session(m, params);
+            session.RunTo(targetCount);
+            session.Finalize();
+        }
+
+        // The seams alone could not absorb the remaining collapses: open up the whole mesh.
+        restoreLocks();
+        if (m.fn > targetCount) {
+            DecimationSession session(m, params);
+            session.RunTo(targetCount);
+            session.Finalize();
+        }
+    }
+    restoreLocks();
+}
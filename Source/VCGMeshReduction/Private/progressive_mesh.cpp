@@ -0,0 +1,283 @@
+#include "progressive_mesh.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <vcg/complex/algorithms/update/normal.h>
+
+namespace {
+
+const char kMagic[4] = {'V', 'P', 'M', '2'};
+
+// Bytes per record on disk, for checking counts against the file size before allocating.
+const uint64_t kHeaderBytes   = 4 + 3 * 4;
+const uint64_t kVertexBytes   = 3 * 4 + 4;
+const uint64_t kFaceBytes     = 3 * 4 + 6 * 4 + 4;
+const uint64_t kCollapseBytes = 2 * 4 + 3 * 4 + 2 * 4; // without its faces and wedges
+const uint64_t kWedgeBytes    = 4 + 6 * 4;
+
+bool HostIsLittleEndian() {
+    const uint16_t probe = 1;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Elements are stored little endian: big endian hosts reverse the bytes of each one.
+void ReverseElements(unsigned char *bytes, size_t size, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        std::reverse(bytes + i * size, bytes + (i + 1) * size);
+}
+
+template <class T> bool Write(FILE *f, const T *data, size_t count) {
+    if (count == 0)
+        return true;
+    if (sizeof(T) == 1 || HostIsLittleEndian())
+        return fwrite(data, sizeof(T), count, f) == count;
+    std::vector<unsigned char> bytes(sizeof(T) * count);
+    std::memcpy(bytes.data(), data, bytes.size());
+    ReverseElements(bytes.data(), sizeof(T), count);
+    return fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+}
+
+template <class T> bool Read(FILE *f, T *data, size_t count) {
+    if (count == 0)
+        return true;
+    if (fread(data, sizeof(T), count, f) != count)
+        return false;
+    if (sizeof(T) > 1 && !HostIsLittleEndian())
+        ReverseElements(reinterpret_cast<unsigned char *>(data), sizeof(T), count);
+    return true;
+}
+
+} // namespace
+
+void ProgressiveMesh::Clear() {
+    positions.clear();
+    colors.clear();
+    indices.clear();
+    uvs.clear();
+    matIds.clear();
+    collapses.clear();
+    removedFaces.clear();
+    wedges.clear();
+}
+
+void ProgressiveMesh::SetBase(const MyMesh &m) {
+    Clear();
+    positions.reserve(m.vert.size() * 3);
+    colors.reserve(m.vert.size() * 4);
+    for (const MyVertex &v : m.vert) {
+        for (int k = 0; k < 3; ++k)
+            positions.push_back(v.cP()[k]);
+        for (int k = 0; k < 4; ++k)
+            colors.push_back(v.cC()[k]);
+    }
+
+    indices.reserve(m.face.size() * 3);
+    uvs.reserve(m.face.size() * 6);
+    matIds.reserve(m.face.size());
+    for (const MyFace &f : m.face) {
+        for (int j = 0; j < 3; ++j) {
+            indices.push_back(uint32_t(f.cV(j) - &m.vert[0]));
+            uvs.push_back(f.cWT(j).u());
+            uvs.push_back(f.cWT(j).v());
+        }
+        matIds.push_back(f.matId);
+    }
+}
+
+void ProgressiveMesh::AddCollapse(uint32_t kept, uint32_t removed, const vcg::Point3f &pos,
+                                  const std::vector<uint32_t> &deadFaces,
+                                  const std::vector<Wedge> &faceWedges) {
+    Collapse c;
+    c.kept             = kept;
+    c.removed          = removed;
+    c.pos[0]           = pos[0];
+    c.pos[1]           = pos[1];
+    c.pos[2]           = pos[2];
+    c.firstRemovedFace = uint32_t(removedFaces.size());
+    c.removedFaceCount = uint32_t(deadFaces.size());
+    c.firstWedge       = uint32_t(wedges.size());
+    c.wedgeCount       = uint32_t(faceWedges.size());
+    removedFaces.insert(removedFaces.end(), deadFaces.begin(), deadFaces.end());
+    wedges.insert(wedges.end(), faceWedges.begin(), faceWedges.end());
+    collapses.push_back(c);
+}
+
+size_t ProgressiveMesh::PrefixForFaceCount(size_t targetFaces) const {
+    size_t faces = FaceCount();
+    size_t k     = 0;
+    while (k < collapses.size() && faces > targetFaces) {
+        faces -= collapses[k].removedFaceCount;
+        ++k;
+    }
+    return k;
+}
+
+void ProgressiveMesh::Extract(size_t collapseCount, MyMesh &out) const {
+    collapseCount = std::min(collapseCount, collapses.size());
+
+    std::vector<float> pos(positions);
+    std::vector<uint32_t> idx(indices);
+    std::vector<float> uv(uvs);
+    std::vector<char> faceAlive(FaceCount(), 1);
+
+    for (size_t k = 0; k < collapseCount; ++k) {
+        const Collapse &c = collapses[k];
+        pos[c.kept * 3 + 0] = c.pos[0];
+        pos[c.kept * 3 + 1] = c.pos[1];
+        pos[c.kept * 3 + 2] = c.pos[2];
+        for (uint32_t i = 0; i < c.removedFaceCount; ++i)
+            faceAlive[removedFaces[c.firstRemovedFace + i]] = 0;
+        for (uint32_t i = 0; i < c.wedgeCount; ++i) {
+            const Wedge &w = wedges[c.firstWedge + i];
+            for (int j = 0; j < 3; ++j) {
+                if (idx[w.face * 3 + j] == c.removed)
+                    idx[w.face * 3 + j] = c.kept;
+            }
+            std::memcpy(&uv[w.face * 6], w.uv, sizeof(w.uv));
+        }
+    }
+
+    // Compact: keep only the vertices referenced by live faces.
+    std::vector<int> remap(VertexCount(), -1);
+    int vn = 0;
+    int fn = 0;
+    for (size_t f = 0; f < FaceCount(); ++f) {
+        if (!faceAlive[f])
+            continue;
+        ++fn;
+        for (int j = 0; j < 3; ++j) {
+            if (remap[idx[f * 3 + j]] < 0)
+                remap[idx[f * 3 + j]] = vn++;
+        }
+    }
+
+    out.Clear();
+    vcg::tri::Allocator<MyMesh>::AddVertices(out, vn);
+    vcg::tri::Allocator<MyMesh>::AddFaces(out, fn);
+    for (size_t v = 0; v < VertexCount(); ++v) {
+        if (remap[v] < 0)
+            continue;
+        MyVertex &ov = out.vert[remap[v]];
+        ov.P()       = vcg::Point3f(pos[v * 3], pos[v * 3 + 1], pos[v * 3 + 2]);
+        ov.C()       = vcg::Color4b(colors[v * 4], colors[v * 4 + 1], colors[v * 4 + 2],
+                                    colors[v * 4 + 3]);
+    }
+    int fi = 0;
+    for (size_t f = 0; f < FaceCount(); ++f) {
+        if (!faceAlive[f])
+            continue;
+        MyFace &of = out.face[fi++];
+        for (int j = 0; j < 3; ++j) {
+            of.V(j)  = &out.vert[remap[idx[f * 3 + j]]];
+            of.WT(j) = MyFace::TexCoordType(uv[f * 6 + j * 2], uv[f * 6 + j * 2 + 1]);
+        }
+        of.matId = matIds[f];
+    }
+
+    vcg::tri::UpdateBounding<MyMesh>::Box(out);
+    vcg::tri::UpdateNormal<MyMesh>::PerVertexNormalizedPerFaceNormalized(out);
+}
+
+bool ProgressiveMesh::Save(const std::string &filename) const {
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+        return false;
+
+    uint32_t header[3] = {uint32_t(VertexCount()), uint32_t(FaceCount()),
+                          uint32_t(collapses.size())};
+    bool ok = Write(f, kMagic, 4) && Write(f, header, 3);
+
+    for (size_t v = 0; ok && v < VertexCount(); ++v)
+        ok = Write(f, &positions[v * 3], 3) && Write(f, &colors[v * 4], 4);
+    for (size_t i = 0; ok && i < FaceCount(); ++i)
+        ok = Write(f, &indices[i * 3], 3) && Write(f, &uvs[i * 6], 6) && Write(f, &matIds[i], 1);
+
+    for (size_t k = 0; ok && k < collapses.size(); ++k) {
+        const Collapse &c = collapses[k];
+        uint32_t verts[2]  = {c.kept, c.removed};
+        uint32_t counts[2] = {c.removedFaceCount, c.wedgeCount};
+        ok = Write(f, verts, 2) && Write(f, c.pos, 3) && Write(f, counts, 2) &&
+             Write(f, removedFaces.data() + c.firstRemovedFace, c.removedFaceCount);
+        for (uint32_t i = 0; ok && i < c.wedgeCount; ++i) {
+            const Wedge &w = wedges[c.firstWedge + i];
+            ok             = Write(f, &w.face, 1) && Write(f, w.uv, 6);
+        }
+    }
+
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+bool ProgressiveMesh::Load(const std::string &filename, float minFaceRatio) {
+    Clear();
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(filename, ec);
+    FILE *f           = ec ? nullptr : fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+
+    // Every count and index is checked before it is used: Extract indexes with them.
+    char magic[4];
+    uint32_t header[3];
+    bool ok = Read(f, magic, 4) && std::memcmp(magic, kMagic, 4) == 0 && Read(f, header, 3);
+
+    uint64_t remaining = fileSize - std::min(fileSize, kHeaderBytes);
+    uint64_t baseBytes = ok ? header[0] * kVertexBytes + header[1] * kFaceBytes : 0;
+    if (ok && (baseBytes > remaining || header[2] * kCollapseBytes > remaining - baseBytes))
+        ok = false;
+    if (ok) {
+        positions.resize(size_t(header[0]) * 3);
+        colors.resize(size_t(header[0]) * 4);
+        indices.resize(size_t(header[1]) * 3);
+        uvs.resize(size_t(header[1]) * 6);
+        matIds.resize(header[1]);
+        remaining -= baseBytes;
+    }
+    for (size_t v = 0; ok && v < VertexCount(); ++v)
+        ok = Read(f, &positions[v * 3], 3) && Read(f, &colors[v * 4], 4);
+    for (size_t i = 0; ok && i < FaceCount(); ++i)
+        ok = Read(f, &indices[i * 3], 3) && Read(f, &uvs[i * 6], 6) && Read(f, &matIds[i], 1);
+    for (size_t i = 0; ok && i < indices.size(); ++i)
+        ok = indices[i] < VertexCount();
+
+    size_t faces    = FaceCount();
+    size_t minFaces = size_t(faces * double(minFaceRatio));
+    std::vector<uint32_t> dead;
+    std::vector<Wedge> faceWedges;
+    for (uint32_t k = 0; ok && k < header[2] && faces > minFaces; ++k) {
+        uint32_t verts[2];
+        float pos[3];
+        uint32_t counts[2];
+        ok = Read(f, verts, 2) && Read(f, pos, 3) && Read(f, counts, 2);
+        if (!ok)
+            break;
+        // counts[0] <= faces also keeps `faces -= dead.size()` from wrapping.
+        uint64_t bytes = kCollapseBytes + counts[0] * uint64_t(4) + counts[1] * kWedgeBytes;
+        if (verts[0] >= VertexCount() || verts[1] >= VertexCount() || counts[0] > faces ||
+            counts[1] > FaceCount() || bytes > remaining) {
+            ok = false;
+            break;
+        }
+        remaining -= bytes;
+        dead.resize(counts[0]);
+        faceWedges.resize(counts[1]);
+        ok = Read(f, dead.data(), dead.size());
+        for (size_t i = 0; ok && i < dead.size(); ++i)
+            ok = dead[i] < FaceCount();
+        for (Wedge &w : faceWedges)
+            ok = ok && Read(f, &w.face, 1) && Read(f, w.uv, 6) && w.face < FaceCount();
+        if (ok) {
+            AddCollapse(verts[0], verts[1], vcg::Point3f(pos[0], pos[1], pos[2]), dead, faceWedges);
+            faces -= dead.size();
+        }
+    }
+
+    fclose(f);
+    if (!ok)
+        Clear();
+    return ok;
+}
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "quadric_kernels.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VCG_QUADRIC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define VCG_TARGET_AVX2
+#define VCG_TARGET_AVX512
+#else
+#define VCG_TARGET_AVX2 __attribute__((target("avx2")))
+#define VCG_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#else
+#define VCG_QUADRIC_X86 0
+#endif
+
+// --- 二次误差核 ---
+// The vector kernels repeat the scalar expression operation by operation. GCC would fuse the
+// multiplies and adds into FMAs wherever the target allows it, so the build compiles this file
+// with -ffp-contract=off to keep all kernels bit-identical.
+
+namespace {
+
+typedef void (*ErrorFn)(const float *, const uint32_t *, const uint32_t *, const float *,
+                        const float *, const float *, size_t, size_t, float *);
+
+// Indices times 10 must fit the signed 32-bit offsets of the gathers.
+const size_t kMaxGatherQuadrics = size_t(INT32_MAX) / 10;
+
+float EvalScalar(const float *s, float px, float py, float pz) {
+    float e = px * (s[0] * px + 2.0f * (s[3] * py + s[4] * pz + s[6])) +
+              py * (s[1] * py + 2.0f * (s[5] * pz + s[7])) + pz * (s[2] * pz + 2.0f * s[8]) + s[9];
+    return e > 0.0f ? e : 0.0f;
+}
+
+void ErrorScalar(const float *q, const uint32_t *a, const uint32_t *b, const float *x,
+                 const float *y, const float *z, size_t begin, size_t n, float *out) {
+    for (size_t i = begin; i < n; ++i) {
+        out[i] = EvalScalar(q + size_t(a[i]) * 10, x[i], y[i], z[i]) +
+                 EvalScalar(q + size_t(b[i]) * 10, x[i], y[i], z[i]);
+    }
+}
+
+#if VCG_QUADRIC_X86
+
+// The operations of EvalScalar, in its order, on the quadrics at offsets idx (already times 10).
+VCG_TARGET_AVX2 inline __m256 EvalAvx2(const float *q, __m256i idx, __m256 px, __m256 py,
+                                       __m256 pz) {
+    const __m256 two = _mm256_set1_ps(2.0f);
+    __m256 s[10];
+    for (int k = 0; k < 10; ++k)
+        s[k] = _mm256_i32gather_ps(q + k, idx, 4);
+    __m256 e0 = _mm256_add_ps(_mm256_mul_ps(s[3], py), _mm256_mul_ps(s[4], pz));
+    e0        = _mm256_mul_ps(two, _mm256_add_ps(e0, s[6]));
+    e0        = _mm256_mul_ps(px, _mm256_add_ps(_mm256_mul_ps(s[0], px), e0));
+    __m256 e1 = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(s[5], pz), s[7]));
+    e1        = _mm256_mul_ps(py, _mm256_add_ps(_mm256_mul_ps(s[1], py), e1));
+    __m256 e2 = _mm256_mul_ps(two, s[8]);
+    e2        = _mm256_mul_ps(pz, _mm256_add_ps(_mm256_mul_ps(s[2], pz), e2));
+    __m256 e  = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(e0, e1), e2), s[9]);
+    return _mm256_max_ps(e, _mm256_setzero_ps());
+}
+
+VCG_TARGET_AVX2 void ErrorAvx2(const float *q, const uint32_t *a, const uint32_t *b,
+                               const float *x, const float *y, const float *z, size_t begin,
+                               size_t n, float *out) {
+    const __m256i ten = _mm256_set1_epi32(10);
+    size_t i          = begin;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i ia = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), ten);
+        const __m256i ib = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(b + i)), ten);
+        const __m256 px  = _mm256_loadu_ps(x + i);
+        const __m256 py  = _mm256_loadu_ps(y + i);
+        const __m256 pz  = _mm256_loadu_ps(z + i);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(EvalAvx2(q, ia, px, py, pz),
+                                                EvalAvx2(q, ib, px, py, pz)));
+    }
+    ErrorScalar(q, a, b, x, y, z, i, n, out);
+}
+
+VCG_TARGET_AVX512 inline __m512 EvalAvx512(const float *q, __m512i idx, __m512 px, __m512 py,
+                                           __m512 pz) {
+    const __m512 two = _mm512_set1_ps(2.0f);
+    __m512 s[10];
+    for (int k = 0; k < 10; ++k)
+        s[k] = _mm512_i32gather_ps(idx, q + k, 4);
+    __m512 e0 = _mm512_add_ps(_mm512_mul_ps(s[3], py), _mm512_mul_ps(s[4], pz));
+    e0        = _mm512_mul_ps(two, _mm512_add_ps(e0, s[6]));
+    e0        = _mm512_mul_ps(px, _mm512_add_ps(_mm512_mul_ps(s[0], px), e0));
+    __m512 e1 = _mm512_mul_ps(two, _mm512_add_ps(_mm512_mul_ps(s[5], pz), s[7]));
+    e1        = _mm512_mul_ps(py, _mm512_add_ps(_mm512_mul_ps(s[1], py), e1));
+    __m512 e2 = _mm512_mul_ps(two, s[8]);
+    e2        = _mm512_mul_ps(pz, _mm512_add_ps(_mm512_mul_ps(s[2], pz), e2));
+    __m512 e  = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(e0, e1), e2), s[9]);
+    return _mm512_max_ps(e, _mm512_setzero_ps());
+}
+
+VCG_TARGET_AVX512 void ErrorAvx512(const float *q, const uint32_t *a, const uint32_t *b,
+                                   const float *x, const float *y, const float *z, size_t begin,
+                                   size_t n, float *out) {
+    const __m512i ten = _mm512_set1_epi32(10);
+    size_t i          = begin;
+    for (; i + 16 <= n; i += 16) {
+        const __m512i ia = _mm512_mullo_epi32(_mm512_loadu_si512(a + i), ten);
+        const __m512i ib = _mm512_mullo_epi32(_mm512_loadu_si512(b + i), ten);
+        const __m512 px  = _mm512_loadu_ps(x + i);
+        const __m512 py  = _mm512_loadu_ps(y + i);
+        const __m512 pz  = _mm512_loadu_ps(z + i);
+        _mm512_storeu_ps(out + i, _mm512_add_ps(EvalAvx512(q, ia, px, py, pz),
+                                                EvalAvx512(q, ib, px, py, pz)));
+    }
+    ErrorScalar(q, a, b, x, y, z, i, n, out);
+}
+
+// CPUID leaf 7 feature bits, with the OS saving the register state they need (XCR0).
+bool CpuHas(QuadricKernel kernel) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27))) // OSXSAVE
+        return false;
+    unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (kernel == QuadricKernel::Avx2)
+        return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5));
+    return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16));
+#else
+    __builtin_cpu_init();
+    if (kernel == QuadricKernel::Avx2)
+        return __builtin_cpu_supports("avx2");
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#endif
+
+bool Supported(QuadricKernel kernel) {
+    switch (kernel) {
+    case QuadricKernel::Auto:
+    case QuadricKernel::Scalar:
+        return true;
+#if VCG_QUADRIC_X86
+    case QuadricKernel::Avx2:
+    case QuadricKernel::Avx512:
+        return CpuHas(kernel);
+#endif
+    default:
+        return false;
+    }
+}
+
+QuadricKernel Resolve(QuadricKernel kernel) {
+    if (kernel != QuadricKernel::Auto && Supported(kernel))
+        return kernel;
+    if (Supported(QuadricKernel::Avx512))
+        return QuadricKernel::Avx512;
+    if (Supported(QuadricKernel::Avx2))
+        return QuadricKernel::Avx2;
+    return QuadricKernel::Scalar;
+}
+
+ErrorFn Function(QuadricKernel kernel) {
+    switch (kernel) {
+#if VCG_QUADRIC_X86
+    case QuadricKernel::Avx2:
+        return ErrorAvx2;
+    case QuadricKernel::Avx512:
+        return ErrorAvx512;
+#endif
+    default:
+        return ErrorScalar;
+    }
+}
+
+std::atomic<QuadricKernel> &Active() {
+    static std::atomic<QuadricKernel> active(Resolve(QuadricKernel::Auto));
+    return active;
+}
+
+} // namespace
+
+bool QuadricKernelSupported(QuadricKernel kernel) { return Supported(kernel); }
+
+QuadricKernel SetQuadricKernel(QuadricKernel kernel) {
+    QuadricKernel resolved = Resolve(kernel);
+    Active().store(resolved, std::memory_order_relaxed);
+    return resolved;
+}
+
+QuadricKernel ActiveQuadricKernel() { return Active().load(std::memory_order_relaxed); }
+
+const char *QuadricKernelName(QuadricKernel kernel) {
+    switch (kernel) {
+    case QuadricKernel::Scalar:
+        return "scalar";
+    case QuadricKernel::Avx2:
+        return "avx2";
+    case QuadricKernel::Avx512:
+        return "avx512";
+    default:
+        return "auto";
+    }
+}
+
+void QuadricErrorBatch(const float *quadrics, size_t quadricCount, const uint32_t *a,
+                       const uint32_t *b, const float *x, const float *y, const float *z,
+                       size_t n, float *out) {
+    ErrorFn fn = quadricCount > kMaxGatherQuadrics ? ErrorScalar : Function(ActiveQuadricKernel());
+    fn(quadrics, a, b, x, y, z, 0, n, out);
+}
\ No newline at end of file
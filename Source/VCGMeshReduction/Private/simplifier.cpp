@@ -1,61 +1,12 @@
 #include "simplifier.h"
-#include <vcg/complex/algorithms/local_optimization.h>
-#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
-#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric_tex.h>
-
-void Simplifier::Clean(MyMesh &m) {
-    vcg::tri::Clean<MyMesh>::RemoveDuplicateVertex(m);
-    vcg::tri::Clean<MyMesh>::RemoveDuplicateFace(m);
-    vcg::tri::Clean<MyMesh>::RemoveDegenerateFace(m);
-    vcg::tri::Clean<MyMesh>::RemoveZeroAreaFace(m);
-    vcg::tri::Clean<MyMesh>::RemoveUnreferencedVertex(m);
-    vcg::tri::Allocator<MyMesh>::CompactEveryVector(m);
-}
-
-void Simplifier::Simplify(MyMesh &m, const Params &params) {
-    // Preprocess
-    vcg::tri::UpdateTopology<MyMesh>::VertexFace(m);
-    vcg::tri::UpdateTopology<MyMesh>::FaceFace(m);
-
-    vcg::tri::UpdateFlags<MyMesh>::FaceBorderFromVF(m);
-    // 简化
-    vcg::tri::UpdateNormal<MyMesh>::PerFace(m);
-    vcg::math::Quadric<double> QZero;
-    QZero.SetZero();
-    vcg::tri::QuadricTexHelper<MyMesh>::QuadricTemp TD3(m.vert, QZero);
-    vcg::tri::QuadricTexHelper<MyMesh>::TDp3() = &TD3;
-    std::vector<std::pair<vcg::TexCoord2<float>, vcg::Quadric5<double>>> qv;
-    vcg::tri::QuadricTexHelper<MyMesh>::Quadric5Temp TD(m.vert, qv);
-    vcg::tri::QuadricTexHelper<MyMesh>::TDp() = &TD;
-
-    // 简化参数
-    vcg::tri::TriEdgeCollapseQuadricTexParameter pp;
-    pp.SetDefaultParams();
-    pp.PreserveBoundary  = params.preserveBoundary;
-    pp.PreserveTopology  = params.preserveTopology;
-    pp.QualityThr        = params.qualityThr;
-    pp.ExtraTCoordWeight = params.extraTCoordWeight;
-    pp.BoundaryWeight    = params.boundaryWeight;
-    pp.NormalCheck       = params.normalCheck;
-    pp.OptimalPlacement  = params.optimalPlacement;
-
-    int targetCount = params.targetFaceCount;
-    if (targetCount < 0) {
-        targetCount = (int)(m.fn * params.ratio);
-    }
+#include "decimation_session.h"
+#include "parallel.h"
+#include <algorithm>
+#include <numeric>
 
-    vcg::LocalOptimization<MyMesh> DeciSession(m, &pp);
-    DeciSession.Init<MyCollapse>();
-    DeciSession.SetTargetSimplices(targetCount);
-    DeciSession.SetTimeBudget(0.1f);
+namespace {
 
-    while (DeciSession.DoOptimization() && m.fn > targetCount) {
-        // 可以在这里添加进度更新的回调
-    }
-    DeciSession.Finalize<MyCollapse>();
-    vcg::tri::QuadricTexHelper<MyMesh>::TDp()  = nullptr;
-    vcg::tri::QuadricTexHelper<MyMesh>::TDp3() = nullptr;
-    // 更新法线
+void UpdateNormals(MyMesh &m) {
     vcg::tri::UpdateBounding<MyMesh>::Box(m);
     if (m.fn > 0) {
         vcg::tri::UpdateNormal<MyMesh>::PerFaceNormalized(m);
@@ -65,3 +16,230 @@ void Simplifier::Simplify(MyMesh &m, const Params &params) {
     vcg::tri::UpdateNormal<MyMesh>::PerVertexFromCurrentFaceNormal(m);
     vcg::tri::UpdateNormal<MyMesh>::NormalizePerVertex(m);
 }
+
+int TargetFaceCount(const MyMesh &m, const Simplifier::Params &params) {
+    return params.targetFaceCount < 0 ? (int)(m.fn * params.ratio) : params.targetFaceCount;
+}
+
+} // namespace
+
+template <class Self, class VcgCollapse, class Parameter>
+void MyCollapseBase<Self, VcgCollapse, Parameter>::Execute(MyMesh &m,
+                                                           vcg::BaseParameterClass *_pp) {
+    Parameter *pp = static_cast<Parameter *>(_pp);
+    if (!pp->skin) {
+        ExecuteAndRecord(m, pp);
+        return;
+    }
+
+    MyVertex *v0          = this->pos.V(0);
+    MyVertex *v1          = this->pos.V(1);
+    const vcg::Point3f p0 = v0->cP();
+    const vcg::Point3f e  = v1->cP() - p0;
+    const SkinWeights s0  = (*pp->skin)[*v0];
+    const SkinWeights s1  = (*pp->skin)[*v1];
+
+    ExecuteAndRecord(m, pp);
+
+    // Blend at the parameter of the new position projected onto the collapsed edge.
+    MyVertex *kept = v0->IsD() ? v1 : v0;
+    float length2  = e.SquaredNorm();
+    float t        = length2 > 0 ? ((kept->cP() - p0) * e) / length2 : 0.5f;
+
+    (*pp->skin)[*kept] = SkinWeights::Blend(s0, s1, std::min(std::max(t, 0.0f), 1.0f),
+                                           pp->maxInfluences);
+}
+
+template <class Self, class VcgCollapse, class Parameter>
+void MyCollapseBase<Self, VcgCollapse, Parameter>::ExecuteAndRecord(MyMesh &m, Parameter *pp) {
+    ProgressiveMesh *log       = pp->collapseLog;
+    CollapseCounters *counters = MyQuadricHelper::Counters();
+    if (!log && !counters) {
+        Base::Execute(m, pp);
+        return;
+    }
+
+    // Faces around both endpoints: the ones on the edge get deleted, the others end up
+    // referencing the surviving vertex with updated wedge UVs.
+    MyVertex *v0 = this->pos.V(0);
+    MyVertex *v1 = this->pos.V(1);
+    std::vector<MyFace *> star;
+    for (MyVertex *v : {v0, v1}) {
+        for (vcg::face::VFIterator<MyFace> vfi(v); !vfi.End(); ++vfi) {
+            if (std::find(star.begin(), star.end(), vfi.F()) == star.end())
+                star.push_back(vfi.F());
+        }
+    }
+    std::vector<vcg::Point3f> normalsBefore;
+    vcg::math::Quadric<double> quadric;
+    if (counters) {
+        for (MyFace *f : star)
+            normalsBefore.push_back(vcg::TriangleNormal(*f).Normalize());
+        quadric = GeometricQuadric();
+    }
+
+    Base::Execute(m, pp);
+
+    if (counters) {
+        ++counters->performed;
+        const MyVertex *kept   = v0->IsD() ? v1 : v0;
+        counters->maxDeviation =
+            std::max(counters->maxDeviation, QuadricDistance(quadric, kept->cP()));
+
+        bool flipped = false, lowQuality = false;
+        for (size_t i = 0; i < star.size(); ++i) {
+            MyFace *f = star[i];
+            if (f->IsD())
+                continue;
+            flipped |= vcg::TriangleNormal(*f).Normalize() * normalsBefore[i] < pp->CosineThr;
+            lowQuality |= vcg::QualityRadii(f->cP(0), f->cP(1), f->cP(2)) < pp->QualityThr;
+        }
+        counters->normalFlips += flipped;
+        counters->lowQuality += lowQuality;
+    }
+    if (!log)
+        return;
+
+    MyVertex *kept    = v0->IsD() ? v1 : v0;
+    MyVertex *removed = v0->IsD() ? v0 : v1;
+    std::vector<uint32_t> deadFaces;
+    std::vector<ProgressiveMesh::Wedge> faceWedges;
+    for (MyFace *f : star) {
+        uint32_t fi = uint32_t(vcg::tri::Index(m, f));
+        if (f->IsD()) {
+            deadFaces.push_back(fi);
+            continue;
+        }
+        ProgressiveMesh::Wedge w;
+        w.face = fi;
+        for (int j = 0; j < 3; ++j) {
+            w.uv[j * 2]     = f->WT(j).u();
+            w.uv[j * 2 + 1] = f->WT(j).v();
+        }
+        faceWedges.push_back(w);
+    }
+    log->AddCollapse(uint32_t(vcg::tri::Index(m, kept)), uint32_t(vcg::tri::Index(m, removed)),
+                     kept->P(), deadFaces, faceWedges);
+}
+
+template class MyCollapseBase<MyCollapse, VcgTexCollapse, MyCollapseParameter>;
+template class MyCollapseBase<MyGeoCollapse, VcgGeoCollapse, MyGeoCollapseParameter>;
+
+Simplifier::Session::Session(MyMesh &m, const Params &params)
+    : m(m), stats(params.stats), startFaces(m.fn), targetCount(TargetFaceCount(m, params)),
+      session(new DecimationSession(m, params)) {}
+
+Simplifier::Session::~Session() {}
+
+bool Simplifier::Session::Step(double budgetMs) {
+    if (!session || Cancelled())
+        return false;
+    bool more = session->Step(targetCount, float(budgetMs / 1000.0));
+    if (startFaces > targetCount) {
+        float done = float(startFaces - m.fn) / float(startFaces - targetCount);
+        progress.store(std::min(std::max(done, 0.0f), 1.0f), std::memory_order_relaxed);
+    }
+    if (!more)
+        progress.store(1.0f, std::memory_order_relaxed);
+    return more && !Cancelled();
+}
+
+bool Simplifier::Session::Finish() {
+    if (session) {
+        session->Finalize();
+        session.reset();
+        VCG_TRACE_SCOPE("Normals");
+        PhaseTimer timer(stats, &Stats::normalsMs, "normals");
+        UpdateNormals(m);
+    }
+    return !Cancelled() || m.fn <= targetCount;
+}
+
+void Simplifier::Simplify(MyMesh &m, const Params &params) {
+    int targetCount = TargetFaceCount(m, params);
+
+    // Collapse logs refer to the vertices of one session and clusters do not carry skin weights,
+    // so both always take a single session. The independent-set engine parallelizes the session
+    // itself instead.
+    int threads = ResolveThreadCount(params.threads);
+    if (threads > 1 && !params.collapseLog && params.engine == Engine::Serial &&
+        !vcg::tri::HasPerVertexAttribute(m, SkinWeights::kAttribute)) {
+        VCG_TRACE_SCOPE("Partitioned");
+        PhaseTimer timer(params.stats, &Stats::collapseMs, "partitioned");
+        Params partitioned = params;
+        partitioned.stats  = nullptr;
+        SimplifyPartitioned(m, partitioned, targetCount, threads);
+    } else {
+        DecimationSession session(m, params);
+        session.RunTo(targetCount);
+        session.Finalize();
+    }
+    // 更新法线
+    VCG_TRACE_SCOPE("Normals");
+    PhaseTimer timer(params.stats, &Stats::normalsMs, "normals");
+    UpdateNormals(m);
+}
+
+void Simplifier::SimplifyChain(MyMesh &m, const std::vector<int> &targets,
+                               const LevelCallback &onLevel, const Params &params) {
+    if (targets.empty())
+        return;
+
+    // Visit the levels from the finest to the coarsest one.
+    std::vector<size_t> order(targets.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return targets[a] > targets[b]; });
+
+    {
+        DecimationSession session(m, params);
+        MyMesh lod;
+        for (size_t level : order) {
+            session.RunTo(targets[level]);
+            if (onLevel) {
+                CopyMesh(m, lod);
+                UpdateNormals(lod);
+                onLevel(level, lod);
+            }
+        }
+        session.Finalize();
+    }
+    VCG_TRACE_SCOPE("Normals");
+    PhaseTimer timer(params.stats, &Stats::normalsMs, "normals");
+    UpdateNormals(m);
+}
+
+void Simplifier::CopyMesh(const MyMesh &src, MyMesh &dst) {
+    dst.Clear();
+    if (src.vn == 0)
+        return;
+
+    std::vector<int> remap(src.vert.size(), -1);
+    vcg::tri::Allocator<MyMesh>::AddVertices(dst, src.vn);
+    int vi = 0;
+    for (size_t i = 0; i < src.vert.size(); ++i) {
+        const MyVertex &sv = src.vert[i];
+        if (sv.IsD())
+            continue;
+        MyVertex &dv = dst.vert[vi];
+        dv.P()       = sv.cP();
+        dv.N()       = sv.cN();
+        dv.C()       = sv.cC();
+        remap[i]     = vi++;
+    }
+
+    vcg::tri::Allocator<MyMesh>::AddFaces(dst, src.fn);
+    int fi = 0;
+    for (const MyFace &sf : src.face) {
+        if (sf.IsD())
+            continue;
+        MyFace &df = dst.face[fi++];
+        for (int j = 0; j < 3; ++j) {
+            df.V(j)  = &dst.vert[remap[sf.cV(j) - &src.vert[0]]];
+            df.WT(j) = sf.cWT(j);
+        }
+        df.N()   = sf.cN();
+        df.matId = sf.matId;
+    }
+    dst.bbox = src.bbox;
+}
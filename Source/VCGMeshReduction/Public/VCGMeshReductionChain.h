@@ -0,0 +1,22 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FMeshDescription;
+struct FMeshReductionSettings;
+
+/**
+ * Builds all LODs described by Settings from one VCG decimation session instead of reducing the
+ * source mesh once per LOD. OutReducedMeshes[i] receives the mesh for Settings[i]; only
+ * PercentTriangles may differ between the entries.
+ */
+VCGMESHREDUCTION_API void VCGReduceMeshDescriptionChain(const FMeshDescription &InMesh,
+                                                        const TArray<FMeshReductionSettings> &Settings,
+                                                        TArray<FMeshDescription> &OutReducedMeshes);
+
+/**
+ * Cancels every static mesh reduction running at the time of the call, e.g. because the settings
+ * it was started with changed. Cancelled reductions return the partially reduced mesh; call it
+ * before kicking off the rebuild with the new settings.
+ */
+VCGMESHREDUCTION_API void VCGCancelMeshReductions();
\ No newline at end of file
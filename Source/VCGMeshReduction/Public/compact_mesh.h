@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mymesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure-of-arrays triangle mesh with 32-bit indices: the memory-lean alternative to MyMesh
+// for the decimation core. It stores only what the pipeline reads and writes, with no normals,
+// marks, flags or adjacency pointers, which comes to 40 bytes per face plus 16 per vertex
+// (about 48 per face on a closed mesh). Simplifier::Simplify(CompactMesh &) builds the
+// adjacency it needs itself and drops it again when done.
+struct CompactMesh {
+    std::vector<float> positions;  // 3 per vertex
+    std::vector<uint32_t> colors;  // 1 per vertex, RGBA8 with R in the low byte
+    std::vector<uint32_t> indices; // 3 per face
+    std::vector<float> uvs;        // 6 per face: u, v of each corner
+    std::vector<int32_t> matIds;   // 1 per face
+
+    size_t VertexCount() const { return positions.size() / 3; }
+    size_t FaceCount() const { return matIds.size(); }
+
+    void Clear();
+    // New elements are zeroed, with white vertex colors.
+    void Resize(size_t vertexCount, size_t faceCount);
+    // Bytes held by the arrays (capacity, not size).
+    size_t MemoryBytes() const;
+    // Keeps the faces with a nonzero `keepFace` entry and the vertices they use, in order, and
+    // releases the spare capacity.
+    void Compact(const std::vector<uint8_t> &keepFace);
+
+    static uint32_t PackColor(const vcg::Color4b &c) {
+        return uint32_t(c[0]) | uint32_t(c[1]) << 8 | uint32_t(c[2]) << 16 | uint32_t(c[3]) << 24;
+    }
+    static vcg::Color4b UnpackColor(uint32_t c) {
+        return vcg::Color4b(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF, c >> 24);
+    }
+};
+
+// Copies the live part of `src` into `dst`.
+void ToCompactMesh(const MyMesh &src, CompactMesh &dst);
+// Replaces `dst` with `src`, with the bounding box and normals updated.
+void FromCompactMesh(const CompactMesh &src, MyMesh &dst);
\ No newline at end of file
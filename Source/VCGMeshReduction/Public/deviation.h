@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mymesh.h"
+#include <cstdint>
+#include <map>
+
+// Surface deviation between two meshes in the manner of Metro: points are sampled uniformly over
+// the area of one mesh and their distance to the other surface is found with closest-point
+// queries against a BVH, on several threads. Sampling is deterministic for a given seed. The
+// maxima are sample estimates of the Hausdorff distance, so they converge from below as the
+// sample count grows.
+class Deviation {
+  public:
+    struct Distance {
+        double max     = 0.0;
+        double mean    = 0.0;
+        double rms     = 0.0;
+        size_t samples = 0;
+    };
+
+    // Distances of the samples taken on one mesh, overall and by the matId of the sampled face.
+    struct OneSided {
+        Distance all;
+        std::map<int, Distance> byMaterial;
+    };
+
+    struct Result {
+        OneSided forward;       // samples on `a`, distances to `b`
+        OneSided backward;      // samples on `b`, distances to `a`
+        double hausdorff = 0.0; // symmetric: the larger of both one-sided maxima
+        double rms       = 0.0; // over the samples of both directions
+        double diagonal  = 0.0; // bounding box diagonal of `a`, to read the distances relatively
+    };
+
+    struct Params {
+        size_t samples = 1000000; // per direction, spread over the faces by area
+        int threads    = 0;       // 0 uses every hardware thread
+        uint32_t seed  = 1;
+    };
+
+    // Compares the live faces of `a` (usually the original) and `b` (the simplified mesh).
+    static Result Measure(const MyMesh &a, const MyMesh &b, const Params &params = Params());
+};
\ No newline at end of file
@@ -1,9 +1,17 @@
 #pragma once
+#include "skin_weights.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
 // VCG Headers
 #include <vcg/complex/complex.h>
 
 // Algorithms
 #include <vcg/complex/algorithms/edge_collapse.h>
+#include <vcg/complex/algorithms/local_optimization.h>
+#include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric_tex.h>
 
 // 引入 SimpleTempData 用于管理临时数据 [MeshLab 关键依赖]
@@ -28,13 +36,361 @@ class MyFace : public vcg::Face<MyUsedTypes, vcg::face::VertexRef, vcg::face::No
 class MyEdge : public vcg::Edge<MyUsedTypes> {};
 class MyMesh
     : public vcg::tri::TriMesh<std::vector<MyVertex>, std::vector<MyFace>, std::vector<MyEdge>> {};
+typedef MyMesh::PerVertexAttributeHandle<SkinWeights> SkinHandle;
 
 // --- 3. 简化类定义 ---
+struct ProgressiveMesh;
+
+// What happened to the candidate collapses of a decimation session (see Simplifier::Stats).
+// vcglib only rejects a collapse for topology; boundary edges never enter the heap (their
+// vertices are locked) and normal flips or bad triangles only raise the priority, so those two
+// count collapses that were performed anyway once nothing cheaper was left.
+struct CollapseCounters {
+    uint64_t performed      = 0; // executed collapses
+    uint64_t stalePops      = 0; // heap entries dropped because an endpoint changed since
+    uint64_t topologyReject = 0; // failed the link condition (PreserveTopology)
+    uint64_t errorReject    = 0; // estimated error above MyCollapseParameter::maxError
+    uint64_t normalFlips    = 0; // performed although a face normal turned past CosineThr
+    uint64_t lowQuality     = 0; // performed although a face ended below QualityThr
+    uint64_t heapHighWater  = 0; // largest heap size seen
+    double maxDeviation     = 0.0; // largest geometric error of a performed collapse
+};
+
+// Options and per-session sinks both collapse instantiations report to.
+struct MyCollapseOptions {
+    ProgressiveMesh *collapseLog = nullptr; // records every executed collapse when set
+    double maxError              = 0.0;     // rejects collapses estimated above it (0 = off)
+    SkinHandle *skin             = nullptr; // skin weights of a skinned mesh, blended on collapse
+    double skinWeight            = 1.0;     // priority penalty scale for differing skin weights
+    int maxInfluences            = SkinWeights::kMaxInfluences; // per blended vertex
+};
+
+// Parameters of MyCollapse (texture-aware) and MyGeoCollapse (geometry only).
+struct MyCollapseParameter : public vcg::tri::TriEdgeCollapseQuadricTexParameter,
+                             public MyCollapseOptions {};
+struct MyGeoCollapseParameter : public vcg::tri::TriEdgeCollapseQuadricParameter,
+                                public MyCollapseOptions {};
+
+// QuadricTexHelper publishes the quadric temporaries through process-wide statics. This helper
+// keeps the same interface but stores the pointers per thread, so independent decimation
+// sessions can run concurrently. Every function that touches the storage is redeclared here,
+// which hides the static-based versions of the base class.
+//
+// Besides the quadrics, a session owns one version counter per vertex that MyCollapse uses to
+// detect stale heap entries (see MyCollapse::IsUpToDate), and optionally the counters its
+// collapses report to.
+class MyQuadricHelper : public vcg::tri::QuadricTexHelper<MyMesh> {
+  public:
+    typedef std::vector<std::pair<vcg::TexCoord2f, vcg::Quadric5<double>>> WedgeQuadrics;
+    typedef vcg::SimpleTempData<MyMesh::VertContainer, unsigned int> VersionTemp;
+
+    // Publishes the temporaries of one session on the current thread and restores whatever was
+    // published before when it goes out of scope, so sessions may nest (e.g. a LOD chain
+    // callback that simplifies another mesh).
+    class Scope {
+      public:
+        Scope(QuadricTemp *td3, Quadric5Temp *td, VersionTemp *tdv,
+              CollapseCounters *counters = nullptr)
+            : prevTD3(TDp3()), prevTD(TDp()), prevTDv(TDpVersion()), prevCounters(Counters()) {
+            TDp3()       = td3;
+            TDp()        = td;
+            TDpVersion() = tdv;
+            Counters()   = counters;
+        }
+        ~Scope() {
+            TDp3()       = prevTD3;
+            TDp()        = prevTD;
+            TDpVersion() = prevTDv;
+            Counters()   = prevCounters;
+        }
+        Scope(const Scope &)            = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        QuadricTemp *prevTD3;
+        Quadric5Temp *prevTD;
+        VersionTemp *prevTDv;
+        CollapseCounters *prevCounters;
+    };
+
+    static QuadricTemp *&TDp3() {
+        thread_local QuadricTemp *td3 = nullptr;
+        return td3;
+    }
+    static QuadricTemp &TD3() { return *TDp3(); }
+    static Quadric5Temp *&TDp() {
+        thread_local Quadric5Temp *td = nullptr;
+        return td;
+    }
+    static Quadric5Temp &TD() { return *TDp(); }
+    static VersionTemp *&TDpVersion() {
+        thread_local VersionTemp *tdv = nullptr;
+        return tdv;
+    }
+    static unsigned int &Version(MyVertex *v) { return (*TDpVersion())[*v]; }
+    // Null when the session does not collect statistics.
+    static CollapseCounters *&Counters() {
+        thread_local CollapseCounters *counters = nullptr;
+        return counters;
+    }
+
+    static vcg::math::Quadric<double> &Qd3(MyVertex *v) { return TD3()[*v]; }
+    static vcg::math::Quadric<double> &Qd3(const MyVertex &v) { return TD3()[v]; }
+    static WedgeQuadrics &Vd(MyVertex *v) { return TD()[*v]; }
+
+    // The QInfoStandard interface of TriEdgeCollapseQuadric, over the same plane quadrics, so
+    // MyGeoCollapse runs on this helper without the wedge temporaries.
+    static void Init() {}
+    static vcg::math::Quadric<double> &Qd(MyVertex &v) { return TD3()[v]; }
+    static vcg::math::Quadric<double> &Qd(MyVertex *v) { return TD3()[*v]; }
+    static MyMesh::ScalarType W(MyVertex *) { return 1; }
+    static MyMesh::ScalarType W(MyVertex &) { return 1; }
+    static void Merge(MyVertex &, MyVertex const &) {}
+
+    static void Alloc(MyVertex *v, vcg::TexCoord2f &coord) {
+        vcg::Quadric5<double> q5;
+        q5.Zero();
+        q5.Sum3(Qd3(v), coord.u(), coord.v());
+        Vd(v).push_back(std::make_pair(vcg::TexCoord2f(coord.u(), coord.v()), q5));
+    }
+
+    static void SumAll(MyVertex *v, vcg::TexCoord2f &coord, vcg::Quadric5<double> &q) {
+        WedgeQuadrics &qv = Vd(v);
+        for (size_t i = 0; i < qv.size(); ++i) {
+            vcg::TexCoord2f &f = qv[i].first;
+            if (f.u() == coord.u() && f.v() == coord.v())
+                qv[i].second += q;
+            else
+                qv[i].second.Sum3(Qd3(v), f.u(), f.v());
+        }
+    }
+
+    static bool Contains(MyVertex *v, vcg::TexCoord2f &coord) {
+        for (const auto &w : Vd(v)) {
+            if (w.first.u() == coord.u() && w.first.v() == coord.v())
+                return true;
+        }
+        return false;
+    }
+
+    static vcg::Quadric5<double> &Qd(MyVertex *v, const vcg::TexCoord2f &coord) {
+        WedgeQuadrics &qv = Vd(v);
+        for (size_t i = 0; i < qv.size(); ++i) {
+            if (qv[i].first.u() == coord.u() && qv[i].first.v() == coord.v())
+                return qv[i].second;
+        }
+        assert(0);
+        return qv[0].second;
+    }
+};
+
 typedef vcg::tri::BasicVertexPair<MyVertex> MyVertexPair;
-class MyCollapse : public vcg::tri::TriEdgeCollapseQuadricTex<MyMesh, MyVertexPair, MyCollapse,
-                                                              vcg::tri::QuadricTexHelper<MyMesh>> {
+
+// Stand-in collapse that only records its vertex pair. vcglib's Init run with it as the collapse
+// type locks the border, fills the quadrics and lists the candidate edges in vcglib's order
+// without scoring them, so DecimationSession can score them on several threads.
+class MyPendingCollapse : public vcg::LocalModification<MyMesh> {
+  public:
+    MyPendingCollapse(const MyVertexPair &p, int, vcg::BaseParameterClass *) : pair(p) {}
+
+    vcg::ModifierType IsOfType() override { return vcg::TriEdgeCollapseOp; }
+    bool IsUpToDate() const override { return false; }
+    bool IsFeasible(vcg::BaseParameterClass *) override { return false; }
+    ScalarType ComputePriority(vcg::BaseParameterClass *) override { return 0; }
+    ScalarType Priority() const override { return 0; }
+    void Execute(MyMesh &, vcg::BaseParameterClass *) override {}
+    void UpdateHeap(HeapType &, vcg::BaseParameterClass *) override {}
+
+    MyVertexPair pair;
+};
+
+class MyCollapse;
+class MyGeoCollapse;
+typedef vcg::tri::TriEdgeCollapseQuadricTex<MyMesh, MyVertexPair, MyCollapse, MyQuadricHelper>
+    VcgTexCollapse;
+typedef vcg::tri::TriEdgeCollapseQuadric<MyMesh, MyVertexPair, MyGeoCollapse, MyQuadricHelper>
+    VcgGeoCollapse;
+
+// What MyCollapse and MyGeoCollapse add to the vcglib collapse they derive from: per-session
+// staleness, counters, the maxError limit, skin weights and the collapse log. Execute is
+// defined in simplifier.cpp, which instantiates both.
+template <class Self, class VcgCollapse, class Parameter>
+class MyCollapseBase : public VcgCollapse {
   public:
-    using vcg::tri::TriEdgeCollapseQuadricTex<
-        MyMesh, MyVertexPair, MyCollapse,
-        vcg::tri::QuadricTexHelper<MyMesh>>::TriEdgeCollapseQuadricTex;
+    typedef VcgCollapse Base;
+    typedef Parameter ParameterType;
+    typedef vcg::LocalOptimization<MyMesh>::HeapType HeapType;
+
+    // The base constructor computes the quadric priority (ComputePriority is not virtual there),
+    // so the skinning penalty is added here.
+    MyCollapseBase(const MyVertexPair &p, int mark, vcg::BaseParameterClass *pp)
+        : Base(p, mark, pp) {
+        version[0] = MyQuadricHelper::Version(this->pos.V(0));
+        version[1] = MyQuadricHelper::Version(this->pos.V(1));
+        this->_priority += SkinPenalty(static_cast<Parameter *>(pp));
+    }
+
+    // vcglib tracks staleness with TriEdgeCollapse::GlobalMark(), a process-wide counter that
+    // concurrent sessions would race on. MyCollapse instead compares the per-session vertex
+    // versions captured at construction, which Requeue bumps before queuing new collapses.
+    // An entry found stale is dropped by the caller, so each one is counted once.
+    bool IsUpToDate() const override {
+        const MyVertex *v0 = this->pos.cV(0);
+        const MyVertex *v1 = this->pos.cV(1);
+        bool upToDate =
+            !v0->IsD() && !v1->IsD() &&
+            version[0] == MyQuadricHelper::Version(const_cast<MyVertex *>(v0)) &&
+            version[1] == MyQuadricHelper::Version(const_cast<MyVertex *>(v1));
+        if (!upToDate && MyQuadricHelper::Counters())
+            ++MyQuadricHelper::Counters()->stalePops;
+        return upToDate;
+    }
+
+    bool IsFeasible(vcg::BaseParameterClass *pp) override {
+        CollapseCounters *counters = MyQuadricHelper::Counters();
+        if (!Base::IsFeasible(pp)) {
+            if (counters)
+                ++counters->topologyReject;
+            return false;
+        }
+        Parameter *params = static_cast<Parameter *>(pp);
+        if (params->maxError > 0 && EstimatedError(params->OptimalPlacement) > params->maxError) {
+            if (counters)
+                ++counters->errorReject;
+            return false;
+        }
+        return true;
+    }
+
+    // Base::UpdateHeap would increment GlobalMark(), so the requeue is done here instead.
+    void UpdateHeap(HeapType &h, vcg::BaseParameterClass *pp) override {
+        std::vector<MyVertexPair> pairs;
+        Requeue(this->pos, *static_cast<Parameter *>(pp), pairs);
+        for (const MyVertexPair &pair : pairs) {
+            h.push_back(typename HeapType::value_type(new Self(pair, 0, pp)));
+            std::push_heap(h.begin(), h.end());
+        }
+        if (CollapseCounters *counters = MyQuadricHelper::Counters())
+            counters->heapHighWater = std::max<uint64_t>(counters->heapHighWater, h.size());
+    }
+
+    // What vcglib's UpdateHeap does after `collapsed` was performed, without GlobalMark(): bumps
+    // the version of the surviving vertex (V(1)) and of its whole one-ring, so every queued
+    // collapse touching them goes stale, and appends the candidates around the survivor to
+    // `pairs` in vcglib's order and directions (see Self::QueueBothWays and
+    // Self::QueueOppositeEdges). The caller scores and queues them.
+    static void Requeue(MyVertexPair collapsed, const Parameter &params,
+                        std::vector<MyVertexPair> &pairs) {
+        MyVertex *survivor = collapsed.V(1);
+        ++MyQuadricHelper::Version(survivor);
+        for (vcg::face::VFIterator<MyFace> vfi(survivor); !vfi.End(); ++vfi) {
+            ++MyQuadricHelper::Version(vfi.V1());
+            ++MyQuadricHelper::Version(vfi.V2());
+        }
+
+        const bool bothWays = Self::QueueBothWays(params);
+        const bool opposite = Self::QueueOppositeEdges(params);
+        const size_t first  = pairs.size();
+
+        auto queue = [&](MyVertex *a, MyVertex *b) {
+            pairs.push_back(MyVertexPair(a, b));
+            if (bothWays)
+                pairs.push_back(MyVertexPair(b, a));
+        };
+        for (vcg::face::VFIterator<MyFace> vfi(survivor); !vfi.End(); ++vfi) {
+            for (MyVertex *w : {vfi.V1(), vfi.V2()}) {
+                if (!w->IsRW())
+                    continue;
+                bool queued = false;
+                for (size_t i = first; i < pairs.size() && !queued; ++i)
+                    queued = pairs[i].V(0) == survivor && pairs[i].V(1) == w;
+                if (!queued)
+                    queue(survivor, w);
+            }
+            if (opposite && vfi.V1()->IsRW() && vfi.V2()->IsRW())
+                queue(vfi.V1(), vfi.V2());
+        }
+    }
+
+    // Forwards to the quadric collapse, counts it and appends it to the progressive mesh log,
+    // if any. On skinned meshes the surviving vertex gets the endpoint weights blended at the
+    // position it moved to.
+    void Execute(MyMesh &m, vcg::BaseParameterClass *pp) override;
+
+    // Priority added for merging vertices with different skinning: skinWeight times
+    // SkinWeights::Distance times the squared edge length. It has the units of the quadric error,
+    // so at skinWeight 1 a pair with no bone in common costs as much as moving a plane by the
+    // edge length.
+    MyMesh::ScalarType SkinPenalty(const Parameter *params) const {
+        if (!params->skin || params->skinWeight <= 0)
+            return 0;
+        const MyVertex &v0 = *this->pos.cV(0);
+        const MyVertex &v1 = *this->pos.cV(1);
+        double d = SkinWeights::Distance((*params->skin)[v0], (*params->skin)[v1]);
+        return MyMesh::ScalarType(params->skinWeight * d *
+                                  vcg::SquaredDistance(v0.cP(), v1.cP()));
+    }
+
+    const MyVertexPair &Pair() const { return this->pos; }
+
+    // Summed plane quadric of both endpoints. Its square root at a point bounds the distance from
+    // that point to the planes of every face merged into the endpoints.
+    vcg::math::Quadric<double> GeometricQuadric() const {
+        vcg::math::Quadric<double> q = MyQuadricHelper::Qd3(*this->pos.cV(0));
+        q += MyQuadricHelper::Qd3(*this->pos.cV(1));
+        return q;
+    }
+
+    static double QuadricDistance(const vcg::math::Quadric<double> &q, const vcg::Point3f &p) {
+        return std::sqrt(std::max(0.0, q.Apply(vcg::Point3d::Construct(p))));
+    }
+
+    // Error of the collapse at the minimizer of the geometric quadric (the midpoint when it is
+    // singular or optimal placement is off). The texture-aware placement may pick another point,
+    // so the error of the performed collapse can be slightly larger; it is measured again in
+    // Execute.
+    double EstimatedError(bool optimalPlacement) const {
+        vcg::math::Quadric<double> q = GeometricQuadric();
+        vcg::Point3f p               = (this->pos.cV(0)->cP() + this->pos.cV(1)->cP()) / 2.0f;
+        vcg::Point3d minimum;
+        if (optimalPlacement && q.Minimum(minimum))
+            p = vcg::Point3f::Construct(minimum);
+        return QuadricDistance(q, p);
+    }
+
+  private:
+    void ExecuteAndRecord(MyMesh &m, Parameter *pp);
+
+    unsigned int version[2];
+};
+
+// Texture-aware collapse: 5D quadrics per wedge keep UV seams and the parametrization.
+class MyCollapse : public MyCollapseBase<MyCollapse, VcgTexCollapse, MyCollapseParameter> {
+  public:
+    using MyCollapseBase::MyCollapseBase;
+
+    // vcglib's texture collapse queues every new candidate one way round, survivor first.
+    static bool QueueBothWays(const MyCollapseParameter &) { return false; }
+    static bool QueueOppositeEdges(const MyCollapseParameter &) { return false; }
+
+    typedef vcg::tri::TriEdgeCollapseQuadricTex<MyMesh, MyVertexPair, MyPendingCollapse,
+                                                MyQuadricHelper>
+        PendingInit;
+};
+
+// Geometry-only collapse for meshes without texture coordinates: plane quadrics alone, no
+// per-vertex wedge lists. DecimationSession picks it (see Simplifier::Params::collapseKind).
+class MyGeoCollapse
+    : public MyCollapseBase<MyGeoCollapse, VcgGeoCollapse, MyGeoCollapseParameter> {
+  public:
+    using MyCollapseBase::MyCollapseBase;
+
+    // vcglib's quadric collapse queues both directions when the result depends on it (no
+    // optimal placement), and with SafeHeapUpdate also the edges opposite the survivor.
+    static bool QueueBothWays(const MyGeoCollapseParameter &p) { return !p.OptimalPlacement; }
+    static bool QueueOppositeEdges(const MyGeoCollapseParameter &p) { return p.SafeHeapUpdate; }
+
+    typedef vcg::tri::TriEdgeCollapseQuadric<MyMesh, MyVertexPair, MyPendingCollapse,
+                                             MyQuadricHelper>
+        PendingInit;
 };
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use for a requested count (<= 0 means one per hardware thread).
+inline int ResolveThreadCount(int requested) {
+    if (requested > 0)
+        return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? int(hw) : 1;
+}
+
+// Calls fn(i, thread) for every i in [0, count) on up to `threads` threads and waits for all of
+// them. Items are handed out one at a time, so uneven items balance themselves. The calling
+// thread takes part as thread 0.
+template <class Fn> void ParallelForEach(size_t count, int threads, Fn &&fn) {
+    threads = (int)std::min<size_t>(size_t(std::max(threads, 1)), std::max<size_t>(count, 1));
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i)
+            fn(i, 0);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto worker = [&](int thread) {
+        for (size_t i = next++; i < count; i = next++)
+            fn(i, thread);
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for (std::thread &t : pool)
+        t.join();
+}
+
+// Splits [0, count) into `threads` contiguous ranges and calls fn(begin, end, thread) on each.
+template <class Fn> void ParallelForRange(size_t count, int threads, Fn &&fn) {
+    threads = (int)std::min<size_t>(size_t(std::max(threads, 1)), std::max<size_t>(count, 1));
+    ParallelForEach(size_t(threads), threads, [&](size_t t, int thread) {
+        fn(count * t / threads, count * (t + 1) / threads, thread);
+    });
+}
+
+// Sorts [first, last) by sorting one chunk per thread concurrently and merging the chunks
+// pairwise, also concurrently. Small ranges are sorted on the calling thread.
+template <class It, class Less> void ParallelSort(It first, It last, int threads, Less less) {
+    const size_t count = size_t(last - first);
+    threads            = std::max(threads, 1);
+    if (threads == 1 || count < 65536) {
+        std::sort(first, last, less);
+        return;
+    }
+
+    const size_t chunks = size_t(threads);
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; ++c)
+        bounds[c] = count * c / chunks;
+    ParallelForEach(chunks, threads, [&](size_t c, int) {
+        std::sort(first + bounds[c], first + bounds[c + 1], less);
+    });
+    for (size_t width = 1; width < chunks; width *= 2) {
+        ParallelForEach((chunks + 2 * width - 1) / (2 * width), threads, [&](size_t pair, int) {
+            size_t lo  = pair * 2 * width;
+            size_t mid = std::min(lo + width, chunks);
+            size_t hi  = std::min(lo + 2 * width, chunks);
+            if (mid < hi)
+                std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi],
+                                   less);
+        });
+    }
+}
+
+// Heapifies [first, last) into the layout std::make_heap gives with libstdc++ and the MSVC STL
+// (Floyd's construction, moving the hole to a leaf and sifting the value back up), so equal
+// elements end up where the serial build puts them. The serial build processes the parents from
+// the last one to the root; each only touches its own subtree, so the parents of one tree level
+// are independent and run concurrently, deepest level first.
+template <class It, class Less> void ParallelMakeHeap(It first, It last, int threads, Less less) {
+    typedef std::ptrdiff_t Index;
+    const Index len = Index(last - first);
+    threads         = std::max(threads, 1);
+    if (threads == 1 || len < 65536) {
+        std::make_heap(first, last, less);
+        return;
+    }
+
+    auto adjust = [&](Index hole) {
+        const Index top = hole;
+        auto value      = std::move(first[hole]);
+        Index child     = hole;
+        while (child < (len - 1) / 2) {
+            child = 2 * (child + 1);
+            if (less(first[child], first[child - 1]))
+                --child;
+            first[hole] = std::move(first[child]);
+            hole        = child;
+        }
+        if ((len & 1) == 0 && child == (len - 2) / 2) {
+            child       = 2 * (child + 1);
+            first[hole] = std::move(first[child - 1]);
+            hole        = child - 1;
+        }
+        Index parent = (hole - 1) / 2;
+        while (hole > top && less(first[parent], value)) {
+            first[hole] = std::move(first[parent]);
+            hole        = parent;
+            parent      = (hole - 1) / 2;
+        }
+        first[hole] = std::move(value);
+    };
+
+    const Index lastParent = (len - 2) / 2;
+    Index deepest          = 0; // first index of the deepest level with a parent
+    while (2 * deepest + 1 <= lastParent)
+        deepest = 2 * deepest + 1;
+    for (Index levelBegin = deepest;; levelBegin = (levelBegin - 1) / 2) {
+        const Index levelEnd = std::min(2 * levelBegin + 1, lastParent + 1);
+        const size_t count   = size_t(levelEnd - levelBegin);
+        ParallelForRange(count, count < 4096 ? 1 : threads, [&](size_t begin, size_t end, int) {
+            for (size_t i = end; i > begin; --i)
+                adjust(levelBegin + Index(i - 1));
+        });
+        if (levelBegin == 0)
+            break;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "mymesh.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Progressive mesh: the mesh a decimation session started from plus the ordered list of edge
+// collapses it performed. Replaying the first k collapses on the base mesh gives the same
+// geometry the simplifier had after k collapses, so any LOD between the base and the coarsest
+// mesh can be extracted without running QEM again.
+//
+// On disk (little endian on every host, see Save):
+//   "VPM2", uint32 vertexCount, uint32 faceCount, uint32 collapseCount
+//   vertexCount x { float pos[3]; uint8 rgba[4]; }
+//   faceCount   x { uint32 v[3]; float uv[6]; int32 matId; }
+//   collapseCount x { uint32 kept, removed; float pos[3]; uint32 removedFaces, wedges;
+//                     uint32 removedFace[removedFaces]; { uint32 face; float uv[6]; }[wedges] }
+// Collapses are stored in the order they were performed, so a reader only needs the prefix of
+// the file that covers the LOD it wants.
+struct ProgressiveMesh {
+    // Corner UVs of a face that survived a collapse (and now references `kept`).
+    struct Wedge {
+        uint32_t face;
+        float uv[6];
+    };
+    struct Collapse {
+        uint32_t kept;
+        uint32_t removed;
+        float pos[3];
+        uint32_t firstRemovedFace; // into removedFaces
+        uint32_t removedFaceCount;
+        uint32_t firstWedge; // into wedges
+        uint32_t wedgeCount;
+    };
+
+    // Base mesh
+    std::vector<float> positions;  // 3 per vertex
+    std::vector<uint8_t> colors;   // 4 per vertex
+    std::vector<uint32_t> indices; // 3 per face
+    std::vector<float> uvs;        // 6 per face
+    std::vector<int32_t> matIds;   // 1 per face
+
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> removedFaces;
+    std::vector<Wedge> wedges;
+
+    size_t VertexCount() const { return positions.size() / 3; }
+    size_t FaceCount() const { return matIds.size(); }
+
+    void Clear();
+    // Records `m` as the base mesh. `m` must not contain deleted elements, since collapses refer
+    // to vertices and faces by index.
+    void SetBase(const MyMesh &m);
+    // Appends one collapse; called by MyCollapse::Execute.
+    void AddCollapse(uint32_t kept, uint32_t removed, const vcg::Point3f &pos,
+                     const std::vector<uint32_t> &deadFaces, const std::vector<Wedge> &faceWedges);
+
+    // Smallest number of collapses after which the mesh has at most targetFaces faces (or all
+    // of them if the log never gets that far).
+    size_t PrefixForFaceCount(size_t targetFaces) const;
+    // Replays the first collapseCount collapses and writes the resulting compact mesh to `out`.
+    void Extract(size_t collapseCount, MyMesh &out) const;
+
+    bool Save(const std::string &filename) const;
+    // Reads the base mesh and the collapses until the face count drops to minFaceRatio times the
+    // base face count; the rest of the file is not touched. Returns false (and leaves the mesh
+    // empty) if the file is truncated or any count or index in it is out of range.
+    bool Load(const std::string &filename, float minFaceRatio = 0.0f);
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Batched evaluation of plane quadrics, the inner loop of the compact simplifier's collapse
+// scoring. There is a scalar, an AVX2 and an AVX-512 implementation; the widest one the CPU
+// supports is picked at first use. All of them compute each error with the same operations in
+// the same order (no FMA), so they return bit-identical results and the simplified mesh does not
+// depend on the machine.
+enum class QuadricKernel { Auto, Scalar, Avx2, Avx512 };
+
+// True if `kernel` can run on this CPU (Auto and Scalar always can).
+bool QuadricKernelSupported(QuadricKernel kernel);
+// Selects the implementation used by every following QuadricErrorBatch call in the process,
+// for benchmarks and A/B checks; an unsupported kernel falls back to Auto. Returns the one now in
+// effect, never Auto.
+QuadricKernel SetQuadricKernel(QuadricKernel kernel);
+QuadricKernel ActiveQuadricKernel();
+const char *QuadricKernelName(QuadricKernel kernel);
+
+// For i < n: out[i] = E(Q[a[i]]) + E(Q[b[i]]) at p = (x[i], y[i], z[i]), with
+// E(Q) = max(0, p'Ap + 2b'p + c). Q[v] is the 10 floats at quadrics + 10 * v, in the order
+// a00 a11 a22 a01 a02 a12 b0 b1 b2 c. `quadricCount` is the number of quadrics in the array;
+// the vector kernels gather with 32-bit offsets and leave arrays too large for that to the
+// scalar one.
+void QuadricErrorBatch(const float *quadrics, size_t quadricCount, const uint32_t *a,
+                       const uint32_t *b, const float *x, const float *y, const float *z,
+                       size_t n, float *out);
\ No newline at end of file
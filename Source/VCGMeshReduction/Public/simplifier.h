@@ -1,25 +1,166 @@
 #pragma once
 
+#include "compact_mesh.h"
 #include "mymesh.h"
+#include "progressive_mesh.h"
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/update/flag.h>
 #include <vcg/complex/algorithms/update/normal.h>
 #include <vcg/complex/algorithms/update/topology.h>
+#include <vector>
+
+// Thread safety: Simplifier keeps no global state. Every Simplify/SimplifyChain call owns its
+// quadric temporaries, collapse heap and staleness counters, and publishes them only on the
+// calling thread (see MyQuadricHelper), so any number of calls may run concurrently as long as
+// they work on different meshes. Calls with Params::threads != 1 start their own worker threads.
+// The only vcglib state shared between sessions is TriEdgeCollapse::GlobalMark(). vcglib's Init
+// reads it, but nothing writes it: MyCollapse requeues without it (MyCollapseBase::Requeue).
+class DecimationSession;
 
 class Simplifier {
   public:
+    // Wall-clock time of the phases of Simplify/SimplifyChain in milliseconds plus collapse
+    // counters. Calls add to the values, so one Stats can collect several runs. The partitioned
+    // multi-threaded path reports all of its work as collapseMs and leaves the counters alone.
+    struct Stats {
+        double topologyMs = 0.0; // VF/FF adjacency, borders, face normals
+        double initMs     = 0.0; // quadrics and the initial collapse heap
+        double collapseMs = 0.0; // the collapse loop and Finalize
+        double normalsMs  = 0.0; // bounding box and normals of the result
+
+        CollapseCounters collapses;
+        uint64_t lockedVertices = 0; // never collapsed: boundary (preserveBoundary) or caller lock
+
+        // Every timed phase in the order it ran, for trace export. Start times are steady_clock
+        // milliseconds since its epoch, so callers can add their own phases to the timeline.
+        struct Phase {
+            const char *name;
+            double startMs;
+            double durationMs;
+        };
+        std::vector<Phase> phases;
+    };
+
+    // Collapse instantiation of the MyMesh path. Auto takes GeometryOnly when every wedge of the
+    // mesh has the same UV, as loaders leave it when the input has no texture coordinates:
+    // plane quadrics only, without the 5D wedge quadrics (and their per-vertex lists) that
+    // Textured keeps to preserve UV seams.
+    enum class CollapseKind { Auto, GeometryOnly, Textured };
+
+    // Collapse loop of the MyMesh path. Serial performs the cheapest collapse, rescores its
+    // neighbourhood and repeats. IndependentSet works in rounds: it takes a set of the cheapest
+    // collapses whose neighbourhoods do not overlap, performs them and scores the collapses they
+    // create on Params::threads threads. Both use the same costs and checks; IndependentSet gives
+    // the same result for any thread count.
+    enum class Engine { Serial, IndependentSet };
+
     struct Params {
-        float ratio              = 0.5f;
-        int targetFaceCount      = -1;
-        bool preserveBoundary    = true;
-        bool preserveTopology    = true;
-        bool normalCheck         = false;
-        bool optimalPlacement    = true;
-        double qualityThr        = 0.3;
-        double boundaryWeight    = 1.0;
-        double extraTCoordWeight = 1.0;
+        float ratio               = 0.5f;
+        int targetFaceCount       = -1;
+        bool preserveBoundary     = true;
+        bool preserveTopology     = true;
+        bool normalCheck          = false;
+        bool optimalPlacement     = true;
+        double qualityThr         = 0.3;
+        double boundaryWeight     = 1.0;
+        double extraTCoordWeight  = 1.0;
+        CollapseKind collapseKind = CollapseKind::Auto;
+        Engine engine             = Engine::Serial;
+
+        // Maximum geometric error of a collapse in mesh units (0 = off). Collapses estimated above
+        // it are skipped, so the mesh stops at the fewest faces that meet the tolerance, or at the
+        // face target if that comes first. Set ratio to 0 for an error-only limit. The achieved
+        // error is reported in Stats::collapses.maxDeviation.
+        double maxError = 0.0;
+
+        // Skinned meshes only (a SkinWeights vertex attribute, see skin_weights.h): scale of the
+        // priority penalty for collapsing vertices with different skinning (0 = ignore skinning)
+        // and the number of influences a blended vertex keeps. Skinned meshes always take the
+        // serial path.
+        double skinWeight = 1.0;
+        int maxInfluences = SkinWeights::kMaxInfluences;
+
+        // Worker threads for Simplify: 1 runs the serial path, 0 uses every hardware thread.
+        // Large meshes are split into spatial clusters that are simplified concurrently (unless
+        // engine is IndependentSet); every session also scores its initial collapse heap on these
+        // threads.
+        int threads = 1;
+
+        // When set, receives the mesh the session starts from and every collapse it performs.
+        ProgressiveMesh *collapseLog = nullptr;
+
+        // When set, receives the phase timings and collapse counters of the call.
+        Stats *stats = nullptr;
     };
 
-    static void Clean(MyMesh &m);
+    // Receives a compacted copy of the mesh (normals updated) each time a chain level is reached.
+    // `level` is the index of the level in the `targets` vector passed to SimplifyChain.
+    using LevelCallback = std::function<void(size_t level, MyMesh &lod)>;
+
+    // Incremental Simplify: call Step until it returns false, then Finish. Cancel and Progress
+    // may be called from any thread; Step and Finish from one thread at a time (not necessarily
+    // the same one). A cancelled session stops at the end of the current step and leaves a valid,
+    // partially simplified mesh. Never splits the mesh into clusters; Params::threads speeds up
+    // the setup of the collapse heap and the rounds of Engine::IndependentSet.
+    class Session {
+      public:
+        Session(MyMesh &m, const Params &params);
+        ~Session();
+        Session(const Session &)            = delete;
+        Session &operator=(const Session &) = delete;
+
+        // Collapses edges for about budgetMs milliseconds of wall time (the clock is checked
+        // between batches of collapses, so a step may run slightly over). Returns false once the
+        // target face count is reached, no collapse is left or the session was cancelled.
+        bool Step(double budgetMs = 100.0);
+
+        // Fraction of the faces to remove that are gone so far, in [0, 1].
+        float Progress() const { return progress.load(std::memory_order_relaxed); }
+
+        void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+        bool Cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+        // Releases the collapse heap and updates the normals of the mesh. Returns false if the
+        // session was cancelled before it reached the target.
+        bool Finish();
+
+      private:
+        MyMesh &m;
+        Stats *stats;
+        int startFaces;
+        int targetCount;
+        std::unique_ptr<DecimationSession> session;
+        std::atomic<bool> cancelled{false};
+        std::atomic<float> progress{0.0f};
+    };
+
+    // Welds vertices closer than weldDistance (< 0: 1e-6 of the bounding box diagonal, 0: equal
+    // positions only) and removes degenerate, zero-area and duplicate faces and unreferenced
+    // vertices, then compacts the mesh once. Welding looks up the neighbouring cells of a spatial
+    // hash grid and chains merges, so near-coincident seams between glTF primitives or UV islands
+    // become shared vertices the simplifier can collapse. Implemented in clean.cpp.
+    static void Clean(MyMesh &m, double weldDistance = -1.0, int threads = 1);
+    static void Clean(CompactMesh &m, double weldDistance = -1.0, int threads = 1);
     static void Simplify(MyMesh &m, const Params &params);
+
+    // Simplify on the compact layout (compact_simplify.cpp): plane quadrics in float, half-edge
+    // collapses that keep the wedge UVs of the surviving vertex and refuse to tear UV seams, and
+    // a flat vertex-to-face adjacency built for the call. Needs a fraction of the memory of the
+    // MyMesh path; the price is vertex placement. optimalPlacement, extraTCoordWeight,
+    // normalCheck, qualityThr, skinning and collapseLog are ignored, and Params::threads only
+    // parallelizes the setup. Leaves the mesh compacted.
+    static void Simplify(CompactMesh &m, const Params &params);
+
+    // Builds several LODs from one decimation session: topology, quadrics and the collapse heap
+    // are set up once and the mesh is snapshotted whenever it reaches one of the target face
+    // counts. Targets may be given in any order; they are visited from finest to coarsest and
+    // `m` is left at the coarsest level. ratio/targetFaceCount in `params` are ignored.
+    static void SimplifyChain(MyMesh &m, const std::vector<int> &targets,
+                              const LevelCallback &onLevel, const Params &params = Params());
+
+    // Copies the live (non deleted) part of `src` into `dst`, including wedge UVs and matId.
+    static void CopyMesh(const MyMesh &src, MyMesh &dst);
 };
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+// Bone influences of a skinned vertex. A skinned MyMesh carries one per vertex as the per-vertex
+// attribute named kAttribute; vcglib keeps the attribute in step when vertices are added or
+// compacted, and MyCollapse blends the weights of both endpoints onto the surviving vertex.
+// Simplifier::CopyMesh does not copy it.
+//
+// Influences are sorted by decreasing weight and end at the first zero weight, so a default
+// constructed SkinWeights has none.
+struct SkinWeights {
+    static constexpr int kMaxInfluences     = 12; // MAX_TOTAL_INFLUENCES of Unreal Engine 5
+    static constexpr const char *kAttribute = "skinWeights";
+
+    uint16_t bone[kMaxInfluences] = {};
+    float weight[kMaxInfluences]  = {};
+
+    int Count() const {
+        int n = 0;
+        while (n < kMaxInfluences && weight[n] > 0.0f)
+            ++n;
+        return n;
+    }
+
+    float WeightOf(uint16_t b) const {
+        for (int i = 0; i < kMaxInfluences && weight[i] > 0.0f; ++i) {
+            if (bone[i] == b)
+                return weight[i];
+        }
+        return 0.0f;
+    }
+
+    // Adds `w` to the influence of bone `b`. When all slots are taken the lightest influence is
+    // replaced if `w` is heavier, otherwise `w` is dropped.
+    void Add(uint16_t b, float w) {
+        if (w <= 0.0f)
+            return;
+        int n = Count();
+        int i = 0;
+        while (i < n && bone[i] != b)
+            ++i;
+        if (i < n)
+            w += weight[i];
+        else if (n < kMaxInfluences)
+            i = n;
+        else if (w > weight[n - 1])
+            i = n - 1;
+        else
+            return;
+        // The weight only grew, so the influence can only move towards the front.
+        for (; i > 0 && weight[i - 1] < w; --i) {
+            bone[i]   = bone[i - 1];
+            weight[i] = weight[i - 1];
+        }
+        bone[i]   = b;
+        weight[i] = w;
+    }
+
+    // Keeps the maxInfluences heaviest influences and scales the weights to sum to 1.
+    void Limit(int maxInfluences) {
+        float sum = 0.0f;
+        for (int i = 0; i < kMaxInfluences; ++i) {
+            if (i >= maxInfluences) {
+                bone[i]   = 0;
+                weight[i] = 0.0f;
+            }
+            sum += weight[i];
+        }
+        if (sum > 0.0f) {
+            for (int i = 0; i < kMaxInfluences; ++i)
+                weight[i] /= sum;
+        }
+    }
+
+    // Half the L1 distance between the weight vectors of `a` and `b`: 0 for identical skinning,
+    // 1 for vertices that share no bone.
+    static float Distance(const SkinWeights &a, const SkinWeights &b) {
+        float d = 0.0f;
+        for (int i = 0; i < kMaxInfluences && a.weight[i] > 0.0f; ++i) {
+            float w = a.weight[i] - b.WeightOf(a.bone[i]);
+            d += w < 0.0f ? -w : w;
+        }
+        for (int i = 0; i < kMaxInfluences && b.weight[i] > 0.0f; ++i) {
+            if (a.WeightOf(b.bone[i]) == 0.0f)
+                d += b.weight[i];
+        }
+        return d * 0.5f;
+    }
+
+    // (1 - t) * a + t * b, limited to maxInfluences.
+    static SkinWeights Blend(const SkinWeights &a, const SkinWeights &b, float t,
+                             int maxInfluences) {
+        SkinWeights r;
+        for (int i = 0; i < kMaxInfluences && a.weight[i] > 0.0f; ++i)
+            r.Add(a.bone[i], a.weight[i] * (1.0f - t));
+        for (int i = 0; i < kMaxInfluences && b.weight[i] > 0.0f; ++i)
+            r.Add(b.bone[i], b.weight[i] * t);
+        r.Limit(maxInfluences);
+        return r;
+    }
+};
\ No newline at end of file
@@ -47,11 +47,17 @@ public class VCGMeshReduction : ModuleRules
 
         PrivateIncludePathModuleNames.AddRange(
         new string[] {
+                "MaterialUtilities",
+                "MeshMergeUtilities",
                 "MeshReductionInterface",
+                "MeshUtilities",
              }
         );
 
         // VCG needs some defines
         PublicDefinitions.Add("VCG_USE_EIGEN");
+
+        // Simplifier phases as Unreal Insights CPU scopes (see decimation_session.h)
+        PrivateDefinitions.Add("VCG_SIMPLIFIER_UE_TRACE=1");
     }
 }